@@ -0,0 +1,39 @@
+/**
+ * @file cell_kernels.h
+ */
+
+#ifndef __CELL_KERNELS_H
+#define __CELL_KERNELS_H
+
+#include <stddef.h>
+
+/**
+ * @struct CellKernels
+ * Row operations on layer cells, and the fold of chart samples, in one
+ * instruction-set flavour.
+ */
+typedef struct {
+	/**Name shown by the benchmark.*/
+	char const* name;
+	/**Sets @p n cells to @p c.*/
+	void (*fill)(char* dst, char c, size_t n);
+	/**Sets @p n cells to @p border, keeping existing '+' joins.*/
+	void (*border)(char* dst, char border, size_t n);
+	/**Copies @p n cells, skipping empty (NUL) source cells.*/
+	void (*blit)(char* dst, char const* src, size_t n);
+	/**Finds the first of @p m cells in @p n cells, returning its offset or @p n.*/
+	size_t (*find)(char const* cells, size_t n, char const* needle, size_t m);
+	/**Folds @p n samples into a running minimum and maximum; samples must not be NaN.*/
+	void (*range)(float const* v, size_t n, float* lo, float* hi);
+} CellKernels;
+
+void Cells_init(void);
+CellKernels const* Cells_variant(int i);
+CellKernels const* Cells_active(void);
+void Cells_fill(char* dst, char c, size_t n);
+void Cells_border(char* dst, char border, size_t n);
+void Cells_blit(char* dst, char const* src, size_t n);
+size_t Cells_find(char const* cells, size_t n, char const* needle, size_t m);
+void Cells_range(float const* v, size_t n, float* lo, float* hi);
+
+#endif // __CELL_KERNELS_H
@@ -0,0 +1,67 @@
+/**
+ * @file chart_view.h
+ */
+
+#ifndef __CHART_VIEW_H
+#define __CHART_VIEW_H
+
+#include <stdint.h>
+
+#include "screen_painter.h"
+
+/**
+ * Receives a run of chart cells that changed.
+ *
+ * @param[in] y	   Row within the chart, 0 being the top
+ * @param[in] x	   First column within the chart
+ * @param[in] text Cells, not NUL-terminated
+ * @param[in] len  Number of cells
+ * @param[in] arg  Caller context
+ */
+typedef void (*ChartSpanCb)(int y, int x, char const* text, int len, void* arg);
+
+/**
+ * @struct ChartView
+ * Chart of the latest samples of a series, one column per bucket of
+ * consecutive samples. A chart one row high is a sparkline; taller ones
+ * draw each bucket as a bar from its minimum to its maximum.
+ *
+ * Buckets start at fixed sample positions, so new samples only change
+ * the newest buckets, and the chart scrolls a column at a time.
+ */
+typedef struct {
+	/**Latest samples, oldest overwritten first.*/
+	float*	 samples;
+	/**Size of @ref samples.*/
+	uint32_t capacity;
+	/**Samples pushed so far.*/
+	uint64_t count;
+	/**Samples per bucket, so that the buckets cover @ref capacity.*/
+	uint32_t perColumn;
+	/**Oldest bucket whose minimum and maximum are known.*/
+	uint64_t firstBucket;
+
+	/**Chart width, one bucket per column.*/
+	uint16_t width;
+	/**Chart height.*/
+	uint16_t height;
+	/**Smallest sample of each bucket, indexed by bucket modulo @ref width.*/
+	float	 lo[MAX_SCREEN_WIDTH];
+	/**Largest sample of each bucket, indexed by bucket modulo @ref width.*/
+	float	 hi[MAX_SCREEN_WIDTH];
+	/**Bottom of the fixed scale.*/
+	float	 scaleLo;
+	/**Top of the fixed scale; at or below @ref scaleLo to fit the visible samples.*/
+	float	 scaleHi;
+	/**What each column shows on screen, to find the columns that changed.*/
+	uint16_t drawn[MAX_SCREEN_WIDTH];
+} ChartView;
+
+int ChartView_init(ChartView* me, uint32_t capacity, uint16_t width, uint16_t height);
+void ChartView_free(ChartView* me);
+void ChartView_push(ChartView* me, float const* samples, uint32_t n);
+void ChartView_resize(ChartView* me, uint16_t width, uint16_t height);
+void ChartView_setRange(ChartView* me, float lo, float hi);
+int ChartView_render(ChartView* me, ChartSpanCb span, void* arg);
+
+#endif // __CHART_VIEW_H
@@ -0,0 +1,79 @@
+/**
+ * @file file_system.h
+ */
+
+#ifndef __FILE_SYSTEM_H
+#define __FILE_SYSTEM_H
+
+#include <stdint.h>
+
+#include "qpc.h"
+
+/**
+ * Set to 1 to use io_uring where the kernel offers it; worker threads are
+ * used otherwise.
+ */
+#ifndef FS_IO_URING
+#define FS_IO_URING 0
+#endif
+
+/**Size of a path in a file request.*/
+#define FILE_PATH_LEN 96
+/**Maximum number of requests in progress; later ones fail with EBUSY.*/
+#define FS_MAX_JOBS 16
+/**Worker threads used without io_uring.*/
+#define FS_WORKERS 2
+/**Initial read buffer; it doubles whenever a read fills it.*/
+#define FS_CHUNK (64U * 1024U)
+/**Largest file that can be read.*/
+#define FS_MAX_FILE (64U * 1024U * 1024U)
+
+/**
+ * @enum FileStep
+ * Single system call a request is waiting on.
+ */
+typedef enum {
+	FS_STEP_OPEN,	///< Open the file, or the temporary file for a save
+	FS_STEP_READ,	///< Read the next chunk
+	FS_STEP_WRITE,	///< Write the remaining bytes
+	FS_STEP_FSYNC,	///< Flush the temporary file
+	FS_STEP_CLOSE,	///< Close the file
+	FS_STEP_RENAME,	///< Move the temporary file over the target
+	FS_STEP_UNLINK,	///< Remove the temporary file after a failed save
+} FileStep;
+
+/**
+ * @struct FileJob
+ * Request in progress. Only one step of a job is ever in flight, and the
+ * FileSystem object touches the job only between steps.
+ */
+typedef struct {
+	/**Object the result is posted to, NULL if the slot is free.*/
+	QActive* requester;
+	/**Caller's request tag, echoed in the result.*/
+	uint16_t tag;
+	/**Set for saves, clear for reads.*/
+	uint8_t	 save;
+	/**Step in flight.*/
+	uint8_t	 step;
+	/**Open descriptor, or -1.*/
+	int		 fd;
+	/**First error, as a negative errno, or 0.*/
+	int		 status;
+	/**File to read or save.*/
+	char	 path[FILE_PATH_LEN];
+	/**Temporary file a save is written to before it replaces @ref path.*/
+	char	 tmpPath[FILE_PATH_LEN + 4];
+	/**Bytes read or to be written.*/
+	char*	 data;
+	/**Size of @ref data.*/
+	uint32_t capacity;
+	/**Bytes read or written so far.*/
+	uint32_t done;
+} FileJob;
+
+int FileSystem_read(QActive* requester, uint16_t tag, char const* path);
+int FileSystem_save(QActive* requester, uint16_t tag, char const* path, char* data, uint32_t length);
+void FileSystem_stop(void);
+
+#endif // __FILE_SYSTEM_H
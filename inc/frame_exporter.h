@@ -0,0 +1,95 @@
+/**
+ * @file frame_exporter.h
+ */
+
+#ifndef __FRAME_EXPORTER_H
+#define __FRAME_EXPORTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_shm.h"
+#include "glyph.h"
+#include "screen_painter.h"
+
+/**Socket path for a session, formatted with the process ID and session ID.*/
+#define FRAME_EXPORT_PATH "/tmp/terminal-interface.%d.%u.sock"
+/**Maximum number of viewers per session.*/
+#define FRAME_EXPORT_MAX_VIEWERS 8
+/**Bytes buffered per viewer before it is dropped to keyframe resync.*/
+#define FRAME_EXPORT_BUF_LEN 32768
+
+/**
+ * @enum FrameMsgType
+ * Message types of the frame stream.
+ *
+ * Every message is a little-endian uint32 byte count followed by:
+ * - type (1 byte), then varints: frame number, rows, columns, run count
+ * - per run, varints: row delta, column delta, length << 1 | run type;
+ *   then for @ref FRAME_RUN_CELLS the cells, one byte per column, and for
+ *   @ref FRAME_RUN_UTF8 a varint byte count and the text
+ *
+ * Row delta is relative to the previous run's row. Column delta is relative
+ * to the end of the previous run on the same row, or absolute on a new row.
+ * Length is in columns; a wide character in a UTF-8 run covers two.
+ */
+typedef enum {
+	FRAME_MSG_KEY = 'K',	///< Complete frame
+	FRAME_MSG_DIFF = 'D',	///< Cells changed since the previous message
+} FrameMsgType;
+
+/**
+ * @enum FrameRunType
+ * How the cells of a run are sent.
+ */
+typedef enum {
+	FRAME_RUN_CELLS,	///< ASCII, one byte per column
+	FRAME_RUN_UTF8,		///< UTF-8 text, for runs holding glyphs
+} FrameRunType;
+
+/**
+ * @struct FrameViewer
+ * A connected read-only observer.
+ */
+typedef struct {
+	/**Connection, or -1 if the slot is free.*/
+	int		 fd;
+	/**Set when the viewer must receive a keyframe before further diffs.*/
+	uint8_t	 resync;
+	/**Bytes of @ref buf already sent.*/
+	uint16_t sent;
+	/**Bytes queued in @ref buf.*/
+	uint16_t len;
+	/**Pending whole messages, FRAME_EXPORT_BUF_LEN bytes.*/
+	uint8_t* buf;
+} FrameViewer;
+
+/**
+ * @struct FrameExporter
+ * Publishes a session's presented frames to local viewers.
+ */
+typedef struct {
+	/**Listening socket, or -1 if exporting is unavailable.*/
+	int		 listenFd;
+	/**Number of presented frames.*/
+	uint32_t frame;
+	/**Frame as painted so far; glyphs are kept as their cells.*/
+	char	 cells[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];
+	/**Frame as last sent to synchronized viewers.*/
+	char	 sent[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];
+	/**Rows painted since the last presented frame.*/
+	uint8_t	 dirty[MAX_SCREEN_HEIGHT];
+	/**Connected viewers.*/
+	FrameViewer viewers[FRAME_EXPORT_MAX_VIEWERS];
+	/**Shared memory copy of the presented frame, or NULL.*/
+	FrameShm* shm;
+	/**Table the glyph cells of @ref cells were laid out with.*/
+	GlyphTable const* glyphs;
+} FrameExporter;
+
+void FrameExporter_open(FrameExporter* me, uint16_t session, GlyphTable const* glyphs);
+void FrameExporter_close(FrameExporter* me, uint16_t session);
+void FrameExporter_paint(FrameExporter* me, int y, int x, char const* text, size_t length);
+void FrameExporter_present(FrameExporter* me);
+
+#endif // __FRAME_EXPORTER_H
@@ -0,0 +1,69 @@
+/**
+ * @file frame_shm.h
+ */
+
+#ifndef __FRAME_SHM_H
+#define __FRAME_SHM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "screen_painter.h"
+
+/**
+ * Set to 1 to publish presented frames in shared memory.
+ */
+#ifndef FRAME_SHM
+#define FRAME_SHM 0
+#endif
+
+/**Shared memory object of a session, formatted with the process ID and session ID.*/
+#define FRAME_SHM_NAME "/terminal-interface.%d.%u"
+/**Value of FrameShm::magic once the region is initialized ("TIFB").*/
+#define FRAME_SHM_MAGIC 0x42464954U
+/**Layout version; bumped whenever FrameShm changes.*/
+#define FRAME_SHM_VERSION 1
+/**Words of FrameShm::dirty.*/
+#define FRAME_SHM_DIRTY_WORDS ((MAX_SCREEN_HEIGHT + 31) / 32)
+
+/**
+ * @struct FrameShm
+ * Latest presented frame of a session, shared with local readers.
+ *
+ * The region is guarded by a seqlock: the painter makes @ref seq odd
+ * before it changes anything and even again once it is done, and never
+ * waits for readers. A reader copies what it needs between two reads of
+ * @ref seq and keeps the copy only if both were the same even value,
+ * see FrameShm_read().
+ */
+typedef struct {
+	/**@ref FRAME_SHM_MAGIC, written last when the region is created.*/
+	uint32_t magic;
+	/**@ref FRAME_SHM_VERSION*/
+	uint16_t version;
+	/**Rows of @ref cells.*/
+	uint16_t rows;
+	/**Columns of @ref cells.*/
+	uint16_t cols;
+	/**Padding, always 0.*/
+	uint16_t reserved;
+	/**Sequence counter, odd while a frame is being written.*/
+	uint32_t seq;
+	/**Number of the frame in @ref cells, 0 before the first one.*/
+	uint32_t frame;
+	/**Bit per row, set for rows that changed in @ref frame.*/
+	uint32_t dirty[FRAME_SHM_DIRTY_WORDS];
+	/**Frame in which each row last changed.*/
+	uint32_t rowFrame[MAX_SCREEN_HEIGHT];
+	/**Screen cells, row by row; each column of a glyph is @ref GLYPH_REPLACEMENT.*/
+	char	 cells[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];
+} FrameShm;
+
+FrameShm* FrameShm_open(uint16_t session);
+void FrameShm_close(FrameShm* shm, uint16_t session);
+void FrameShm_publish(FrameShm* shm, uint32_t frame, char const* cells, uint8_t const* dirty);
+FrameShm const* FrameShm_attach(pid_t pid, uint16_t session);
+void FrameShm_detach(FrameShm const* shm);
+uint32_t FrameShm_read(FrameShm const* shm, char cells[][MAX_SCREEN_WIDTH], uint32_t since);
+
+#endif // __FRAME_SHM_H
@@ -0,0 +1,92 @@
+/**
+ * @file glyph.h
+ */
+
+#ifndef __GLYPH_H
+#define __GLYPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Set to 0 when curses cannot print UTF-8; glyphs are then shown as
+ * @ref GLYPH_REPLACEMENT, one per column.
+ */
+#ifndef GLYPH_OUTPUT
+#define GLYPH_OUTPUT 1
+#endif
+
+/**Cell covered by the right half of the wide glyph to its left.*/
+#define GLYPH_TAIL 0x7F
+/**Cell value of the first glyph; cells from here up are glyphs.*/
+#define GLYPH_FIRST 0x80
+/**Distinct glyphs a table can hold.*/
+#define GLYPH_MAX 128
+/**UTF-8 bytes of a glyph, combining marks included.*/
+#define GLYPH_MAX_BYTES 12
+/**Slots of a table's hash index.*/
+#define GLYPH_INDEX_SIZE 256
+/**Cell drawn for text that cannot be shown.*/
+#define GLYPH_REPLACEMENT '?'
+
+/**
+ * Marks the glyphs still in use when a glyph table is full.
+ *
+ * @param[in] arg Caller context
+ */
+typedef void (*GlyphReclaimCb)(void* arg);
+
+/**
+ * @struct GlyphEntry
+ * Interned glyph.
+ */
+typedef struct {
+	/**UTF-8 of the character and its combining marks.*/
+	char	bytes[GLYPH_MAX_BYTES];
+	/**Length of @ref bytes, 0 while the entry is free.*/
+	uint8_t	len;
+	/**Columns, 1 or 2.*/
+	uint8_t	width;
+} GlyphEntry;
+
+/**
+ * @struct GlyphTable
+ * Glyphs interned for the cells of one session. A glyph cell only means
+ * something together with its table, so every session has the whole
+ * handle space to itself.
+ */
+typedef struct {
+	/**Interned glyphs, by handle.*/
+	GlyphEntry glyphs[GLYPH_MAX];
+	/**Glyphs interned and not swept.*/
+	int		numGlyphs;
+	/**Hash index into @ref glyphs, handle + 1, 0 for empty.*/
+	uint8_t	index[GLYPH_INDEX_SIZE];
+	/**Glyphs marked in use since the last sweep.*/
+	uint8_t	marks[GLYPH_MAX];
+	/**Called when the table is full.*/
+	GlyphReclaimCb reclaim;
+	/**Passed to @ref reclaim.*/
+	void*	reclaimArg;
+} GlyphTable;
+
+/**
+ * @returns Non-zero if a cell is part of a glyph rather than ASCII
+ */
+static inline int Glyph_isGlyph(char cell) {
+	return (unsigned char)cell >= GLYPH_TAIL;
+}
+
+void Glyph_init(void);
+void Glyph_initTable(GlyphTable* table);
+int Glyph_width(uint32_t cp);
+int Glyph_decode(char const* text, int len, uint32_t* cp);
+int Glyph_columns(char const* text, int len);
+int Glyph_layout(GlyphTable* table, char const* text, int len, char* cells, int columns);
+char const* Glyph_bytes(GlyphTable const* table, char cell, int* len, int* width);
+void Glyph_setReclaim(GlyphTable* table, GlyphReclaimCb reclaim, void* arg);
+void Glyph_mark(GlyphTable* table, char const* cells, size_t n);
+int Glyph_sweep(GlyphTable* table);
+int Glyph_count(GlyphTable const* table);
+
+#endif // __GLYPH_H
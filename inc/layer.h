@@ -0,0 +1,54 @@
+/**
+ * @file layer.h
+ */
+
+#ifndef __LAYER_H
+#define __LAYER_H
+
+#include <stddef.h>
+
+#include "render_artist.h"
+
+/**
+ * @struct RenderLayout
+ * Layer pre-rendered at build time from a layout file.
+ * @see tools/layoutc.c
+ */
+typedef struct {
+	/**Layout name.*/
+	char const* name;
+	/**Number of sections in @ref layer.*/
+	uint16_t numSections;
+	/**Compiled layer, installed with a single copy that shares its tiles.*/
+	RenderLayer layer;
+} RenderLayout;
+
+/**
+ * Receives a block of cells held by a layer.
+ *
+ * @param[in] arg	Caller context
+ * @param[in] cells Cells
+ * @param[in] n		Number of cells
+ */
+typedef void (*LayerCellsCb)(void* arg, char const* cells, size_t n);
+
+void Layer_init(RenderLayer* layer);
+void Layer_install(RenderLayer* layer, RenderLayout const* layout);
+void Layer_touch(RenderLayer* layer, int topEdge, int botEdge);
+RenderSection* Layer_addSection(RenderLayer* layer, RenderSection const* section);
+RenderSection* Layer_getSection(RenderLayer* layer, char const* sectionKey);
+int Layer_configSection(RenderLayer* layer, RenderSection const* section, RenderSection* previous);
+char Layer_cell(RenderLayer const* layer, int x, int y);
+char const* Layer_span(RenderLayer const* layer, int x, int y, int* len);
+void Layer_write(RenderLayer* layer, RenderSection const* section, int x, int y, char const* text, int len);
+RenderSection* Layer_openOverlay(RenderLayer* layer, RenderSection const* section);
+int Layer_closeOverlay(RenderLayer* layer, char const* sectionKey, RenderSection* closed);
+int Layer_snapshot(RenderLayer* layer, LayerSnapshot* snap);
+int Layer_restore(RenderLayer* layer, LayerSnapshot* snap, int* topEdge, int* botEdge);
+void Layer_dropSnapshot(LayerSnapshot* snap);
+void Layer_blit(RenderLayer* dst, RenderLayer const* src, int leftEdge, int topEdge, int rightEdge, int botEdge);
+void Layer_visitCells(RenderLayer const* layer, LayerCellsCb visit, void* arg);
+void Layer_visitSnapshot(LayerSnapshot const* snap, LayerCellsCb visit, void* arg);
+size_t Layer_poolBytes(void);
+
+#endif // __LAYER_H
@@ -0,0 +1,99 @@
+/**
+ * @file layout_solver.h
+ */
+
+#ifndef __LAYOUT_SOLVER_H
+#define __LAYOUT_SOLVER_H
+
+#include <stdint.h>
+
+#include "render_artist.h"
+
+/**Maximum number of nodes in a layout tree.*/
+#define LAYOUT_MAX_NODES 32
+/**Index of the root node, which is always a container.*/
+#define LAYOUT_ROOT 0
+/**Marks the absence of a node.*/
+#define LAYOUT_NONE (-1)
+/**Maximum size, used when a node has no upper bound.*/
+#define LAYOUT_UNBOUNDED 0xFFFF
+
+/**
+ * @enum LayoutKind
+ * How a node uses its rectangle.
+ */
+typedef enum {
+	LAYOUT_ROW,		///< Children placed left to right
+	LAYOUT_COLUMN,	///< Children placed top to bottom
+	LAYOUT_LEAF,	///< A section
+} LayoutKind;
+
+/**
+ * @struct LayoutRect
+ * Outer rectangle of a node, including its outline.
+ * Adjacent nodes share the outline between them.
+ */
+typedef struct {
+	uint16_t x;	///< Left column
+	uint16_t y;	///< Top row
+	uint16_t w;	///< Width including both outlines
+	uint16_t h;	///< Height including both outlines
+} LayoutRect;
+
+/**
+ * @struct LayoutNode
+ * Container or section in a layout tree.
+ * Constraints apply along the parent's axis and count inner cells.
+ */
+typedef struct {
+	/**Section key, for leaves.*/
+	char	 key[PAINTER_KEY_LEN];
+	/**Row, column or leaf.*/
+	uint8_t	 kind;
+	/**Set when the node's children must be re-solved.*/
+	uint8_t	 dirty;
+	/**Share of the parent's free space relative to siblings.*/
+	uint16_t weight;
+	/**Minimum inner size.*/
+	uint16_t minSize;
+	/**Maximum inner size.*/
+	uint16_t maxSize;
+	/**Parent node.*/
+	int8_t	 parent;
+	/**First child node.*/
+	int8_t	 firstChild;
+	/**Next sibling node.*/
+	int8_t	 nextSibling;
+	/**Solved rectangle.*/
+	LayoutRect rect;
+} LayoutNode;
+
+/**
+ * @struct LayoutTree
+ * Rows and columns of sections, solved against the screen size.
+ */
+typedef struct {
+	/**Nodes, root first.*/
+	LayoutNode nodes[LAYOUT_MAX_NODES];
+	/**Nodes in use.*/
+	uint8_t	 numNodes;
+} LayoutTree;
+
+/**
+ * Called for every leaf whose rectangle changed while solving.
+ *
+ * @param[in] node Leaf with its new rectangle
+ * @param[in] arg  Caller context
+ */
+typedef void (*LayoutMovedCb)(LayoutNode const* node, void* arg);
+
+void LayoutTree_init(LayoutTree* me, LayoutKind rootKind);
+int LayoutTree_add(LayoutTree* me, int parent, LayoutKind kind, char const* key,
+		uint16_t weight, uint16_t minSize, uint16_t maxSize);
+void LayoutTree_setConstraints(LayoutTree* me, int node, uint16_t weight, uint16_t minSize, uint16_t maxSize);
+void LayoutTree_resize(LayoutTree* me, uint16_t width, uint16_t height);
+int LayoutTree_solve(LayoutTree* me, LayoutMovedCb moved, void* arg);
+int LayoutTree_report(LayoutTree const* me, LayoutMovedCb moved, void* arg);
+void LayoutNode_toSection(LayoutNode const* node, RenderSection* section);
+
+#endif // __LAYOUT_SOLVER_H
@@ -11,8 +11,17 @@
 #include <stdlib.h> /* for exit() */
 #include <curses.h>
 
+#include "cell_kernels.h"
+#include "file_system.h"
+#include "glyph.h"
+#include "layer.h"
+#include "metrics.h"
+#include "paint_arena.h"
 #include "render_artist.h"
 #include "screen_painter.h"
+#include "session.h"
+#include "text_search.h"
+#include "ticker.h"
 #include "utilities.h"
 
 /**
@@ -60,25 +69,49 @@ typedef enum {
 	// Subscriptions
 	ENGINE_START_SIG = Q_USER_SIG, ///< Program has initialized the screen
 	ENGINE_END_SIG,		///< Program is ending
-	KEY_DETECT_SIG,		///< Key was detected (posted from KeyMonitor, published from BindingHandler)
+	KEY_DETECT_SIG,		///< Key was detected (posted from KeyMonitor, published from BindingHandler for global bindings)
 	MAX_SUBSCRIBE_SIG,	///< Must be after all subscribe sigs
 
 	// Engine
 	TIMEOUT_SIG,		///< Timeout sig
+	SESSION_START_SIG,	///< Lays out the next session
+	RENDER_CREDIT_SIG,	///< RenderArtist has returned posting credits (posted from RenderArtist)
 
 	// RenderArtist
+	INSTALL_LAYOUT_SIG,	///< Replaces a layer with a compiled layout
 	CREATE_SECTION_SIG,	///< Creates a new section
 	DELETE_SECTION_SIG,	///< Deletes a section
 	CONFIG_SECTION_SIG,	///< Reconfigures a section
 	PAINT_SECTION_SIG,	///< Paints a section
 	PAINT_LINE_SIG,	///< Low-level painting signal
+	RENDER_STEP_SIG,	///< Continues the pending repaints (passed back by the Engine)
+	OPEN_POPUP_SIG,		///< Opens an overlay section above the layer
+	CLOSE_POPUP_SIG,	///< Closes an overlay section, restoring what it covered
+	CHECKPOINT_LAYER_SIG,	///< Adds a snapshot of the base layer to its history
+	UNDO_LAYER_SIG,		///< Restores the latest snapshot of the base layer
+	SEARCH_SIG,			///< Highlights the matches of a query in the base layer
+	ATTACH_VIEW_SIG,	///< Binds a widget to a section
+	VIEW_INPUT_SIG,		///< Passes an input to the widget of a section
+	VIEW_STEP_SIG,		///< Continues the background work of widgets (passed back by the Engine)
 
 	// ScreenPainter
+	PAINT_BLOCK_SIG,	///< Paints a rectangle of a layer in one event
 	REFRESH_SCREEN_SIG,	///< Refreshes screen
 
+	// BindingHandler
+	REGISTER_INPUT_SIG,	///< Registers an input consumer
+	FOCUS_INPUT_SIG,	///< Gives key focus to a registered consumer
+	FOCUS_KEY_SIG,		///< Key for the focused consumer (posted from BindingHandler)
+
 	// KeyMonitor
 	KEY_SCAN_SIG,		///< Checks keyboard input
 
+	// FileSystem
+	FILE_READ_SIG,		///< Reads a whole file
+	FILE_SAVE_SIG,		///< Replaces a file
+	FILE_DONE_SIG,		///< System call of a request finished (posted from the I/O backend)
+	FILE_RESULT_SIG,	///< Request finished (posted to the requester)
+
 	MAX_SIG ///< Must always be last
 } Signals;
 
@@ -88,6 +121,16 @@ typedef enum {
 /// @{
 //////////////////////////////
 
+/**
+ * Event addressed to a single session.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	 evt;
+
+	uint16_t session; ///< Session ID
+} SessionEvt;
+
 /**
  * Section configuration event.
  */
@@ -95,9 +138,45 @@ typedef struct {
 	/**Super*/
 	QEvt	 	  evt;
 
+	uint16_t	  session; ///< Session ID
 	RenderSection section; ///< Section configuration
 } SectionCfgEvt;
 
+/**
+ * Layout installation event.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	 evt;
+
+	uint16_t session; ///< Session ID
+	RenderLayout const* layout; ///< Compiled layout
+} LayoutEvt;
+
+/**
+ * Input consumer event.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	 evt;
+
+	uint16_t session; ///< Session ID
+	QActive* consumer; ///< Object the keys are posted to
+	char	 sectionKey[PAINTER_KEY_LEN]; ///< Section of the consumer, empty for the whole object
+} ConsumerEvt;
+
+/**
+ * Key event for the focused consumer.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	evt;
+
+	uint16_t session; ///< Session ID
+	int		key; ///< Numeric key value
+	char	sectionKey[PAINTER_KEY_LEN]; ///< Focused section, empty for the whole object
+} FocusKeyEvt;
+
 /**
  * Keyboard event.
  */
@@ -105,6 +184,7 @@ typedef struct {
 	/**Super*/
 	QEvt	evt;
 
+	uint16_t session; ///< Session ID
 	int		key; ///< Numeric key value
 } KeyEvt;
 
@@ -115,6 +195,8 @@ typedef struct {
 	/**Super*/
 	QEvt	 evt;
 
+	/**Session ID*/
+	uint16_t session;
 	/**Alphanumeric key used to identify section.*/
 	char	 sectionKey[PAINTER_KEY_LEN];
 
@@ -122,10 +204,101 @@ typedef struct {
 	uint16_t xAnchor;
 	/**Vertical anchor (from top)*/
 	uint16_t yAnchor;
-	/**Line to be painted.*/
-	char canvas[MAX_SCREEN_WIDTH];
+	/**Line to be painted, owned by the receiver.*/
+	PaintRef canvas;
+	/**Length of @ref canvas in bytes.*/
+	uint16_t length;
+	/**Columns the line covers once laid out; UTF-8 can take fewer than @ref length.*/
+	uint16_t columns;
 } PaintEvt;
 
+/**
+ * Block paint event.
+ * References a rectangle of the session's layer rather than copying it;
+ * the painter reads the cells when it handles the event.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	 evt;
+
+	/**Session ID*/
+	uint16_t session;
+	/**Horizontal anchor (from left)*/
+	uint16_t xAnchor;
+	/**Vertical anchor (from top)*/
+	uint16_t yAnchor;
+	/**Columns per row.*/
+	uint16_t width;
+	/**Number of rows.*/
+	uint16_t height;
+	/**Layer version when posted; rows changed since are repainted whole.*/
+	uint32_t version;
+} BlockEvt;
+
+/**
+ * Search query event.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	evt;
+
+	uint16_t session; ///< Session ID
+	uint8_t	length; ///< Length of @ref query, 0 to clear the highlight
+	char	query[SEARCH_MAX_QUERY]; ///< Query, not NUL-terminated
+} SearchEvt;
+
+/**
+ * Section widget event.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	evt;
+
+	uint16_t session; ///< Session ID
+	char	sectionKey[PAINTER_KEY_LEN]; ///< Section of the widget
+	uint8_t	op; ///< Attach: @ref ViewKind; input: @ref ViewOp
+	int32_t	arg; ///< Input: argument of the operation
+	void const* spec; ///< Attach: widget setup, e.g. a TableSpec
+	void*	ctx; ///< Attach: context passed to the widget's source
+} ViewEvt;
+
+/**
+ * File request event.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	 evt;
+
+	QActive* requester; ///< Object the result is posted to
+	uint16_t tag; ///< Caller's request tag
+	char	 path[FILE_PATH_LEN]; ///< File to read or save
+	char*	 data; ///< Save: bytes to write, owned by the FileSystem once posted
+	uint32_t length; ///< Save: bytes in @ref data
+} FileReqEvt;
+
+/**
+ * Completion of a single system call of a file request.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	evt;
+
+	uint16_t job; ///< Request slot
+	int32_t	res; ///< System call result, negative errno on failure
+} FileDoneEvt;
+
+/**
+ * File request result.
+ */
+typedef struct {
+	/**Super*/
+	QEvt	 evt;
+
+	uint16_t tag; ///< Caller's request tag
+	int32_t	 status; ///< 0 on success, negative errno on failure
+	char*	 data; ///< Read: file contents, NUL-terminated, owned by the receiver
+	uint32_t length; ///< Read: bytes in @ref data, not counting the NUL
+} FileResultEvt;
 
 /**
  * Event class for events with a single primitive.
@@ -134,6 +307,8 @@ typedef union {
 	QEvt 	  e1; ///< Smallest event
 	//! @{
 	KeyEvt	  e2;
+	SessionEvt e3;
+	FileDoneEvt e4;
 	//! @}
 } TinyEvt;
 
@@ -144,16 +319,24 @@ typedef union {
 	TinyEvt		  e1; ///< Next smallest event type
 	//! @{
 	SectionCfgEvt e2;
+	LayoutEvt	  e3;
+	PaintEvt	  e4;
+	BlockEvt	  e5;
+	ConsumerEvt	  e6;
+	FocusKeyEvt	  e7;
+	FileResultEvt e8;
+	ViewEvt		  e9;
 	//! @}
 } SmallEvt;
 
 /**
- * Event class for medium-sized events.
+ * Event class for events carrying a path or a query.
  */
 typedef union {
-	SmallEvt e1; ///< Next smallest event type
+	SmallEvt	  e1; ///< Next smallest event type
 	//! @{
-	PaintEvt e2;
+	FileReqEvt	  e2;
+	SearchEvt	  e3;
 	//! @}
 } MediumEvt;
 
@@ -195,34 +378,100 @@ AO_DEF(BindingHandler);
 typedef struct {
 	/**State machine.*/
 	QActive super;
+
+	/**Running average of the time taken to paint a cell, in nanoseconds.*/
+	uint32_t cellNs;
 } ScreenPainter;
 //! @{
 AO_DEF(ScreenPainter);
+uint32_t ScreenPainter_cellCost(void);
 //! @}
 
+/**Painting time allowed per RenderArtist step, in nanoseconds; a slice of a 60 Hz frame.*/
+#define RENDER_SLICE_NS 1000000
+/**Cost per cell assumed until the painter has measured one, 400 cells per slice.*/
+#define RENDER_CELL_NS 2500
+/**Maximum repaints waiting to be sliced.*/
+#define RENDER_MAX_JOBS 16
+/**RenderArtist event queue length.*/
+#define RENDER_QUEUE_LEN 64
+/**
+ * Requests the engine may have in RenderArtist's queue at once. The rest
+ * of the queue is kept for RenderArtist's own @ref RENDER_STEP_SIG and
+ * @ref VIEW_STEP_SIG.
+ */
+#define RENDER_CREDITS (RENDER_QUEUE_LEN - 3)
+
+/**
+ * @struct RenderJob
+ * Rectangle of a session's layer still to be repainted.
+ */
+typedef struct {
+	/**Session ID*/
+	uint16_t session;
+	/**Leftmost column*/
+	uint16_t leftEdge;
+	/**Next row to be repainted*/
+	uint16_t topEdge;
+	/**Rightmost column*/
+	uint16_t rightEdge;
+	/**Bottom-most row*/
+	uint16_t botEdge;
+	/**Set if the screen is refreshed once the rectangle is done.*/
+	uint8_t	 refresh;
+} RenderJob;
+
 /**
  * @struct RenderArtist
  * High-level screen drawing logic.
+ * Sections and layers are kept per session, see Session::layers.
+ *
+ * Every request must be posted with a credit from the engine, so the
+ * queue can never overflow; the credit is returned when the request is
+ * taken off the queue, see RenderArtist_collectCredits().
  */
 typedef struct {
 	/**State machine.*/
 	QActive super;
 
-	/**Sections.*/
-	RenderLayer layers[NUM_LAYERS];
+	/**Pending repaints, oldest first.*/
+	RenderJob jobs[RENDER_MAX_JOBS];
+	/**Index of the oldest pending repaint.*/
+	uint8_t	 firstJob;
+	/**Number of pending repaints.*/
+	uint8_t	 numJobs;
+	/**Set while a @ref RENDER_CREDIT_SIG is on its way to the engine.*/
+	uint8_t	 creditPosted;
+	/**Set while a @ref VIEW_STEP_SIG is queued.*/
+	uint8_t	 viewStepPosted;
+	/**Session the next @ref VIEW_STEP_SIG starts with.*/
+	uint16_t viewSession;
+	/**Credits returned but not yet collected by the engine.*/
+	uint16_t returned;
 } RenderArtist;
 //! @{
 AO_DEF(RenderArtist);
+void RenderArtist_attach(Session* s);
+void RenderArtist_detach(Session* s);
+uint16_t RenderArtist_collectCredits(void);
+int RenderArtist_covers(QEvt const* later, PaintEvt const* current);
 //! @}
 
 /**
  * @ingroup Fwk
  * @struct FileSystem
  * File system interaction logic.
+ * Reads and saves run as a sequence of single system calls, each handed
+ * to an I/O backend and completed by an event, so no handler blocks.
  */
 typedef struct {
 	/**State machine.*/
 	QActive super;
+
+	/**Requests in progress.*/
+	FileJob jobs[FS_MAX_JOBS];
+	/**Set when io_uring is in use rather than worker threads.*/
+	uint8_t uring;
 } FileSystem;
 //! @{
 AO_DEF(FileSystem);
@@ -264,6 +513,9 @@ typedef struct {
 AO_DEF(SaveGenerator);
 //! @}
 
+/**Render requests the engine holds back while it has no credits.*/
+#define ENGINE_BACKLOG_LEN 64
+
 /**
  * @struct Engine
  * Central business logic.
@@ -274,6 +526,13 @@ typedef struct {
 
 	/**Time event.*/
 	QTimeEvt timeEvt;
+
+	/**Requests RenderArtist can still take, see @ref RENDER_CREDITS.*/
+	uint16_t credits;
+	/**Number of held-back requests.*/
+	uint8_t	 numBacklog;
+	/**Render requests held back for lack of credits, oldest first.*/
+	QEvt const* backlog[ENGINE_BACKLOG_LEN];
 } Engine;
 //! @{
 AO_DEF(Engine);
@@ -0,0 +1,87 @@
+/**
+ * @file metrics.h
+ */
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include <stdint.h>
+
+#include "qpc.h"
+
+/**Prometheus text file, formatted with the process ID.*/
+#define METRICS_EXPORT_PATH "/tmp/terminal-interface.%d.prom"
+/**Time between exports, in milliseconds.*/
+#define METRICS_EXPORT_MS 5000
+/**Maximum number of active objects whose queues are sampled.*/
+#define METRICS_MAX_QUEUES 8
+
+/**Histogram sub-buckets per power of two, as bits; 3 bits keeps values within 12.5%.*/
+#define METRICS_SUB_BITS 3
+/**Largest value a histogram tells apart, as bits; about 18 minutes in nanoseconds.*/
+#define METRICS_MAX_BITS 40
+/**Buckets per histogram.*/
+#define METRICS_BUCKETS ((METRICS_MAX_BITS - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+/**
+ * @enum MetricCounter
+ * Monotonic counters.
+ */
+typedef enum {
+	METRIC_FRAMES,			///< Frames presented
+	METRIC_CELLS_PAINTED,	///< Cells handed to curses
+	METRIC_EXPORT_BYTES,	///< Bytes sent to frame viewers
+	METRIC_PAINTS,			///< Line paints drawn
+	METRIC_PAINTS_MERGED,	///< Line paints dropped for a later one covering them
+	METRIC_PAINTS_DROPPED,	///< Line paints lost because the paint arena or render backlog was full
+	METRIC_BLOCKS,			///< Block paints handled
+	METRIC_RENDER_DEFERRED,	///< Render requests held back for lack of credits
+	METRIC_RENDER_DROPPED,	///< Section changes lost because the render backlog was full
+	METRIC_GLYPHS_RECLAIMED,	///< Glyphs freed once no cell held them
+	METRIC_GLYPHS_EXHAUSTED,	///< Times a session's glyph table was full of glyphs in use
+	METRIC_NUM_COUNTERS
+} MetricCounter;
+
+/**
+ * @enum MetricGauge
+ * Values that go up and down.
+ */
+typedef enum {
+	METRIC_SECTIONS,		///< Sections across all sessions
+	METRIC_NUM_GAUGES
+} MetricGauge;
+
+/**
+ * @enum MetricStage
+ * Pipeline stages whose event handling time is tracked.
+ */
+typedef enum {
+	METRIC_STAGE_ENGINE,	///< Engine
+	METRIC_STAGE_RENDER,	///< RenderArtist
+	METRIC_STAGE_PAINT,		///< ScreenPainter, painting blocks
+	METRIC_STAGE_PRESENT,	///< ScreenPainter, refreshing the screen
+	METRIC_STAGE_INPUT,		///< KeyMonitor and BindingHandler
+	METRIC_NUM_STAGES
+} MetricStage;
+
+/**
+ * @struct MetricHistogram
+ * Log-linear histogram in the style of HdrHistogram: each power of two
+ * is split into 2^METRICS_SUB_BITS equal buckets, so the relative error
+ * is bounded while the bucket count stays small.
+ */
+typedef struct {
+	/**Values recorded in each bucket.*/
+	uint64_t buckets[METRICS_BUCKETS];
+	/**Sum of recorded values.*/
+	uint64_t sum;
+} MetricHistogram;
+
+void Metrics_count(MetricCounter counter, uint64_t n);
+void Metrics_adjust(MetricGauge gauge, int64_t delta);
+void Metrics_record(MetricStage stage, uint64_t ns);
+void Metrics_watchQueue(QActive const* ao, char const* name);
+void Metrics_start(void);
+void Metrics_stop(void);
+
+#endif // __METRICS_H
@@ -0,0 +1,26 @@
+/**
+ * @file paint_arena.h
+ */
+
+#ifndef __PAINT_ARENA_H
+#define __PAINT_ARENA_H
+
+#include <stdint.h>
+
+/**Handle of a payload in the paint arena.*/
+typedef uint16_t PaintRef;
+
+/**Handle that refers to no payload.*/
+#define PAINT_REF_NONE ((PaintRef)0xFFFF)
+/**Largest payload the arena can hold.*/
+#define PAINT_ARENA_MAX_LEN 512
+
+void PaintArena_init(void);
+PaintRef PaintArena_alloc(uint16_t len);
+PaintRef PaintArena_copy(char const* text, uint16_t len);
+char* PaintArena_data(PaintRef ref);
+void PaintArena_retain(PaintRef ref);
+void PaintArena_release(PaintRef ref);
+uint32_t PaintArena_inUse(void);
+
+#endif // __PAINT_ARENA_H
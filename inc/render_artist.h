@@ -12,6 +12,12 @@
 #define PAINTER_KEY_LEN 16		///< Size of alphanumeric key used to identify sections/layers
 #define SECTIONS_PER_LAYER 16	///< Maximum number of sections per layer
 #define NUM_LAYERS 4			///< Maximum number of layers
+#define OVERLAYS_PER_LAYER 4	///< Maximum number of open overlays per layer
+#define LAYER_HISTORY_LEN 8		///< Snapshots kept per session
+#define LAYER_TILE_WIDTH 16		///< Columns per layer tile
+#define LAYER_TILE_HEIGHT 8		///< Rows per layer tile
+#define LAYER_TILES_X ((MAX_SCREEN_WIDTH + LAYER_TILE_WIDTH - 1) / LAYER_TILE_WIDTH)		///< Tiles per layer row
+#define LAYER_TILES_Y ((MAX_SCREEN_HEIGHT + LAYER_TILE_HEIGHT - 1) / LAYER_TILE_HEIGHT)	///< Tiles per layer column
 
 
 /**
@@ -33,11 +39,38 @@ typedef struct {
 	uint16_t yDim;
 } RenderSection;
 
+/**
+ * @struct LayerTile
+ * Block of layer cells, allocated only where something is drawn.
+ * Tiles are shared between layers and snapshots and copied before they
+ * are written while shared.
+ */
+typedef struct LayerTile {
+	/**Cells, NUL where nothing is drawn.*/
+	char cells[LAYER_TILE_HEIGHT][LAYER_TILE_WIDTH];
+	/**Layers and snapshots holding the tile; 0 for compiled tiles, which are never freed.*/
+	uint32_t refs;
+	/**Next free tile, while in the pool.*/
+	struct LayerTile* next;
+} LayerTile;
+
+/**
+ * @struct RenderOverlay
+ * Section drawn above the rest of its layer, such as a popup.
+ * The cells it covers are set aside while it is open and put back when it closes.
+ */
+typedef struct {
+	/**Section, including its outline's position.*/
+	RenderSection section;
+	/**Cells under the section and its outline, row by row, NUL where nothing is drawn.*/
+	char*	 saveUnder;
+} RenderOverlay;
+
 /**
  * @struct RenderLayer
  * Flat image that can take up part or all of a screen.
  * Screen manipulation is done by sections, and the layer stores the
- * compiled image.
+ * compiled image in tiles; regions no section covers take no memory.
  */
 typedef struct {
 	/**Alphanumeric key used to identify section.*/
@@ -45,11 +78,49 @@ typedef struct {
 
 	/**Left-most edge of each row, used to minimize paint instructions.*/
 	int16_t	leftEdge[MAX_SCREEN_HEIGHT];
-	/**Compiled screen artwork.*/
-	char	artwork[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];
+	/**Compiled screen artwork, NULL for empty tiles.*/
+	LayerTile* tiles[LAYER_TILES_Y][LAYER_TILES_X];
+	/**Change counter, bumped by every change to the artwork.*/
+	uint32_t version;
+	/**Value of @ref version when each row last changed.*/
+	uint32_t rowVersion[MAX_SCREEN_HEIGHT];
+	/**Non-zero for rows that may hold glyph cells, which the painter expands.*/
+	uint8_t	hasGlyphs[MAX_SCREEN_HEIGHT];
 	/**Sections contained in the layer.*/
 	RenderSection sections[SECTIONS_PER_LAYER];
+	/**Open overlays, in the order they were opened; later ones are on top.*/
+	RenderOverlay overlays[OVERLAYS_PER_LAYER];
+	/**Number of open overlays.*/
+	uint8_t	numOverlays;
 } RenderLayer;
 
+/**
+ * @struct LayerSnapshot
+ * Artwork and sections of a layer at some point, sharing the layer's tiles.
+ */
+typedef struct {
+	/**Left-most edge of each row.*/
+	int16_t	leftEdge[MAX_SCREEN_HEIGHT];
+	/**Rows that may hold glyph cells.*/
+	uint8_t	hasGlyphs[MAX_SCREEN_HEIGHT];
+	/**Tiles, each holding a reference.*/
+	LayerTile* tiles[LAYER_TILES_Y][LAYER_TILES_X];
+	/**Sections.*/
+	RenderSection sections[SECTIONS_PER_LAYER];
+} LayerSnapshot;
+
+/**
+ * @struct LayerHistory
+ * Ring of the latest snapshots of a layer; the oldest is dropped when full.
+ */
+typedef struct {
+	/**Snapshots, oldest at @ref first.*/
+	LayerSnapshot snaps[LAYER_HISTORY_LEN];
+	/**Index of the oldest snapshot.*/
+	uint8_t	first;
+	/**Number of snapshots.*/
+	uint8_t	count;
+} LayerHistory;
+
 
 #endif // __RENDER_ARTIST_H
@@ -0,0 +1,111 @@
+/**
+ * @file section_view.h
+ */
+
+#ifndef __SECTION_VIEW_H
+#define __SECTION_VIEW_H
+
+#include <stdint.h>
+
+#include "chart_view.h"
+#include "layer.h"
+#include "table_view.h"
+#include "text_wrap.h"
+
+/**Maximum number of sections per session drawn by a widget.*/
+#define VIEWS_PER_SESSION 4
+/**Index work done for a view per RenderArtist step, about a millisecond of sorting.*/
+#define VIEW_STEP_ROWS 16384
+/**Work charged for rewrapping a paragraph after a resize, in index rows.*/
+#define VIEW_PARA_COST 16
+
+/**
+ * @enum ViewKind
+ * Widget drawing a section.
+ */
+typedef enum {
+	VIEW_NONE,	///< Free slot
+	VIEW_TABLE,	///< @ref TableView
+	VIEW_WRAP,	///< @ref WrapText, lines painted to it set its paragraphs
+	VIEW_CHART,	///< @ref ChartView
+} ViewKind;
+
+/**
+ * @enum ViewOp
+ * Input to a bound widget.
+ */
+typedef enum {
+	VIEW_DATA,			///< Source changed, argument unused
+	VIEW_MOVE,			///< Moves the cursor, or scrolls, by the argument
+	VIEW_SORT,			///< Sorts by column, again to reverse; -1 for source order
+	VIEW_WIDEN,			///< Widens the sort column by the argument, negative to narrow
+	VIEW_SAMPLE,		///< Adds the argument to a chart's series
+	VIEW_FILTER,		///< Shows the rows a table's filter keeps for the argument; -1 for every row
+} ViewOp;
+
+/**
+ * @struct TableSpec
+ * Source and columns of a table bound to a section.
+ */
+typedef struct {
+	/**Data behind the table; the context is given when binding.*/
+	TableSource source;
+	/**Columns, in display order.*/
+	TableColumn columns[TABLE_MAX_COLUMNS];
+	/**Number of columns.*/
+	uint8_t	 numColumns;
+	/**Row filter applied by @ref VIEW_FILTER, or NULL.*/
+	TableFilter filter;
+} TableSpec;
+
+/**
+ * @struct ChartSpec
+ * Series and scale of a chart bound to a section.
+ */
+typedef struct {
+	/**Samples kept, spread over the section's columns.*/
+	uint32_t capacity;
+	/**Value at the bottom.*/
+	float	 scaleLo;
+	/**Value at the top; at or below @ref scaleLo to fit the visible samples.*/
+	float	 scaleHi;
+} ChartSpec;
+
+/**
+ * @struct SectionView
+ * Widget that draws the inside of a section. RenderArtist drives it:
+ * inputs and resizes update the widget, and only the rows it renders
+ * again are written to the layer.
+ */
+typedef struct {
+	/**Section drawn, empty for a free slot.*/
+	char	key[PAINTER_KEY_LEN];
+	/**Widget kind, see @ref ViewKind.*/
+	uint8_t	kind;
+	/**Row filter of a table, from its @ref TableSpec.*/
+	TableFilter filter;
+	/**Widget.*/
+	union {
+		TableView table;
+		WrapText  wrap;
+		ChartView chart;
+	} w;
+} SectionView;
+
+void SectionView_init(SectionView views[VIEWS_PER_SESSION]);
+void SectionView_freeAll(SectionView views[VIEWS_PER_SESSION]);
+SectionView* SectionView_find(SectionView views[VIEWS_PER_SESSION], char const* sectionKey);
+SectionView* SectionView_bindTable(SectionView views[VIEWS_PER_SESSION], RenderSection const* section,
+		TableSpec const* spec, void* ctx);
+SectionView* SectionView_bindWrap(SectionView views[VIEWS_PER_SESSION], RenderSection const* section);
+SectionView* SectionView_bindChart(SectionView views[VIEWS_PER_SESSION], RenderSection const* section,
+		ChartSpec const* spec);
+void SectionView_resize(SectionView* view, RenderSection const* section);
+int SectionView_text(SectionView* view, uint32_t para, char const* text, uint32_t len);
+void SectionView_visitCells(SectionView views[VIEWS_PER_SESSION], LayerCellsCb visit, void* arg);
+int SectionView_search(SectionView views[VIEWS_PER_SESSION], char const* query, uint32_t len);
+void SectionView_input(SectionView* view, ViewOp op, int32_t arg);
+int SectionView_step(SectionView* view, uint32_t budget);
+int SectionView_draw(SectionView* view, RenderLayer* layer, int* topEdge, int* botEdge);
+
+#endif // __SECTION_VIEW_H
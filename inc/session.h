@@ -0,0 +1,133 @@
+/**
+ * @file session.h
+ */
+
+#ifndef __SESSION_H
+#define __SESSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <curses.h>
+
+#include "qpc.h"
+#include "frame_exporter.h"
+#include "glyph.h"
+#include "layout_solver.h"
+#include "metrics.h"
+#include "render_artist.h"
+#include "section_view.h"
+#include "text_search.h"
+
+/**Maximum number of terminals served by one process.*/
+#define MAX_SESSIONS 256
+
+/**Maximum number of input consumers per session.*/
+#define INPUT_MAX_CONSUMERS 8
+
+/**
+ * @struct InputConsumer
+ * Object, or section of an object, that takes keys while it has focus.
+ */
+typedef struct {
+	/**Object the keys are posted to.*/
+	QActive* ao;
+	/**Section the consumer draws into, empty for the whole object.*/
+	char	 sectionKey[PAINTER_KEY_LEN];
+} InputConsumer;
+
+/**
+ * @struct SessionStats
+ * Resource usage accounted to a session.
+ */
+typedef struct {
+	/**Time spent handling the session's events, in nanoseconds.*/
+	uint64_t busyNs;
+	/**Number of events handled for the session.*/
+	uint32_t events;
+	/**Paints dropped because a queued paint overwrote them.*/
+	uint32_t merged;
+	/**Heap allocated by curses for the session's screen.*/
+	size_t	 termBytes;
+} SessionStats;
+
+/**
+ * @struct Session
+ * A single terminal served by the process.
+ * Holds the per-session state of each active object; the active objects
+ * themselves are shared and select the session from the event they handle.
+ */
+typedef struct {
+	/**Session ID, carried by every session event.*/
+	uint16_t id;
+	/**Terminal device, or NULL for the controlling terminal.*/
+	char const* path;
+
+	/**Curses screen.*/
+	SCREEN*	term;
+	/**Curses input stream.*/
+	FILE*	in;
+	/**Curses output stream.*/
+	FILE*	out;
+	/**Input descriptor, -1 while the session is not open.*/
+	int		fd;
+
+	/**RenderArtist: compiled layers.*/
+	RenderLayer layers[NUM_LAYERS];
+	/**RenderArtist: snapshots of the base layer.*/
+	LayerHistory history;
+	/**RenderArtist: search matches, highlighted by the ScreenPainter.*/
+	TextSearch search;
+	/**RenderArtist: widgets bound to sections.*/
+	SectionView views[VIEWS_PER_SESSION];
+	/**RenderArtist: glyphs the session's cells refer to.*/
+	GlyphTable glyphs;
+	/**ScreenPainter: frame stream for viewers.*/
+	FrameExporter exporter;
+	/**ScreenPainter: layer version of each row when it was last painted whole.*/
+	uint32_t painted[MAX_SCREEN_HEIGHT];
+	/**BindingHandler: registered input consumers.*/
+	InputConsumer consumers[INPUT_MAX_CONSUMERS];
+	/**BindingHandler: number of registered input consumers.*/
+	uint8_t	numConsumers;
+	/**BindingHandler: consumer with focus.*/
+	uint8_t	focus;
+	/**KeyMonitor: scans left before input is assumed drained.*/
+	uint8_t	scanGrace;
+	/**Engine: next test section to paint.*/
+	uint8_t	nextSec;
+	/**Engine: set while the help popup is open.*/
+	uint8_t	helpOpen;
+	/**Engine: set while keys are typed into the search query.*/
+	uint8_t	searching;
+	/**Engine: length of @ref query.*/
+	uint8_t	queryLen;
+	/**Engine: search query being typed.*/
+	char	query[SEARCH_MAX_QUERY];
+	/**Engine: rows in the job table.*/
+	uint32_t jobs;
+	/**Engine: column the job table is sorted by, -1 for job order.*/
+	int8_t	jobSort;
+	/**Engine: job state the job table shows, -1 for every job.*/
+	int8_t	jobFilter;
+	/**Engine: paragraphs written to the log section.*/
+	uint16_t logLines;
+	/**Engine: Session_clock() at the last typed key, 0 before the first.*/
+	uint64_t lastKeyAt;
+	/**Engine: resizable layout, solved when the terminal size changes.*/
+	LayoutTree layout;
+
+	/**Resource usage.*/
+	SessionStats stats;
+} Session;
+
+int Session_add(char const* path);
+int Session_count(void);
+Session* Session_get(uint16_t id);
+int Session_open(uint16_t id);
+void Session_select(Session* s);
+void Session_closeAll(void);
+uint64_t Session_clock(void);
+void Session_charge(Session* s, MetricStage stage, uint64_t start);
+void Session_report(void);
+
+#endif // __SESSION_H
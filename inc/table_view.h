@@ -0,0 +1,154 @@
+/**
+ * @file table_view.h
+ */
+
+#ifndef __TABLE_VIEW_H
+#define __TABLE_VIEW_H
+
+#include <stdint.h>
+
+#include "screen_painter.h"
+
+/**Maximum number of columns in a table.*/
+#define TABLE_MAX_COLUMNS 8
+/**Size of a column title.*/
+#define TABLE_TITLE_LEN 16
+/**Marks the absence of a row.*/
+#define TABLE_NO_ROW UINT32_MAX
+/**Appended rows kept in the sorted tail before it is merged into the index.*/
+#define TABLE_TAIL_MAX 1024
+
+/**
+ * @struct TableSource
+ * Column-oriented data behind a table. Rows are identified by their
+ * position in the source and may only be appended.
+ */
+typedef struct {
+	/**Returns the current number of rows.*/
+	uint32_t (*numRows)(void* ctx);
+	/**Writes at most @p width characters of a cell and returns the count.*/
+	int (*format)(void* ctx, uint32_t row, int column, char* buf, int width);
+	/**Orders two rows by a column, like strcmp.*/
+	int (*compare)(void* ctx, int column, uint32_t a, uint32_t b);
+	/**Passed to every callback.*/
+	void* ctx;
+} TableSource;
+
+/**
+ * Decides whether a row is shown.
+ *
+ * @param[in] ctx Source context
+ * @param[in] row Source row
+ * @param[in] arg Filter argument
+ *
+ * @returns Non-zero to show the row
+ */
+typedef int (*TableFilter)(void* ctx, uint32_t row, void* arg);
+
+/**
+ * Receives one formatted line of the viewport.
+ *
+ * @param[in] y	   Line within the viewport, 0 being the header
+ * @param[in] text Line, padded to the viewport width and NUL-terminated
+ * @param[in] arg  Caller context
+ */
+typedef void (*TableLineCb)(int y, char const* text, void* arg);
+
+/**
+ * @struct TableColumn
+ * Displayed column.
+ */
+typedef struct {
+	/**Header text.*/
+	char	 title[TABLE_TITLE_LEN];
+	/**Width in characters.*/
+	uint16_t width;
+} TableColumn;
+
+/**
+ * @struct TableView
+ * Scrollable view of a table source.
+ * Only the rows in the viewport are ever formatted. The order of the
+ * shown rows is kept in an index that is rebuilt or extended a bounded
+ * amount of work at a time, see TableView_step(). A few appended rows
+ * are inserted into a small sorted tail shown alongside the index, and
+ * merged into it only once the tail is full.
+ */
+typedef struct {
+	/**Data behind the table.*/
+	TableSource source;
+	/**Displayed columns.*/
+	TableColumn columns[TABLE_MAX_COLUMNS];
+	/**Number of displayed columns.*/
+	uint8_t	 numColumns;
+	/**Sort column, or -1 for source order.*/
+	int8_t	 sortColumn;
+	/**Set to sort in descending order.*/
+	uint8_t	 descending;
+	/**Set when the viewport must be rendered again.*/
+	uint8_t	 dirty;
+	/**Row filter, or NULL to show every row.*/
+	TableFilter filter;
+	/**Passed to @ref filter.*/
+	void*	 filterArg;
+
+	/**Viewport width.*/
+	uint16_t width;
+	/**Viewport height, including the header.*/
+	uint16_t height;
+	/**Position of the first row in the viewport.*/
+	uint32_t top;
+	/**Position of the cursor.*/
+	uint32_t cursor;
+
+	/**Shown rows in display order.*/
+	uint32_t* index;
+	/**Number of shown rows.*/
+	uint32_t numIndexed;
+	/**Source rows not yet in the index.*/
+	uint32_t* tail;
+	/**Number of rows in @ref tail.*/
+	uint32_t numTail;
+	/**Rows at the start of @ref tail that are sorted and shown.*/
+	uint32_t numLive;
+	/**Index rows ahead of each shown tail row, TABLE_TAIL_MAX entries.*/
+	uint32_t* rank;
+	/**Scratch space for sorting @ref tail.*/
+	uint32_t* scratch;
+	/**Next index, merged from @ref index and @ref tail.*/
+	uint32_t* merged;
+	/**Rows each buffer can hold.*/
+	uint32_t capacity;
+	/**Source rows taken into the pipeline.*/
+	uint32_t scanned;
+
+	/**Stage of the index pipeline.*/
+	uint8_t	 stage;
+	/**Set when the next index replaces the current one instead of extending it.*/
+	uint8_t	 rebuild;
+	/**Sort: length of the runs being merged.*/
+	uint32_t runWidth;
+	/**Sort: start of the run pair being merged.*/
+	uint32_t runStart;
+	/**Merge position in the first input.*/
+	uint32_t posA;
+	/**Merge position in the second input.*/
+	uint32_t posB;
+	/**Merge position in the output.*/
+	uint32_t posOut;
+} TableView;
+
+void TableView_init(TableView* me, TableSource const* source, uint16_t width, uint16_t height);
+void TableView_free(TableView* me);
+int TableView_addColumn(TableView* me, char const* title, uint16_t width);
+void TableView_resizeColumn(TableView* me, int column, int delta);
+void TableView_resize(TableView* me, uint16_t width, uint16_t height);
+void TableView_sortBy(TableView* me, int column, int descending);
+void TableView_setFilter(TableView* me, TableFilter filter, void* arg);
+int TableView_step(TableView* me, uint32_t budget);
+void TableView_moveCursor(TableView* me, int32_t delta);
+uint32_t TableView_numShown(TableView const* me);
+uint32_t TableView_selected(TableView const* me);
+int TableView_render(TableView* me, TableLineCb line, void* arg);
+
+#endif // __TABLE_VIEW_H
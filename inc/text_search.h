@@ -0,0 +1,53 @@
+/**
+ * @file text_search.h
+ */
+
+#ifndef __TEXT_SEARCH_H
+#define __TEXT_SEARCH_H
+
+#include <stdint.h>
+
+#include "layer.h"
+
+/**Size of a search query, NUL included.*/
+#define SEARCH_MAX_QUERY 32
+/**Words of a row's highlight mask.*/
+#define SEARCH_MASK_WORDS ((MAX_SCREEN_WIDTH + 31) / 32)
+
+/**
+ * Sets the video attribute of a run of cells in a row.
+ *
+ * @param[in] y		  Row
+ * @param[in] col	  First column
+ * @param[in] len	  Number of cells
+ * @param[in] reverse Set for reverse video, clear for normal
+ * @param[in] arg	  Caller context
+ */
+typedef void (*SearchAttrCb)(int y, int col, int len, int reverse, void* arg);
+
+/**
+ * @struct TextSearch
+ * Matches of a query in a layer, kept as a highlight mask per row.
+ * Each row remembers the layer version it was scanned at, so only rows
+ * that changed since are scanned again.
+ */
+typedef struct {
+	/**Query, NUL-terminated; empty for no search.*/
+	char	 query[SEARCH_MAX_QUERY];
+	/**Length of @ref query.*/
+	uint8_t	 length;
+	/**Layer version of each row when it was last scanned, 0 for never.*/
+	uint32_t scanned[MAX_SCREEN_HEIGHT];
+	/**Matched cells of each row, a bit per cell.*/
+	uint32_t mask[MAX_SCREEN_HEIGHT][SEARCH_MASK_WORDS];
+	/**Matches in each row.*/
+	uint8_t	 hits[MAX_SCREEN_HEIGHT];
+} TextSearch;
+
+void TextSearch_init(TextSearch* me);
+int TextSearch_setQuery(TextSearch* me, RenderLayer* layer, char const* query, int len, int* topEdge, int* botEdge);
+uint32_t const* TextSearch_row(TextSearch* me, RenderLayer const* layer, int y);
+void TextSearch_highlight(TextSearch* me, RenderLayer const* layer, int y, SearchAttrCb attr, void* arg);
+int TextSearch_count(TextSearch const* me);
+
+#endif // __TEXT_SEARCH_H
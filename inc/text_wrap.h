@@ -0,0 +1,89 @@
+/**
+ * @file text_wrap.h
+ */
+
+#ifndef __TEXT_WRAP_H
+#define __TEXT_WRAP_H
+
+#include <stdint.h>
+
+#include "screen_painter.h"
+
+/**
+ * Receives one line of the viewport.
+ *
+ * @param[in] y	   Line within the viewport
+ * @param[in] text Line, padded to the viewport width and NUL-terminated
+ * @param[in] arg  Caller context
+ */
+typedef void (*WrapLineCb)(int y, char const* text, void* arg);
+
+/**
+ * @struct WrapParagraph
+ * Text up to a newline, with the offsets its wrapped lines start at.
+ */
+typedef struct {
+	/**Text, without the newline.*/
+	char*	 text;
+	/**Bytes in @ref text.*/
+	uint32_t length;
+	/**Size of @ref text.*/
+	uint32_t capacity;
+	/**Offset in @ref text of each wrapped line; the first is always 0.*/
+	uint32_t* lines;
+	/**Number of wrapped lines, at least 1.*/
+	uint32_t numLines;
+	/**Size of @ref lines.*/
+	uint32_t lineCapacity;
+	/**Width the paragraph is wrapped at.*/
+	uint16_t width;
+} WrapParagraph;
+
+/**
+ * @struct WrapText
+ * Word-wrapped document shown through a viewport that fits a section.
+ * Each paragraph keeps its own line breaks, and a Fenwick tree over the
+ * paragraphs' line counts maps between document lines and paragraphs in
+ * logarithmic time. Edits rewrap only the paragraphs they touch. A width
+ * change rewraps what is in view at once and the rest a bounded amount
+ * at a time, see WrapText_step().
+ */
+typedef struct {
+	/**Paragraphs in document order.*/
+	WrapParagraph* paras;
+	/**Number of paragraphs.*/
+	uint32_t numParas;
+	/**Size of @ref paras.*/
+	uint32_t capacity;
+	/**Fenwick tree of line counts, indexed from 1.*/
+	uint32_t* tree;
+	/**Wrapped lines in the document.*/
+	uint32_t numLines;
+
+	/**Viewport width, which is also the wrap width.*/
+	uint16_t width;
+	/**Viewport height.*/
+	uint16_t height;
+	/**Document line at the top of the viewport.*/
+	uint32_t top;
+	/**Set while the viewport shows the last line, so appended lines scroll into view.*/
+	uint8_t	 follow;
+	/**Set when the viewport must be rendered again.*/
+	uint8_t	 dirty;
+	/**First paragraph that may still be wrapped at an earlier width.*/
+	uint32_t reflow;
+} WrapText;
+
+void WrapText_init(WrapText* me, uint16_t width, uint16_t height);
+void WrapText_free(WrapText* me);
+int WrapText_append(WrapText* me, char const* text, uint32_t len);
+int WrapText_edit(WrapText* me, uint32_t para, char const* text, uint32_t len);
+void WrapText_resize(WrapText* me, uint16_t width, uint16_t height);
+int WrapText_step(WrapText* me, uint32_t budget);
+void WrapText_scroll(WrapText* me, int32_t delta);
+uint32_t WrapText_locate(WrapText const* me, uint32_t line, uint32_t* offset);
+uint32_t WrapText_lineOf(WrapText const* me, uint32_t para, uint32_t offset);
+int WrapText_find(WrapText const* me, char const* needle, uint32_t len, uint32_t* para, uint32_t* offset);
+int WrapText_render(WrapText* me, WrapLineCb line, void* arg);
+
+#endif // __TEXT_WRAP_H
@@ -0,0 +1,55 @@
+/**
+ * @file ticker.h
+ */
+
+#ifndef __TICKER_H
+#define __TICKER_H
+
+#include "qpc.h"
+#include "session.h"
+
+/**
+ * Set to 1 to drive the QF clock from the tickless ticker instead of the
+ * port's fixed-rate ticker thread.
+ */
+#ifndef BSP_TICKLESS
+#define BSP_TICKLESS 0
+#endif
+
+/**Maximum number of input descriptors the ticker can watch, one per session.*/
+#define TICKER_MAX_INPUTS MAX_SESSIONS
+/**Maximum number of input-gated time events.*/
+#define TICKER_MAX_GATED 4
+/**Ticks after input activity during which gated time events run normally.*/
+#define TICKER_INPUT_GRACE 10
+
+#if BSP_TICKLESS
+
+void Ticker_start(void);
+void Ticker_stop(void);
+void Ticker_wake(void);
+void Ticker_watchInput(int fd);
+void Ticker_gateOnInput(QTimeEvt const * te);
+
+/**
+ * Arms a time event and lets the ticker re-evaluate its next deadline.
+ */
+#define TICKER_ARM(te_, nTicks_, interval_) do { \
+		QTimeEvt_armX((te_), (nTicks_), (interval_)); \
+		Ticker_wake(); \
+	} while (0)
+
+#else
+
+#define Ticker_start()			((void)0)
+#define Ticker_stop()			((void)0)
+#define Ticker_wake()			((void)0)
+#define Ticker_watchInput(fd_)	((void)(fd_))
+#define Ticker_gateOnInput(te_)	((void)(te_))
+
+#define TICKER_ARM(te_, nTicks_, interval_) \
+		QTimeEvt_armX((te_), (nTicks_), (interval_))
+
+#endif // BSP_TICKLESS
+
+#endif // __TICKER_H
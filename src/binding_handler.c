@@ -3,8 +3,20 @@
  * BindingHandler, toot toot.
  */
 
+#include <string.h>
+
 #include "main.h"
 
+/**Key that moves focus to the next consumer.*/
+#define FOCUS_NEXT_KEY '\t'
+
+/**
+ * Keys bound for every object, published instead of routed to the focus.
+ */
+static const int l_globalKeys[] = {
+	KEY_RESIZE,
+};
+
 static QState BindingHandler_initial(BindingHandler * const me, QEvt const * const e);
 static QState Idle(BindingHandler * const me, QEvt const * const e);
 
@@ -19,16 +31,95 @@ static QState Idle(BindingHandler * const me, QEvt const * const e);
 /**
  * Notifies other objects that a key was pressed.
  *
- * @param[in] key Key ID
+ * @param[in] session Session ID
+ * @param[in] key	  Key ID
  */
-static void publish_KEY_DETECT(int key) {
+static void publish_KEY_DETECT(uint16_t session, int key) {
 	KeyEvt* e = Q_NEW(KeyEvt, KEY_DETECT_SIG);
 	if (e) {
+		e->session = session;
 		e->key = key;
 		QF_PUBLISH((QEvt *)e, AO_BindingHandler);
 	}
 }
 
+/**
+ * Passes a key to the object that has focus.
+ *
+ * @ref FOCUS_KEY_SIG
+ *
+ * @param[in] session  Session ID
+ * @param[in] consumer Focused consumer
+ * @param[in] key	   Key ID
+ */
+static void post_FOCUS_KEY(uint16_t session, InputConsumer const* consumer, int key) {
+	FocusKeyEvt* e = Q_NEW(FocusKeyEvt, FOCUS_KEY_SIG);
+	if (e) {
+		e->session = session;
+		e->key = key;
+		snprintf(e->sectionKey, sizeof(e->sectionKey), "%s", consumer->sectionKey);
+		QACTIVE_POST(consumer->ao, (QEvt *)e, AO_BindingHandler);
+	}
+}
+
+/// @}
+/////////////////////////////////////////
+
+/**
+ * Checks whether a key is bound for every object.
+ *
+ * @param[in] key Key ID
+ *
+ * @returns Non-zero for global bindings
+ */
+static int is_global(int key) {
+	for (unsigned i = 0; i < Q_DIM(l_globalKeys); i++) {
+		if (l_globalKeys[i] == key) { return 1; }
+	}
+	return 0;
+}
+
+/**
+ * Looks up a registered consumer.
+ *
+ * @param[in] s	Session
+ * @param[in] e	Consumer event
+ *
+ * @returns Consumer index, or -1 if not registered
+ */
+static int find_consumer(Session const* s, ConsumerEvt const* e) {
+	for (int i = 0; i < s->numConsumers; i++) {
+		if (s->consumers[i].ao == e->consumer
+				&& !strncmp(s->consumers[i].sectionKey, e->sectionKey, PAINTER_KEY_LEN)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Routes a key: global bindings are published, focus keys are handled
+ * here, everything else goes to the focused consumer only.
+ *
+ * @param[in,out] s	  Session
+ * @param[in]	  key Key ID
+ */
+static void route_key(Session* s, int key) {
+	if (is_global(key)) {
+		publish_KEY_DETECT(s->id, key);
+	} else if (s->numConsumers == 0) {
+		return;
+	} else if (key == FOCUS_NEXT_KEY) {
+		s->focus = (s->focus + 1) % s->numConsumers;
+	} else {
+		post_FOCUS_KEY(s->id, &s->consumers[s->focus], key);
+	}
+}
+
+//////////////////////////////////////////
+/// @addtogroup AOBindingHandler
+/// @{
+
 /**
  * Local reference.
  */
@@ -60,8 +151,39 @@ static QState Idle(BindingHandler * const me, QEvt const * const e) {
 	switch (e->sig) {
 	/// - @ref KEY_DETECT_SIG
 	case KEY_DETECT_SIG: {
-		int key = ((KeyEvt *)e)->key;
-		publish_KEY_DETECT(key);
+		KeyEvt* keyEvt = (KeyEvt *)e;
+		Session* s = Session_get(keyEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		route_key(s, keyEvt->key);
+		Session_charge(s, METRIC_STAGE_INPUT, start);
+		return Q_HANDLED();
+	}
+	/// - @ref REGISTER_INPUT_SIG
+	case REGISTER_INPUT_SIG: {
+		ConsumerEvt* consumerEvt = (ConsumerEvt *)e;
+		Session* s = Session_get(consumerEvt->session);
+		if (s == NULL || s->numConsumers == INPUT_MAX_CONSUMERS
+				|| find_consumer(s, consumerEvt) >= 0) {
+			return Q_HANDLED();
+		}
+
+		InputConsumer* consumer = &s->consumers[s->numConsumers++];
+		consumer->ao = consumerEvt->consumer;
+		strncpy(consumer->sectionKey, consumerEvt->sectionKey, PAINTER_KEY_LEN);
+		return Q_HANDLED();
+	}
+	/// - @ref FOCUS_INPUT_SIG
+	case FOCUS_INPUT_SIG: {
+		ConsumerEvt* consumerEvt = (ConsumerEvt *)e;
+		Session* s = Session_get(consumerEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		int idx = find_consumer(s, consumerEvt);
+		if (idx >= 0) {
+			s->focus = idx;
+		}
 		return Q_HANDLED();
 	}
 	}
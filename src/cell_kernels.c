@@ -0,0 +1,386 @@
+/**
+ * @file cell_kernels.c
+ * Fill, border, blit and find kernels for layer cells.
+ *
+ * Each kernel has a scalar version and, on x86, SSE2 and AVX2 versions
+ * that handle 16 or 32 cells per step with a scalar tail. The vector
+ * finds compare the needle's first and last bytes at 16 or 32 offsets
+ * at once and check only the offsets where both match; the scalar one
+ * skips to candidates with memchr(). The range kernels fold chart
+ * samples into a minimum and maximum, 8 or 16 floats per step. The AVX2
+ * versions never call the SSE2 ones, whose legacy encoding would pay
+ * for the switch out of 256-bit state on every call. Cells_init()
+ * picks the widest set the CPU supports; until then the scalar set is
+ * used, so build-time tools work without calling it.
+ */
+
+#include <string.h>
+
+#include "cell_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CELLS_X86 1
+#include <immintrin.h>
+#else
+#define CELLS_X86 0
+#endif
+
+/**Corner character that borders must not overwrite.*/
+#define JOIN '+'
+
+/////////////////////////////////////////
+/// Scalar
+/////////////////////////////////////////
+
+static void fill_scalar(char* dst, char c, size_t n) {
+	memset(dst, c, n);
+}
+
+static void border_scalar(char* dst, char border, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		if (dst[i] != JOIN) {
+			dst[i] = border;
+		}
+	}
+}
+
+static void blit_scalar(char* dst, char const* src, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		if (src[i] != '\0') {
+			dst[i] = src[i];
+		}
+	}
+}
+
+static size_t find_scalar(char const* cells, size_t n, char const* needle, size_t m) {
+	if (m == 0) { return 0; }
+	size_t i = 0;
+	while (i + m <= n) {
+		char const* p = memchr(&cells[i], needle[0], n - m + 1 - i);
+		if (p == NULL) { break; }
+		i = (size_t)(p - cells);
+		if (memcmp(p, needle, m) == 0) { return i; }
+		i++;
+	}
+	return n;
+}
+
+static void range_scalar(float const* v, size_t n, float* lo, float* hi) {
+	float l = *lo;
+	float h = *hi;
+	for (size_t i = 0; i < n; i++) {
+		if (v[i] < l) { l = v[i]; }
+		if (v[i] > h) { h = v[i]; }
+	}
+	*lo = l;
+	*hi = h;
+}
+
+static const CellKernels l_scalar = { "scalar", fill_scalar, border_scalar, blit_scalar, find_scalar, range_scalar };
+
+#if CELLS_X86
+
+/////////////////////////////////////////
+/// SSE2
+/////////////////////////////////////////
+
+__attribute__((target("sse2")))
+static void fill_sse2(char* dst, char c, size_t n) {
+	__m128i v = _mm_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		_mm_storeu_si128((__m128i *)&dst[i], v);
+	}
+	fill_scalar(&dst[i], c, n - i);
+}
+
+__attribute__((target("sse2")))
+static void border_sse2(char* dst, char border, size_t n) {
+	__m128i join = _mm_set1_epi8(JOIN);
+	__m128i fill = _mm_set1_epi8(border);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i cur = _mm_loadu_si128((__m128i const *)&dst[i]);
+		__m128i keep = _mm_cmpeq_epi8(cur, join);
+		_mm_storeu_si128((__m128i *)&dst[i],
+				_mm_or_si128(_mm_and_si128(keep, cur), _mm_andnot_si128(keep, fill)));
+	}
+	border_scalar(&dst[i], border, n - i);
+}
+
+__attribute__((target("sse2")))
+static void blit_sse2(char* dst, char const* src, size_t n) {
+	__m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i s = _mm_loadu_si128((__m128i const *)&src[i]);
+		__m128i d = _mm_loadu_si128((__m128i const *)&dst[i]);
+		__m128i empty = _mm_cmpeq_epi8(s, zero);
+		_mm_storeu_si128((__m128i *)&dst[i],
+				_mm_or_si128(_mm_and_si128(empty, d), _mm_andnot_si128(empty, s)));
+	}
+	blit_scalar(&dst[i], &src[i], n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t find_sse2(char const* cells, size_t n, char const* needle, size_t m) {
+	if (m == 0) { return 0; }
+	__m128i first = _mm_set1_epi8(needle[0]);
+	__m128i last = _mm_set1_epi8(needle[m - 1]);
+	size_t i = 0;
+	for (; i + m + 15 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((__m128i const *)&cells[i]);
+		__m128i b = _mm_loadu_si128((__m128i const *)&cells[i + m - 1]);
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask != 0) {
+			unsigned bit = (unsigned)__builtin_ctz(mask);
+			if (memcmp(&cells[i + bit], needle, m) == 0) { return i + bit; }
+			mask &= mask - 1;
+		}
+	}
+	return i + find_scalar(&cells[i], n - i, needle, m);
+}
+
+__attribute__((target("sse2")))
+static void range_sse2(float const* v, size_t n, float* lo, float* hi) {
+	size_t i = 0;
+	if (n >= 8) {
+		__m128 l0 = _mm_set1_ps(*lo), l1 = l0;
+		__m128 h0 = _mm_set1_ps(*hi), h1 = h0;
+		for (; i + 8 <= n; i += 8) {
+			__m128 a = _mm_loadu_ps(&v[i]);
+			__m128 b = _mm_loadu_ps(&v[i + 4]);
+			l0 = _mm_min_ps(l0, a);
+			h0 = _mm_max_ps(h0, a);
+			l1 = _mm_min_ps(l1, b);
+			h1 = _mm_max_ps(h1, b);
+		}
+		l0 = _mm_min_ps(l0, l1);
+		h0 = _mm_max_ps(h0, h1);
+		l0 = _mm_min_ps(l0, _mm_shuffle_ps(l0, l0, _MM_SHUFFLE(1, 0, 3, 2)));
+		h0 = _mm_max_ps(h0, _mm_shuffle_ps(h0, h0, _MM_SHUFFLE(1, 0, 3, 2)));
+		l0 = _mm_min_ps(l0, _mm_shuffle_ps(l0, l0, _MM_SHUFFLE(2, 3, 0, 1)));
+		h0 = _mm_max_ps(h0, _mm_shuffle_ps(h0, h0, _MM_SHUFFLE(2, 3, 0, 1)));
+		*lo = _mm_cvtss_f32(l0);
+		*hi = _mm_cvtss_f32(h0);
+	}
+	range_scalar(&v[i], n - i, lo, hi);
+}
+
+static const CellKernels l_sse2 = { "sse2", fill_sse2, border_sse2, blit_sse2, find_sse2, range_sse2 };
+
+/////////////////////////////////////////
+/// AVX2
+/////////////////////////////////////////
+
+__attribute__((target("avx2")))
+static void fill_avx2(char* dst, char c, size_t n) {
+	__m256i v = _mm256_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		_mm256_storeu_si256((__m256i *)&dst[i], v);
+	}
+	fill_scalar(&dst[i], c, n - i);
+}
+
+__attribute__((target("avx2")))
+static void border_avx2(char* dst, char border, size_t n) {
+	__m256i join = _mm256_set1_epi8(JOIN);
+	__m256i fill = _mm256_set1_epi8(border);
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i cur = _mm256_loadu_si256((__m256i const *)&dst[i]);
+		__m256i keep = _mm256_cmpeq_epi8(cur, join);
+		_mm256_storeu_si256((__m256i *)&dst[i], _mm256_blendv_epi8(fill, cur, keep));
+	}
+	if (i + 16 <= n) {
+		__m128i cur = _mm_loadu_si128((__m128i const *)&dst[i]);
+		__m128i keep = _mm_cmpeq_epi8(cur, _mm256_castsi256_si128(join));
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_blendv_epi8(_mm256_castsi256_si128(fill), cur, keep));
+		i += 16;
+	}
+	border_scalar(&dst[i], border, n - i);
+}
+
+__attribute__((target("avx2")))
+static void blit_avx2(char* dst, char const* src, size_t n) {
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i s = _mm256_loadu_si256((__m256i const *)&src[i]);
+		__m256i d = _mm256_loadu_si256((__m256i const *)&dst[i]);
+		__m256i empty = _mm256_cmpeq_epi8(s, zero);
+		_mm256_storeu_si256((__m256i *)&dst[i], _mm256_blendv_epi8(s, d, empty));
+	}
+	if (i + 16 <= n) {
+		__m128i s = _mm_loadu_si128((__m128i const *)&src[i]);
+		__m128i d = _mm_loadu_si128((__m128i const *)&dst[i]);
+		__m128i empty = _mm_cmpeq_epi8(s, _mm256_castsi256_si128(zero));
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_blendv_epi8(s, d, empty));
+		i += 16;
+	}
+	blit_scalar(&dst[i], &src[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_avx2(char const* cells, size_t n, char const* needle, size_t m) {
+	if (m == 0) { return 0; }
+	__m256i first = _mm256_set1_epi8(needle[0]);
+	__m256i last = _mm256_set1_epi8(needle[m - 1]);
+	size_t i = 0;
+	for (; i + m + 31 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256((__m256i const *)&cells[i]);
+		__m256i b = _mm256_loadu_si256((__m256i const *)&cells[i + m - 1]);
+		unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask != 0) {
+			unsigned bit = (unsigned)__builtin_ctz(mask);
+			if (memcmp(&cells[i + bit], needle, m) == 0) { return i + bit; }
+			mask &= mask - 1;
+		}
+	}
+	if (i + m + 15 <= n) {
+		__m128i a = _mm_loadu_si128((__m128i const *)&cells[i]);
+		__m128i b = _mm_loadu_si128((__m128i const *)&cells[i + m - 1]);
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(a, _mm256_castsi256_si128(first)), _mm_cmpeq_epi8(b, _mm256_castsi256_si128(last))));
+		while (mask != 0) {
+			unsigned bit = (unsigned)__builtin_ctz(mask);
+			if (memcmp(&cells[i + bit], needle, m) == 0) { return i + bit; }
+			mask &= mask - 1;
+		}
+		i += 16;
+	}
+	return i + find_scalar(&cells[i], n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static void range_avx2(float const* v, size_t n, float* lo, float* hi) {
+	size_t i = 0;
+	if (n >= 16) {
+		__m256 l0 = _mm256_set1_ps(*lo), l1 = l0;
+		__m256 h0 = _mm256_set1_ps(*hi), h1 = h0;
+		for (; i + 16 <= n; i += 16) {
+			__m256 a = _mm256_loadu_ps(&v[i]);
+			__m256 b = _mm256_loadu_ps(&v[i + 8]);
+			l0 = _mm256_min_ps(l0, a);
+			h0 = _mm256_max_ps(h0, a);
+			l1 = _mm256_min_ps(l1, b);
+			h1 = _mm256_max_ps(h1, b);
+		}
+		l0 = _mm256_min_ps(l0, l1);
+		h0 = _mm256_max_ps(h0, h1);
+		__m128 l = _mm_min_ps(_mm256_castps256_ps128(l0), _mm256_extractf128_ps(l0, 1));
+		__m128 h = _mm_max_ps(_mm256_castps256_ps128(h0), _mm256_extractf128_ps(h0, 1));
+		l = _mm_min_ps(l, _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 0, 3, 2)));
+		h = _mm_max_ps(h, _mm_shuffle_ps(h, h, _MM_SHUFFLE(1, 0, 3, 2)));
+		l = _mm_min_ps(l, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 3, 0, 1)));
+		h = _mm_max_ps(h, _mm_shuffle_ps(h, h, _MM_SHUFFLE(2, 3, 0, 1)));
+		*lo = _mm_cvtss_f32(l);
+		*hi = _mm_cvtss_f32(h);
+	}
+	range_scalar(&v[i], n - i, lo, hi);
+}
+
+static const CellKernels l_avx2 = { "avx2", fill_avx2, border_avx2, blit_avx2, find_avx2, range_avx2 };
+
+#endif // CELLS_X86
+
+static CellKernels const* l_active = &l_scalar;	///< Kernels in use
+
+/**
+ * Picks the widest kernels the CPU supports.
+ */
+void Cells_init(void) {
+#if CELLS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		l_active = &l_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		l_active = &l_sse2;
+	}
+#endif
+}
+
+/**
+ * Lists the kernel sets this CPU can run, scalar first.
+ *
+ * @param[in] i Variant index
+ *
+ * @returns Kernel set, or NULL past the last supported one
+ */
+CellKernels const* Cells_variant(int i) {
+	CellKernels const* variants[3] = { &l_scalar, NULL, NULL };
+	int count = 1;
+#if CELLS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) { variants[count++] = &l_sse2; }
+	if (__builtin_cpu_supports("avx2")) { variants[count++] = &l_avx2; }
+#endif
+	return (i >= 0 && i < count) ? variants[i] : NULL;
+}
+
+/**
+ * @returns Kernel set in use
+ */
+CellKernels const* Cells_active(void) {
+	return l_active;
+}
+
+/**
+ * Sets cells to one character.
+ *
+ * @param[out] dst First cell
+ * @param[in]  c   Character
+ * @param[in]  n   Number of cells
+ */
+void Cells_fill(char* dst, char c, size_t n) {
+	l_active->fill(dst, c, n);
+}
+
+/**
+ * Draws a border over cells, keeping existing '+' joins.
+ *
+ * @param[in,out] dst	 First cell
+ * @param[in]	  border Border character
+ * @param[in]	  n		 Number of cells
+ */
+void Cells_border(char* dst, char border, size_t n) {
+	l_active->border(dst, border, n);
+}
+
+/**
+ * Copies cells, leaving the destination where the source is empty.
+ *
+ * @param[in,out] dst First destination cell
+ * @param[in]	  src First source cell
+ * @param[in]	  n	  Number of cells
+ */
+void Cells_blit(char* dst, char const* src, size_t n) {
+	l_active->blit(dst, src, n);
+}
+
+/**
+ * Finds the first occurrence of a string of cells.
+ *
+ * @param[in] cells	 Cells to search
+ * @param[in] n		 Number of cells
+ * @param[in] needle Cells to find
+ * @param[in] m		 Length of @p needle
+ *
+ * @returns Offset of the first occurrence, or @p n if there is none
+ */
+size_t Cells_find(char const* cells, size_t n, char const* needle, size_t m) {
+	return l_active->find(cells, n, needle, m);
+}
+
+/**
+ * Folds samples into a running minimum and maximum.
+ *
+ * @param[in]	  v	 Samples, none of them NaN
+ * @param[in]	  n	 Number of samples
+ * @param[in,out] lo Minimum
+ * @param[in,out] hi Maximum
+ */
+void Cells_range(float const* v, size_t n, float* lo, float* hi) {
+	l_active->range(v, n, lo, hi);
+}
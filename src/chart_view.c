@@ -0,0 +1,282 @@
+/**
+ * @file chart_view.c
+ * Sparkline and bar chart widget.
+ *
+ * Samples go into a ring and, as they arrive, are folded into the
+ * minimum and maximum of the bucket they fall in, so drawing a frame
+ * never looks at raw samples: it maps one bucket per column to the
+ * rows it covers and hands on only the columns that changed. Raw
+ * samples are read again only when the width changes and every bucket
+ * is rebuilt. Folding uses the range kernel of the cell kernel set
+ * chosen by Cells_init(). Samples must not be NaN.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell_kernels.h"
+#include "chart_view.h"
+
+/**Column state of a column without samples.*/
+#define CHART_EMPTY 0xFFFF
+/**Column state that never matches, forcing a column to be drawn.*/
+#define CHART_UNDRAWN 0xFFFE
+
+/**Glyphs of a one-row sparkline, lowest first.*/
+static const char l_ramp[] = "_.-~'";
+
+/**
+ * Folds the samples between two positions, still in the ring, into a bucket.
+ */
+static void fold_ring(ChartView* me, uint64_t from, uint64_t to, int slot) {
+	while (from < to) {
+		uint32_t idx = (uint32_t)(from % me->capacity);
+		uint32_t n = me->capacity - idx;
+		if (n > to - from) {
+			n = (uint32_t)(to - from);
+		}
+		Cells_range(&me->samples[idx], n, &me->lo[slot], &me->hi[slot]);
+		from += n;
+	}
+}
+
+/**
+ * @returns First bucket whose samples are all still in the ring
+ */
+static uint64_t first_bucket(ChartView const* me) {
+	uint64_t oldest = (me->count > me->capacity) ? me->count - me->capacity : 0;
+	return (oldest + me->perColumn - 1) / me->perColumn;
+}
+
+/**
+ * Recomputes every visible bucket from the samples still in the ring.
+ */
+static void rebuild(ChartView* me) {
+	me->perColumn = (me->capacity + me->width - 1) / me->width;
+	me->firstBucket = first_bucket(me);
+	for (int x = 0; x < MAX_SCREEN_WIDTH; x++) {
+		me->drawn[x] = CHART_UNDRAWN;
+	}
+	if (me->count == 0) { return; }
+
+	uint64_t last = (me->count - 1) / me->perColumn;
+	uint64_t b = (last + 1 > me->width) ? last + 1 - me->width : 0;
+	if (b < me->firstBucket) {
+		b = me->firstBucket;
+	}
+	for (; b <= last; b++) {
+		int slot = (int)(b % me->width);
+		uint64_t from = b * me->perColumn;
+		uint64_t to = from + me->perColumn;
+		me->lo[slot] = INFINITY;
+		me->hi[slot] = -INFINITY;
+		fold_ring(me, from, (to < me->count) ? to : me->count, slot);
+	}
+}
+
+/**
+ * Maps a value to one of a number of levels of a scale.
+ */
+static int level_of(float v, float lo, float hi, int levels) {
+	int level = (int)((v - lo) / (hi - lo) * levels);
+	return (level < 0) ? 0 : (level >= levels) ? levels - 1 : level;
+}
+
+/**
+ * Finds what a column shows: the levels of its bucket's minimum and maximum.
+ *
+ * @returns Column state, @ref CHART_EMPTY for a column without samples
+ */
+static uint16_t column_state(ChartView const* me, int x, uint64_t last, float lo, float hi) {
+	uint64_t back = (uint64_t)(me->width - 1 - x);
+	if (me->count == 0 || back > last || last - back < me->firstBucket) {
+		return CHART_EMPTY;
+	}
+	int slot = (int)((last - back) % me->width);
+	int levels = (me->height == 1) ? (int)sizeof(l_ramp) - 1 : me->height;
+	return (uint16_t)(level_of(me->lo[slot], lo, hi, levels) << 8 | level_of(me->hi[slot], lo, hi, levels));
+}
+
+/**
+ * @returns Glyph of a column state in a row
+ */
+static char glyph_of(ChartView const* me, uint16_t state, int y) {
+	if (state == CHART_EMPTY) { return ' '; }
+	int bottom = state >> 8;
+	int top = state & 0xFF;
+	if (me->height == 1) { return l_ramp[top]; }
+
+	int level = me->height - 1 - y;
+	if (level < bottom || level > top) { return ' '; }
+	return (bottom == top) ? '-' : '|';
+}
+
+/**
+ * Initializes an empty chart.
+ *
+ * @param[out] me		Chart
+ * @param[in]  capacity	Samples kept, at least 1
+ * @param[in]  width	Chart width, clamped to the screen
+ * @param[in]  height	Chart height, clamped to the screen; 1 for a sparkline
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+int ChartView_init(ChartView* me, uint32_t capacity, uint16_t width, uint16_t height) {
+	memset(me, 0, sizeof(ChartView));
+	me->capacity = (capacity < 1) ? 1 : capacity;
+	me->samples = malloc((size_t)me->capacity * sizeof(float));
+	if (me->samples == NULL) {
+		return -1;
+	}
+	me->width = (width < 1) ? 1 : (width > MAX_SCREEN_WIDTH) ? MAX_SCREEN_WIDTH : width;
+	me->height = (height < 1) ? 1 : (height > MAX_SCREEN_HEIGHT) ? MAX_SCREEN_HEIGHT : height;
+	rebuild(me);
+	return 0;
+}
+
+/**
+ * Frees the samples of a chart.
+ *
+ * @param[in,out] me Chart
+ */
+void ChartView_free(ChartView* me) {
+	free(me->samples);
+	me->samples = NULL;
+}
+
+/**
+ * Adds samples to the series. Each sample is copied once and folded
+ * into its bucket; a batch is folded a bucket at a time. Once the ring
+ * wraps, a bucket is dropped as soon as one of its samples is overwritten.
+ *
+ * @param[in,out] me	  Chart
+ * @param[in]	  samples Samples, oldest first
+ * @param[in]	  n		  Number of samples
+ */
+void ChartView_push(ChartView* me, float const* samples, uint32_t n) {
+	while (n > 0) {
+		uint64_t bucket = me->count / me->perColumn;
+		uint32_t offset = (uint32_t)(me->count % me->perColumn);
+		uint32_t take = me->perColumn - offset;
+		if (take > n) {
+			take = n;
+		}
+
+		int slot = (int)(bucket % me->width);
+		if (offset == 0) {
+			me->lo[slot] = INFINITY;
+			me->hi[slot] = -INFINITY;
+		}
+		Cells_range(samples, take, &me->lo[slot], &me->hi[slot]);
+
+		uint32_t idx = (uint32_t)(me->count % me->capacity);
+		uint32_t first = me->capacity - idx;
+		if (first > take) {
+			first = take;
+		}
+		memcpy(&me->samples[idx], samples, first * sizeof(float));
+		memcpy(me->samples, &samples[first], (take - first) * sizeof(float));
+
+		me->count += take;
+		samples += take;
+		n -= take;
+	}
+	me->firstBucket = first_bucket(me);
+}
+
+/**
+ * Changes the size of a chart; the whole chart is drawn again. A new
+ * width changes the samples in each bucket, so every bucket is rebuilt
+ * from the ring.
+ *
+ * @param[in,out] me	 Chart
+ * @param[in]	  width	 Chart width, clamped to the screen
+ * @param[in]	  height Chart height, clamped to the screen
+ */
+void ChartView_resize(ChartView* me, uint16_t width, uint16_t height) {
+	width = (width < 1) ? 1 : (width > MAX_SCREEN_WIDTH) ? MAX_SCREEN_WIDTH : width;
+	height = (height < 1) ? 1 : (height > MAX_SCREEN_HEIGHT) ? MAX_SCREEN_HEIGHT : height;
+	if (width != me->width) {
+		me->width = width;
+		me->height = height;
+		rebuild(me);
+	} else {
+		me->height = height;
+		for (int x = 0; x < MAX_SCREEN_WIDTH; x++) {
+			me->drawn[x] = CHART_UNDRAWN;
+		}
+	}
+}
+
+/**
+ * Fixes the scale of a chart, or makes it fit the visible samples.
+ *
+ * @param[in,out] me Chart
+ * @param[in]	  lo Value at the bottom
+ * @param[in]	  hi Value at the top; at or below @p lo to fit the visible samples
+ */
+void ChartView_setRange(ChartView* me, float lo, float hi) {
+	me->scaleLo = lo;
+	me->scaleHi = hi;
+}
+
+/**
+ * Hands on the columns that changed since the last render, as runs of
+ * cells per row. Costs a pass over the columns, however many samples
+ * the chart holds.
+ *
+ * @param[in,out] me   Chart
+ * @param[in]	  span Called for every run of changed cells
+ * @param[in]	  arg  Passed to @p span
+ *
+ * @returns Number of columns redrawn
+ */
+int ChartView_render(ChartView* me, ChartSpanCb span, void* arg) {
+	uint16_t state[MAX_SCREEN_WIDTH];
+	char line[MAX_SCREEN_WIDTH];
+	uint64_t last = (me->count > 0) ? (me->count - 1) / me->perColumn : 0;
+	float lo = me->scaleLo;
+	float hi = me->scaleHi;
+
+	if (hi <= lo && me->count > 0) {
+		lo = INFINITY;
+		hi = -INFINITY;
+		uint64_t b = (last + 1 > me->width) ? last + 1 - me->width : 0;
+		for (b = (b < me->firstBucket) ? me->firstBucket : b; b <= last; b++) {
+			int slot = (int)(b % me->width);
+			if (me->lo[slot] < lo) { lo = me->lo[slot]; }
+			if (me->hi[slot] > hi) { hi = me->hi[slot]; }
+		}
+	}
+	if (!(hi > lo)) {
+		lo -= 0.5f;
+		hi = lo + 1.0f;
+	}
+
+	int changed = 0;
+	for (int x = 0; x < me->width; x++) {
+		state[x] = column_state(me, x, last, lo, hi);
+		changed += (state[x] != me->drawn[x]);
+	}
+	if (changed == 0) {
+		return 0;
+	}
+
+	for (int y = 0; y < me->height; y++) {
+		int x = 0;
+		while (x < me->width) {
+			if (state[x] == me->drawn[x]) {
+				x++;
+				continue;
+			}
+			int start = x;
+			for (; x < me->width && state[x] != me->drawn[x]; x++) {
+				line[x] = glyph_of(me, state[x], y);
+			}
+			span(y, start, &line[start], x - start, arg);
+		}
+	}
+	memcpy(me->drawn, state, me->width * sizeof(state[0]));
+	return changed;
+}
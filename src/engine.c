@@ -3,13 +3,146 @@
  * Engine, toot toot.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <string.h>
 
 #include "main.h"
+#include "layouts.h"
 
 static QState Engine_initial(Engine * const me, QEvt const * const e);
 static QState Idle(Engine * const me, QEvt const * const e);
 
+/**Key that opens and closes the help popup.*/
+#define HELP_KEY '?'
+/**Key that saves the screen to a file.*/
+#define SAVE_KEY 's'
+/**Key that reads the saved screen back into the log.*/
+#define LOAD_KEY 'l'
+/**Set in a file request's tag when it loads a screen rather than saves one.*/
+#define LOAD_TAG 0x8000U
+/**Key that adds a snapshot of the screen to the history.*/
+#define CHECKPOINT_KEY 'c'
+/**Key that goes back to the latest snapshot.*/
+#define UNDO_KEY 'u'
+/**Key that starts typing a search query.*/
+#define SEARCH_KEY '/'
+/**Key that ends a search and clears its highlight.*/
+#define ESCAPE_KEY 27
+/**Keys that move the job table's cursor down and up.*/
+#define JOB_DOWN_KEY 'j'
+#define JOB_UP_KEY 'k'
+/**Key that sorts the job table by its next column.*/
+#define JOB_SORT_KEY 'o'
+/**Key that appends a job to the job table.*/
+#define JOB_ADD_KEY 'a'
+/**Key that shows only the jobs of the next state, then all of them again.*/
+#define JOB_FILTER_KEY 'f'
+/**Keys that narrow and widen the job table's sort column.*/
+#define JOB_NARROW_KEY '<'
+#define JOB_WIDEN_KEY '>'
+
+/**Section drawn by the job table.*/
+#define JOBS_KEY "jobs"
+/**Section showing a session's word-wrapped log.*/
+#define LOG_KEY "log"
+/**Section charting the time between a session's typed keys.*/
+#define CHART_KEY "chart"
+/**Jobs in a session's table when it starts.*/
+#define JOBS_INITIAL 1000000
+
+/**
+ * Help popup, drawn over the middle of the test layout.
+ */
+static const RenderSection l_helpPopup = { "help", 20, 8, 40, 6 };
+
+/**
+ * Frees a render request that is never posted.
+ *
+ * @param[in] e Request
+ */
+static void discard_render(QEvt const* e) {
+	if (e->sig == PAINT_LINE_SIG) {
+		PaintArena_release(((PaintEvt const *)e)->canvas);
+	}
+	QF_gc(e);
+}
+
+/**
+ * Holds back a render request until RenderArtist returns credits.
+ * Paints in the backlog that the request overwrites are dropped, since
+ * only the last one would be visible. When the backlog is full, its
+ * oldest paint makes room; section changes are only dropped if there is
+ * no paint left to give way.
+ *
+ * @param[in,out] me Engine
+ * @param[in]	  e	 Request
+ */
+static void defer_render(Engine* me, QEvt const* e) {
+	int kept = 0;
+	for (int i = 0; i < me->numBacklog; i++) {
+		QEvt const* held = me->backlog[i];
+		if (held->sig == PAINT_LINE_SIG && RenderArtist_covers(e, (PaintEvt const *)held)) {
+			discard_render(held);
+			Metrics_count(METRIC_PAINTS_MERGED, 1);
+		} else {
+			me->backlog[kept++] = held;
+		}
+	}
+	me->numBacklog = kept;
+
+	if (me->numBacklog == ENGINE_BACKLOG_LEN) {
+		int victim = 0;
+		while (victim < me->numBacklog && me->backlog[victim]->sig != PAINT_LINE_SIG) {
+			victim++;
+		}
+		if (victim == me->numBacklog) {
+			Metrics_count((e->sig == PAINT_LINE_SIG) ? METRIC_PAINTS_DROPPED : METRIC_RENDER_DROPPED, 1);
+			discard_render(e);
+			return;
+		}
+		discard_render(me->backlog[victim]);
+		Metrics_count(METRIC_PAINTS_DROPPED, 1);
+		memmove(&me->backlog[victim], &me->backlog[victim + 1],
+				(me->numBacklog - victim - 1) * sizeof(me->backlog[0]));
+		me->numBacklog--;
+	}
+	me->backlog[me->numBacklog++] = e;
+	Metrics_count(METRIC_RENDER_DEFERRED, 1);
+}
+
+/**
+ * Posts held-back requests, oldest first, while credits last.
+ *
+ * @param[in,out] me Engine
+ */
+static void flush_backlog(Engine* me) {
+	int sent = 0;
+	while (sent < me->numBacklog && me->credits > 0) {
+		me->credits--;
+		QACTIVE_POST(AO_RenderArtist, (QEvt *)me->backlog[sent++], AO_Engine);
+	}
+	memmove(me->backlog, &me->backlog[sent], (me->numBacklog - sent) * sizeof(me->backlog[0]));
+	me->numBacklog -= sent;
+}
+
+/**
+ * Posts a request to RenderArtist if a credit is left, or holds it back.
+ * Requests are never posted ahead of held-back ones, so RenderArtist
+ * sees them in the order they were made.
+ *
+ * @param[in] e Request
+ */
+static void post_render(QEvt* e) {
+	Engine* me = (Engine *)AO_Engine;
+	if (me->numBacklog == 0 && me->credits > 0) {
+		me->credits--;
+		QACTIVE_POST(AO_RenderArtist, e, AO_Engine);
+	} else {
+		defer_render(me, e);
+	}
+}
+
 //////////////////////////////////////////
 /// @ingroup Fwk
 /// @defgroup AOEngine Active Object - Engine
@@ -18,25 +151,149 @@ static QState Idle(Engine * const me, QEvt const * const e);
 /////////////////////////////////////////
 
 /**
- * Creates a new section in a layer.
+ * Installs a compiled layout in a session's base layer.
  *
- * @ref CREATE_SECTION_SIG, @ref AO_RenderArtist
+ * @ref INSTALL_LAYOUT_SIG, @ref AO_RenderArtist
  *
- * @param[in] key	  Section key
- * @param[in] yAnchor Vertical anchor (from top)
- * @param[in] xAnchor Horizontal anchor (from left)
- * @param[in] yDim	  Vertical size
- * @param[in] xDim	  Horizontal size
+ * @param[in] session Session ID
+ * @param[in] layout  Compiled layout
+ */
+static void post_INSTALL_LAYOUT(uint16_t session, RenderLayout const* layout) {
+	LayoutEvt* e = Q_NEW(LayoutEvt, INSTALL_LAYOUT_SIG);
+	if (e) {
+		e->session = session;
+		e->layout = layout;
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Moves or resizes a section.
+ *
+ * @ref CONFIG_SECTION_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] section New section configuration
+ */
+static void post_CONFIG_SECTION(uint16_t session, RenderSection const* section) {
+	SectionCfgEvt* e = Q_NEW(SectionCfgEvt, CONFIG_SECTION_SIG);
+	if (e) {
+		e->session = session;
+		memcpy(&e->section, section, sizeof(RenderSection));
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Opens a popup above a session's sections.
+ *
+ * @ref OPEN_POPUP_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] section Popup section
+ */
+static void post_OPEN_POPUP(uint16_t session, RenderSection const* section) {
+	SectionCfgEvt* e = Q_NEW(SectionCfgEvt, OPEN_POPUP_SIG);
+	if (e) {
+		e->session = session;
+		memcpy(&e->section, section, sizeof(RenderSection));
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Closes a popup, restoring what it covered.
+ *
+ * @ref CLOSE_POPUP_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] key	  Popup section key
  */
-static void post_CREATE_SECTION(char* key, int yAnchor, int xAnchor, int yDim, int xDim) {
-	SectionCfgEvt* e = Q_NEW(SectionCfgEvt, CREATE_SECTION_SIG);
+static void post_CLOSE_POPUP(uint16_t session, char const* key) {
+	SectionCfgEvt* e = Q_NEW(SectionCfgEvt, CLOSE_POPUP_SIG);
 	if (e) {
+		e->session = session;
 		strncpy(e->section.key, key, PAINTER_KEY_LEN);
-		e->section.yAnchor = yAnchor;
-		e->section.xAnchor = xAnchor;
-		e->section.yDim = yDim;
-		e->section.xDim = xDim;
-		QACTIVE_POST(AO_RenderArtist, (QEvt*) e, AO_Engine);
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Snapshots or restores a session's base layer.
+ *
+ * @ref CHECKPOINT_LAYER_SIG, @ref UNDO_LAYER_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] sig	  @ref CHECKPOINT_LAYER_SIG or @ref UNDO_LAYER_SIG
+ */
+static void post_LAYER_HISTORY(uint16_t session, QSignal sig) {
+	SessionEvt* e = Q_NEW(SessionEvt, sig);
+	if (e) {
+		e->session = session;
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Highlights the matches of a search query in a session's base layer.
+ *
+ * @ref SEARCH_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] query	  Query, need not be NUL-terminated
+ * @param[in] len	  Length of @p query, 0 to clear the highlight
+ */
+static void post_SEARCH(uint16_t session, char const* query, uint8_t len) {
+	SearchEvt* e = Q_NEW(SearchEvt, SEARCH_SIG);
+	if (e) {
+		e->session = session;
+		e->length = len;
+		memcpy(e->query, query, len);
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Binds a widget to a section of a session's base layer.
+ *
+ * @ref ATTACH_VIEW_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] section Section key
+ * @param[in] kind	  Widget kind, see @ref ViewKind
+ * @param[in] spec	  Widget setup
+ * @param[in] ctx	  Context passed to the widget's source
+ */
+static void post_ATTACH_VIEW(uint16_t session, char const* section, uint8_t kind, void const* spec, void* ctx) {
+	ViewEvt* e = Q_NEW(ViewEvt, ATTACH_VIEW_SIG);
+	if (e) {
+		e->session = session;
+		snprintf(e->sectionKey, sizeof(e->sectionKey), "%s", section);
+		e->op = kind;
+		e->spec = spec;
+		e->ctx = ctx;
+		post_render((QEvt *)e);
+	}
+}
+
+/**
+ * Passes an input to the widget of a section.
+ *
+ * @ref VIEW_INPUT_SIG, @ref AO_RenderArtist
+ *
+ * @param[in] session Session ID
+ * @param[in] section Section key
+ * @param[in] op	  Input, see @ref ViewOp
+ * @param[in] arg	  Argument of @p op
+ */
+static void post_VIEW_INPUT(uint16_t session, char const* section, uint8_t op, int32_t arg) {
+	ViewEvt* e = Q_NEW(ViewEvt, VIEW_INPUT_SIG);
+	if (e) {
+		e->session = session;
+		snprintf(e->sectionKey, sizeof(e->sectionKey), "%s", section);
+		e->op = op;
+		e->arg = arg;
+		post_render((QEvt *)e);
 	}
 }
 
@@ -45,19 +302,66 @@ static void post_CREATE_SECTION(char* key, int yAnchor, int xAnchor, int yDim, i
  *
  * @ref PAINT_LINE_SIG, @ref AORenderArtist
  *
+ * @param[in] session Session ID
  * @param[in] section Section key
  * @param[in] yAnchor Vertical anchor (from top)
  * @param[in] xAnchor Horizontal anchor (from left)
  * @param[in] artwork String to draw
  */
-static void post_PAINT_LINE(char* section, uint16_t yAnchor, uint16_t xAnchor, char* artwork) {
+static void post_PAINT_LINE(uint16_t session, char const* section, uint16_t yAnchor, uint16_t xAnchor, char const* artwork) {
+	uint16_t length = strnlen(artwork, PAINT_ARENA_MAX_LEN);
+	PaintRef canvas = PaintArena_copy(artwork, length);
+	if (canvas == PAINT_REF_NONE) {
+		Metrics_count(METRIC_PAINTS_DROPPED, 1);
+		return;
+	}
+
 	PaintEvt* e = Q_NEW(PaintEvt, PAINT_LINE_SIG);
 	if (e) {
+		e->session = session;
 		strncpy(e->sectionKey, section, PAINTER_KEY_LEN);
 		e->yAnchor = yAnchor;
 		e->xAnchor = xAnchor;
-		strncpy(e->canvas, artwork, MAX_SCREEN_WIDTH);
-		QACTIVE_POST(AO_RenderArtist, (QEvt *)e, AO_Engine);
+		e->canvas = canvas;
+		e->length = length;
+		e->columns = Glyph_columns(artwork, length);
+		post_render((QEvt *)e);
+	} else {
+		PaintArena_release(canvas);
+	}
+}
+
+/**
+ * Lays out a session, then moves on to the next one.
+ * Sessions are set up one per step so the render queues never hold more
+ * than one session's layout.
+ *
+ * @ref SESSION_START_SIG, @ref AOEngine
+ *
+ * @param[in] session Session ID
+ */
+static void post_SESSION_START(uint16_t session) {
+	SessionEvt* e = Q_NEW(SessionEvt, SESSION_START_SIG);
+	if (e) {
+		e->session = session;
+		QACTIVE_POST(AO_Engine, (QEvt *)e, AO_Engine);
+	}
+}
+
+/**
+ * Registers the engine for a session's keys; it owns no section of its own.
+ *
+ * @ref REGISTER_INPUT_SIG, @ref AOBindingHandler
+ *
+ * @param[in] session Session ID
+ */
+static void post_REGISTER_INPUT(uint16_t session) {
+	ConsumerEvt* e = Q_NEW(ConsumerEvt, REGISTER_INPUT_SIG);
+	if (e) {
+		e->session = session;
+		e->consumer = AO_Engine;
+		e->sectionKey[0] = '\0';
+		QACTIVE_POST(AO_BindingHandler, (QEvt *)e, AO_Engine);
 	}
 }
 
@@ -89,67 +393,395 @@ static void publish_ENGINE_END() {
 /////////////////////////////////////////
 
 /**
- * Initializes global curses settings.
+ * Opens every session's terminal and applies global curses settings.
  */
 static void configure_screen() {
-	initscr();
-	cbreak();
-	noecho();
-	set_escdelay(0); // don't pause on ESC
-	curs_set(0); // hide cursor
+	for (int i = 0; i < Session_count(); i++) {
+		if (Session_open(i) != 0) { continue; }
+		cbreak();
+		noecho();
+		set_escdelay(0); // don't pause on ESC
+		curs_set(0); // hide cursor
+	}
 }
 
 /**
  * Cleans up curses on exit.
  */
 static void teardown_screen() {
-	endwin();
+	Session_report();
+	Session_closeAll();
 }
 
 /**
- * Make some test sections.
+ * Resizable version of the test layout, taking over once the terminal is
+ * resized. Nodes are numbered in table order after the root row (0).
  */
-static void test_sections() {
-	post_CREATE_SECTION("tallMid", 1, 11, 7, 6);
-	post_CREATE_SECTION("topLeft", 1, 1, 4, 9);
-	post_CREATE_SECTION("left2x2", 6, 1, 2, 4);
-	post_CREATE_SECTION("top3x3", 1, 18, 3, 6);
-	post_CREATE_SECTION("topRight", 1, 25, 3, 4);
-	post_CREATE_SECTION("bot", 9, 1, 1, 23);
-	post_CREATE_SECTION("right2x2", 6, 6, 2, 4);
-	post_CREATE_SECTION("bot3x3", 5, 18, 3, 6);
-	post_CREATE_SECTION("botRight", 5, 25, 10, 6);
+static const struct {
+	int8_t		parent;		///< Parent node
+	LayoutKind	kind;		///< Node kind
+	char const*	key;		///< Section key, for leaves
+	uint16_t	weight;		///< Share of free space
+	uint16_t	minSize;	///< Minimum inner size
+	uint16_t	maxSize;	///< Maximum inner size
+} l_testTree[] = {
+	{ 0, LAYOUT_COLUMN, NULL,       4, 20, LAYOUT_UNBOUNDED },	// 1
+	{ 0, LAYOUT_COLUMN, NULL,       1, 4,  8 },					// 2
+	{ 1, LAYOUT_ROW,    NULL,       1, 6,  LAYOUT_UNBOUNDED },	// 3
+	{ 1, LAYOUT_LEAF,   "bot",      0, 1,  1 },					// 4
+	{ 3, LAYOUT_COLUMN, NULL,       2, 9,  LAYOUT_UNBOUNDED },	// 5
+	{ 3, LAYOUT_LEAF,   "tallMid",  1, 6,  LAYOUT_UNBOUNDED },	// 6
+	{ 3, LAYOUT_COLUMN, NULL,       1, 6,  LAYOUT_UNBOUNDED },	// 7
+	{ 5, LAYOUT_LEAF,   "topLeft",  2, 2,  LAYOUT_UNBOUNDED },	// 8
+	{ 5, LAYOUT_ROW,    NULL,       1, 2,  LAYOUT_UNBOUNDED },	// 9
+	{ 9, LAYOUT_LEAF,   "left2x2",  1, 4,  LAYOUT_UNBOUNDED },	// 10
+	{ 9, LAYOUT_LEAF,   "right2x2", 1, 4,  LAYOUT_UNBOUNDED },	// 11
+	{ 7, LAYOUT_LEAF,   "top3x3",   1, 3,  LAYOUT_UNBOUNDED },	// 12
+	{ 7, LAYOUT_LEAF,   "bot3x3",   1, 3,  LAYOUT_UNBOUNDED },	// 13
+	{ 2, LAYOUT_LEAF,   "topRight", 1, 3,  LAYOUT_UNBOUNDED },	// 14
+	{ 2, LAYOUT_LEAF,   "botRight", 3, 3,  LAYOUT_UNBOUNDED },	// 15
+	{ 0, LAYOUT_COLUMN, NULL,       4, 20, LAYOUT_UNBOUNDED },	// 16
+	{ 16, LAYOUT_LEAF,  JOBS_KEY,   1, 4,  LAYOUT_UNBOUNDED },	// 17
+	{ 16, LAYOUT_LEAF,  LOG_KEY,    1, 2,  LAYOUT_UNBOUNDED },	// 18
+	{ 1, LAYOUT_LEAF,   CHART_KEY,  1, 3,  LAYOUT_UNBOUNDED },	// 19
+};
+
+/**
+ * Made-up job attributes, derived from the job number so that any number
+ * of jobs can be listed without storing them.
+ */
+static uint32_t job_hash(uint32_t row) {
+	row ^= row >> 16;
+	row *= 0x7FEB352DU;
+	row ^= row >> 15;
+	row *= 0x846CA68BU;
+	return row ^ (row >> 16);
+}
+
+/**Number of job states, see @ref job_format.*/
+#define JOB_STATES 4
+
+/**
+ * Value of a job table cell; jobs are listed by number, state and runtime.
+ */
+static uint32_t job_value(uint32_t row, int column) {
+	switch (column) {
+	case 0: return row;
+	case 1: return job_hash(row) % JOB_STATES;
+	default: return job_hash(row) % 100000;
+	}
+}
+
+/**
+ * @returns Number of jobs in a session's table
+ */
+static uint32_t job_rows(void* ctx) {
+	return ((Session *)ctx)->jobs;
+}
+
+/**
+ * Formats a cell of a session's job table.
+ */
+static int job_format(void* ctx, uint32_t row, int column, char* buf, int width) {
+	static char const* const states[] = { "queued", "running", "done", "failed" };
+	char cell[16];
+	int len;
+	(void)ctx;
+	if (column == 1) {
+		len = snprintf(cell, sizeof(cell), "%s", states[job_value(row, column)]);
+	} else {
+		len = snprintf(cell, sizeof(cell), "%u", (unsigned)job_value(row, column));
+	}
+	if (len > width) { len = width; }
+	memcpy(buf, cell, len);
+	return len;
+}
+
+/**
+ * Orders two jobs by a column.
+ */
+static int job_compare(void* ctx, int column, uint32_t a, uint32_t b) {
+	uint32_t va = job_value(a, column), vb = job_value(b, column);
+	(void)ctx;
+	return (va > vb) - (va < vb);
+}
+
+/**
+ * Keeps the jobs of one state.
+ *
+ * @param[in] ctx Session
+ * @param[in] row Job
+ * @param[in] arg State kept
+ *
+ * @returns Non-zero if the job is in the state
+ */
+static int job_filter(void* ctx, uint32_t row, void* arg) {
+	(void)ctx;
+	return job_value(row, 1) == (uint32_t)(intptr_t)arg;
+}
+
+/**
+ * Job table drawn in the jobs section, over the session's job count.
+ */
+static const TableSpec l_jobSpec = {
+	{ &job_rows, &job_format, &job_compare, NULL },
+	{ { "job", 8 }, { "state", 8 }, { "ms", 6 } },
+	3, &job_filter
+};
+
+/**
+ * Time between typed keys, in milliseconds, fitted to the keys in view.
+ */
+static const ChartSpec l_keyChartSpec = { 1024, 0.0f, 0.0f };
+
+/**
+ * Builds a session's resizable layout. It is not solved until the first resize,
+ * so the compiled layout stays in place until then.
+ *
+ * @param[out] tree Layout tree
+ */
+static void build_layout(LayoutTree* tree) {
+	LayoutTree_init(tree, LAYOUT_ROW);
+	for (unsigned i = 0; i < Q_DIM(l_testTree); i++) {
+		LayoutTree_add(tree, l_testTree[i].parent, l_testTree[i].kind, l_testTree[i].key,
+				l_testTree[i].weight, l_testTree[i].minSize, l_testTree[i].maxSize);
+	}
+}
+
+/**
+ * Sends the new configuration of a section moved by the layout solver.
+ */
+static void section_moved(LayoutNode const* node, void* arg) {
+	RenderSection section;
+	LayoutNode_toSection(node, &section);
+	post_CONFIG_SECTION(((Session *)arg)->id, &section);
+}
+
+/**
+ * Re-solves a session's layout against its terminal size.
+ * Only sections whose rectangle changed are reconfigured.
+ *
+ * @param[in,out] s Session
+ */
+static void relayout(Session* s) {
+	int rows, cols;
+	Session_select(s);
+	getmaxyx(stdscr, rows, cols);
+	if (rows > MAX_SCREEN_HEIGHT) { rows = MAX_SCREEN_HEIGHT; }
+	if (cols > MAX_SCREEN_WIDTH) { cols = MAX_SCREEN_WIDTH; }
+
+	LayoutTree_resize(&s->layout, cols, rows);
+	LayoutTree_solve(&s->layout, &section_moved, s);
+}
+
+/**
+ * Goes back to a session's latest screen snapshot. The snapshot holds
+ * the sections as they were laid out then, so the solved layout is sent
+ * again afterwards; sections it leaves where they are keep what the
+ * snapshot restored.
+ *
+ * @param[in,out] s Session
+ */
+static void undo_screen(Session* s) {
+	post_LAYER_HISTORY(s->id, UNDO_LAYER_SIG);
+	LayoutTree_report(&s->layout, &section_moved, s);
+}
+
+/**
+ * Opens or closes a session's help popup.
+ * Opening an open popup and closing a closed one change nothing, so if
+ * the RenderArtist could not open it, the next key press catches up
+ * instead of stacking a second popup.
+ *
+ * @param[in,out] s Session
+ */
+static void toggle_help(Session* s) {
+	if (s->helpOpen) {
+		post_CLOSE_POPUP(s->id, l_helpPopup.key);
+	} else {
+		post_OPEN_POPUP(s->id, &l_helpPopup);
+		post_PAINT_LINE(s->id, l_helpPopup.key, 0, 1, "s/l  save/load screen");
+		post_PAINT_LINE(s->id, l_helpPopup.key, 1, 1, "c/u  checkpoint/undo screen");
+		post_PAINT_LINE(s->id, l_helpPopup.key, 2, 1, "/    search, Enter/Esc to end");
+		post_PAINT_LINE(s->id, l_helpPopup.key, 3, 1, "j/k o a f  jobs: move sort add filter");
+		post_PAINT_LINE(s->id, l_helpPopup.key, 4, 1, "?    close this help");
+	}
+	s->helpOpen = !s->helpOpen;
+}
+
+/**
+ * Edits a session's search query with a typed key. Every edit is sent on
+ * at once, so matches are highlighted as the query is typed. Enter ends
+ * the search and keeps the highlight; Escape also clears it.
+ *
+ * @param[in,out] s	  Session
+ * @param[in]	  key Key typed
+ */
+static void search_key(Session* s, int key) {
+	if (key == '\n' || key == '\r' || key == KEY_ENTER) {
+		s->searching = 0;
+		return;
+	}
+	if (key == ESCAPE_KEY) {
+		s->searching = 0;
+		s->queryLen = 0;
+	} else if (key == KEY_BACKSPACE || key == 127 || key == '\b') {
+		if (s->queryLen == 0) { return; }
+		s->queryLen--;
+	} else if (key >= ' ' && key <= '~' && s->queryLen < SEARCH_MAX_QUERY - 1) {
+		s->query[s->queryLen++] = (char)key;
+	} else {
+		return;
+	}
+	post_SEARCH(s->id, s->query, s->queryLen);
+}
+
+/**
+ * Saves a session's base layer as UTF-8 text, one line per row.
+ * The file is written by the FileSystem, which reports back with
+ * @ref FILE_RESULT_SIG tagged with the session ID.
+ *
+ * @param[in] me Engine
+ * @param[in] s	 Session
+ */
+static void save_screen(Engine* me, Session* s) {
+	char path[FILE_PATH_LEN];
+	char* text = malloc(MAX_SCREEN_HEIGHT * (MAX_SCREEN_WIDTH * GLYPH_MAX_BYTES + 1));
+	uint32_t len = 0;
+	if (text == NULL) { return; }
+
+	for (int y = 0; y < MAX_SCREEN_HEIGHT; y++) {
+		uint32_t end = len;
+		for (int x = 0; x < MAX_SCREEN_WIDTH; x++) {
+			char c = Layer_cell(&s->layers[0], x, y);
+			int bytesLen;
+			int width;
+			char const* bytes = Glyph_bytes(&s->glyphs, c, &bytesLen, &width);
+			if (bytes != NULL) {
+				memcpy(&text[len], bytes, bytesLen);
+				len += bytesLen;
+			} else if (c != (char)GLYPH_TAIL) {
+				text[len++] = c ? c : ' ';
+			}
+			if (c && c != ' ') { end = len; }
+		}
+		len = end;
+		text[len++] = '\n';
+	}
+
+	snprintf(path, sizeof(path), "session-%u.txt", s->id);
+	if (FileSystem_save(&me->super, s->id, path, text, len) != 0) {
+		free(text);
+	}
+}
+
+/**
+ * Reads the screen a session saved last. The FileSystem reports back with
+ * @ref FILE_RESULT_SIG tagged with the session ID and @ref LOAD_TAG.
+ *
+ * @param[in] me Engine
+ * @param[in] s	 Session
+ */
+static void load_screen(Engine* me, Session* s) {
+	char path[FILE_PATH_LEN];
+	snprintf(path, sizeof(path), "session-%u.txt", s->id);
+	FileSystem_read(&me->super, s->id | LOAD_TAG, path);
 }
 
 /**
  * Rotates through test sections.
+ *
+ * @param[in,out] s Session
+ *
  * @returns next section key
  */
-static const char* next_sec() {
-	static int sec = 0;
-	switch (sec++) {
-	case 0:
-		return "tallMid";
-	case 1:
-		return "topLeft";
-	case 2:
-		return "left2x2";
-	case 3:
-		return "top3x3";
-	case 4:
-		return "topRight";
-	case 5:
-		return "bot";
-	case 6:
-		return "right2x2";
-	case 7:
-		return "bot3x3";
-	case 8:
-		return "botRight";
+static const char* next_sec(Session* s) {
+	char const* key;
+	do {
+		if (s->nextSec >= LAYOUT_test.numSections) {
+			s->nextSec = 0;
+		}
+		key = LAYOUT_test.layer.sections[s->nextSec++].key;
+	} while (!strcmp(key, JOBS_KEY) || !strcmp(key, LOG_KEY) || !strcmp(key, CHART_KEY));
+	return key;
+}
+
+/**
+ * Adds a paragraph to a session's log. It is word-wrapped to the log
+ * section, and the last paragraph is overwritten once the log is full.
+ *
+ * @param[in,out] s	   Session
+ * @param[in]	  text Text to log
+ */
+static void log_line(Session* s, char const* text) {
+	post_PAINT_LINE(s->id, LOG_KEY, s->logLines, 0, text);
+	if (s->logLines < UINT16_MAX) {
+		s->logLines++;
+	}
+}
+
+/**
+ * Adds each line of a loaded screen to a session's log.
+ *
+ * @param[in,out] s		 Session
+ * @param[in,out] text	 Screen, NUL-terminated; its newlines are overwritten
+ * @param[in]	  length Bytes in @p text
+ */
+static void log_screen(Session* s, char* text, uint32_t length) {
+	char* line = text;
+	for (uint32_t i = 0; i <= length; i++) {
+		if (text[i] == '\n' || (text[i] == '\0' && &text[i] > line)) {
+			text[i] = '\0';
+			log_line(s, line);
+			line = &text[i + 1];
+		}
+	}
+}
+
+/**
+ * Adds the time since a session's last typed key to its key chart.
+ *
+ * @param[in,out] s	  Session
+ * @param[in]	  now Session_clock() when the key arrived
+ */
+static void chart_key(Session* s, uint64_t now) {
+	if (s->lastKeyAt != 0) {
+		uint64_t ms = (now - s->lastKeyAt) / 1000000U;
+		post_VIEW_INPUT(s->id, CHART_KEY, VIEW_SAMPLE, (ms > INT32_MAX) ? INT32_MAX : (int32_t)ms);
+	}
+	s->lastKeyAt = now;
+}
+
+/**
+ * Passes a typed key to a session's job table.
+ *
+ * @param[in,out] s	  Session
+ * @param[in]	  key Key typed
+ *
+ * @returns Non-zero if the key was for the job table
+ */
+static int job_key(Session* s, int key) {
+	switch (key) {
+	case JOB_DOWN_KEY: post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_MOVE, 1); break;
+	case JOB_UP_KEY: post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_MOVE, -1); break;
+	case JOB_NARROW_KEY: post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_WIDEN, -1); break;
+	case JOB_WIDEN_KEY: post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_WIDEN, 1); break;
+	case JOB_SORT_KEY:
+		s->jobSort = (s->jobSort + 2) % (l_jobSpec.numColumns + 1) - 1;
+		post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_SORT, s->jobSort);
+		break;
+	case JOB_FILTER_KEY:
+		s->jobFilter = (s->jobFilter + 2) % (JOB_STATES + 1) - 1;
+		post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_FILTER, s->jobFilter);
+		break;
+	case JOB_ADD_KEY:
+		s->jobs++;
+		post_VIEW_INPUT(s->id, JOBS_KEY, VIEW_DATA, 0);
+		break;
 	default:
-		sec = 0;
-		return "tallMid";
+		return 0;
 	}
+	return 1;
 }
 
 //////////////////////////////////////////
@@ -171,6 +803,8 @@ void Engine_ctor(void) {
 	QActive_ctor(&me->super, Q_STATE_CAST(&Engine_initial));
 
 	QTimeEvt_ctorX(&me->timeEvt, (QActive *)me, TIMEOUT_SIG, 0U);
+	me->credits = RENDER_CREDITS;
+	me->numBacklog = 0;
 }
 
 /**
@@ -183,7 +817,7 @@ static QState Engine_initial(Engine * const me, QEvt const * const e) {
 	QActive_subscribe((QActive *)me, ENGINE_END_SIG);
 	QActive_subscribe((QActive *)me, KEY_DETECT_SIG);
 
-	QTimeEvt_armX(&me->timeEvt, BSP_TICKS_PER_SEC * 5, 0);
+	TICKER_ARM(&me->timeEvt, BSP_TICKS_PER_SEC * 5, 0);
 
 	return Q_TRAN(&Idle);
 }
@@ -201,7 +835,43 @@ static QState Idle(Engine * const me, QEvt const * const e) {
 	}
 	/// - @ref ENGINE_START_SIG
 	case ENGINE_START_SIG: {
-		test_sections();
+		post_SESSION_START(0);
+		return Q_HANDLED();
+	}
+	/// - @ref SESSION_START_SIG
+	case SESSION_START_SIG: {
+		uint16_t session = ((SessionEvt *)e)->session;
+		Session* s = Session_get(session);
+		if (s != NULL) {
+			build_layout(&s->layout);
+			post_INSTALL_LAYOUT(session, &LAYOUT_test);
+			s->jobs = JOBS_INITIAL;
+			s->jobSort = -1;
+			s->jobFilter = -1;
+			post_ATTACH_VIEW(session, JOBS_KEY, VIEW_TABLE, &l_jobSpec, s);
+			s->logLines = 0;
+			post_ATTACH_VIEW(session, LOG_KEY, VIEW_WRAP, NULL, NULL);
+			s->lastKeyAt = 0;
+			post_ATTACH_VIEW(session, CHART_KEY, VIEW_CHART, &l_keyChartSpec, NULL);
+			post_REGISTER_INPUT(session);
+		}
+		if (session + 1 < Session_count()) {
+			post_SESSION_START(session + 1);
+		}
+		return Q_HANDLED();
+	}
+	/// - @ref RENDER_CREDIT_SIG
+	case RENDER_CREDIT_SIG: {
+		me->credits += RenderArtist_collectCredits();
+		flush_backlog(me);
+		return Q_HANDLED();
+	}
+	/// - @ref RENDER_STEP_SIG
+	/// - @ref VIEW_STEP_SIG
+	case RENDER_STEP_SIG:
+	case VIEW_STEP_SIG: {
+		// only reached once every other queue is empty; keys queued first went first
+		QACTIVE_POST(AO_RenderArtist, e, AO_Engine);
 		return Q_HANDLED();
 	}
 	/// - @ref TIMEOUT_SIG
@@ -217,10 +887,65 @@ static QState Idle(Engine * const me, QEvt const * const e) {
 	}
 	/// - @ref KEY_DETECT_SIG
 	case KEY_DETECT_SIG: {
-		int key = ((KeyEvt *)e)->key;
-		char canvas[MAX_SCREEN_WIDTH];
-		snprintf(canvas, MAX_SCREEN_WIDTH, "%d", key);
-		post_PAINT_LINE(next_sec(), 0, 0, canvas);
+		KeyEvt* keyEvt = (KeyEvt *)e;
+		Session* s = Session_get(keyEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		if (keyEvt->key == KEY_RESIZE) {
+			relayout(s);
+		}
+		Session_charge(s, METRIC_STAGE_ENGINE, start);
+		return Q_HANDLED();
+	}
+	/// - @ref FOCUS_KEY_SIG
+	case FOCUS_KEY_SIG: {
+		FocusKeyEvt* keyEvt = (FocusKeyEvt *)e;
+		Session* s = Session_get(keyEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		chart_key(s, start);
+		if (s->searching) {
+			search_key(s, keyEvt->key);
+		} else if (keyEvt->key == SEARCH_KEY) {
+			s->searching = 1;
+			s->queryLen = 0;
+			post_SEARCH(s->id, s->query, 0);
+		} else if (keyEvt->key == HELP_KEY) {
+			toggle_help(s);
+		} else if (keyEvt->key == SAVE_KEY) {
+			save_screen(me, s);
+		} else if (keyEvt->key == LOAD_KEY) {
+			load_screen(me, s);
+		} else if (keyEvt->key == CHECKPOINT_KEY) {
+			post_LAYER_HISTORY(s->id, CHECKPOINT_LAYER_SIG);
+		} else if (keyEvt->key == UNDO_KEY) {
+			undo_screen(s);
+		} else if (!job_key(s, keyEvt->key)) {
+			char canvas[MAX_SCREEN_WIDTH];
+			snprintf(canvas, MAX_SCREEN_WIDTH, "%d", keyEvt->key);
+			post_PAINT_LINE(s->id, next_sec(s), 0, 0, canvas);
+			snprintf(canvas, MAX_SCREEN_WIDTH, "key %d painted in the next test section", keyEvt->key);
+			log_line(s, canvas);
+		}
+		Session_charge(s, METRIC_STAGE_ENGINE, start);
+		return Q_HANDLED();
+	}
+	/// - @ref FILE_RESULT_SIG
+	case FILE_RESULT_SIG: {
+		FileResultEvt* resultEvt = (FileResultEvt *)e;
+		Session* s = Session_get(resultEvt->tag & ~LOAD_TAG);
+		if (s == NULL) {
+			// the session closed while the file was busy
+		} else if (!(resultEvt->tag & LOAD_TAG)) {
+			log_line(s, (resultEvt->status == 0) ? "screen saved" : "screen could not be saved");
+		} else if (resultEvt->status == 0) {
+			log_screen(s, resultEvt->data, resultEvt->length);
+		} else {
+			log_line(s, "no saved screen could be loaded");
+		}
+		free(resultEvt->data);
 		return Q_HANDLED();
 	}
 	}
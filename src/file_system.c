@@ -0,0 +1,733 @@
+/**
+ * @file file_system.c
+ * FileSystem, toot toot.
+ *
+ * Every request is a short sequence of system calls (open, read or
+ * write until done, close, ...) driven by the FileSystem's state machine.
+ * Each call is handed to a backend that runs it off the event loop and
+ * posts @ref FILE_DONE_SIG with its result:
+ * - io_uring, when built with FS_IO_URING and the kernel supports every
+ *   operation used; a reaper thread waits for completions
+ * - otherwise a small pool of worker threads running the blocking calls
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "main.h"
+
+#if FS_IO_URING && defined(__linux__)
+#define FS_HAVE_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#else
+#define FS_HAVE_URING 0
+#endif
+
+/**Mode of saved files, before the umask.*/
+#define FS_SAVE_MODE 0644
+
+static QState FileSystem_initial(FileSystem * const me, QEvt const * const e);
+static QState Idle(FileSystem * const me, QEvt const * const e);
+
+static void (*l_submit)(uint16_t job);	///< Hands a job's step to the backend
+
+//////////////////////////////////////////
+/// @ingroup Fwk
+/// @defgroup AOFileSystem Active Object - FileSystem
+///	States for file system active object.
+/// @{
+/////////////////////////////////////////
+
+/**
+ * Reports the result of a system call. Posted from backend threads.
+ *
+ * @ref FILE_DONE_SIG, @ref AOFileSystem
+ *
+ * @param[in] job Request slot
+ * @param[in] res System call result, negative errno on failure
+ */
+static void post_FILE_DONE(uint16_t job, int32_t res) {
+	FileDoneEvt* e = Q_NEW(FileDoneEvt, FILE_DONE_SIG);
+	if (e) {
+		e->job = job;
+		e->res = res;
+		QACTIVE_POST(AO_FileSystem, (QEvt *)e, (void *)0);
+	}
+}
+
+/**
+ * Reports a finished request.
+ *
+ * @ref FILE_RESULT_SIG
+ *
+ * @param[in] requester Object that made the request
+ * @param[in] tag		Caller's request tag
+ * @param[in] status	0 on success, negative errno on failure
+ * @param[in] data		Contents read, handed to the requester, or NULL
+ * @param[in] length	Bytes in @p data
+ */
+static void post_FILE_RESULT(QActive* requester, uint16_t tag, int32_t status, char* data, uint32_t length) {
+	FileResultEvt* e = Q_NEW(FileResultEvt, FILE_RESULT_SIG);
+	if (e) {
+		e->tag = tag;
+		e->status = status;
+		e->data = data;
+		e->length = length;
+		QACTIVE_POST(requester, (QEvt *)e, AO_FileSystem);
+	} else {
+		free(data);
+	}
+}
+
+/**
+ * Posts a file request.
+ */
+static int post_request(enum_t sig, QActive* requester, uint16_t tag, char const* path, char* data, uint32_t length) {
+	if (strlen(path) >= FILE_PATH_LEN) {
+		return -1;
+	}
+	FileReqEvt* e = Q_NEW(FileReqEvt, sig);
+	if (e == NULL) {
+		return -1;
+	}
+	e->requester = requester;
+	e->tag = tag;
+	strcpy(e->path, path);
+	e->data = data;
+	e->length = length;
+	QACTIVE_POST(AO_FileSystem, (QEvt *)e, requester);
+	return 0;
+}
+
+/**
+ * Reads a whole file. The requester gets @ref FILE_RESULT_SIG with the
+ * contents, which it must free().
+ *
+ * @ref FILE_READ_SIG, @ref AOFileSystem
+ *
+ * @param[in] requester Object the result is posted to
+ * @param[in] tag		Echoed in the result
+ * @param[in] path		File to read
+ *
+ * @returns 0 if the request was posted, -1 if the path is too long
+ */
+int FileSystem_read(QActive* requester, uint16_t tag, char const* path) {
+	return post_request(FILE_READ_SIG, requester, tag, path, NULL, 0);
+}
+
+/**
+ * Replaces a file. The data is written to a temporary file that is
+ * flushed and renamed over the target, so readers see the old or the new
+ * contents, never a mix. The requester gets @ref FILE_RESULT_SIG.
+ *
+ * @ref FILE_SAVE_SIG, @ref AOFileSystem
+ *
+ * @param[in] requester Object the result is posted to
+ * @param[in] tag		Echoed in the result
+ * @param[in] path		File to replace
+ * @param[in] data		Bytes to write, from malloc(); freed by the FileSystem
+ * @param[in] length	Bytes in @p data
+ *
+ * @returns 0 if the request was posted, -1 if the path is too long (@p data is then still the caller's)
+ */
+int FileSystem_save(QActive* requester, uint16_t tag, char const* path, char* data, uint32_t length) {
+	return post_request(FILE_SAVE_SIG, requester, tag, path, data, length);
+}
+
+/// @}
+/////////////////////////////////////////
+
+/**
+ * Gives the bytes a read or write step moves. A read that has filled a
+ * buffer of @ref FS_MAX_FILE bytes asks for one more byte, into the slot
+ * kept for the NUL, to tell a file of exactly that size from a longer one.
+ *
+ * @param[in] job Job
+ *
+ * @returns Bytes to read or write
+ */
+static uint32_t step_len(FileJob const* job) {
+	return (job->done < job->capacity || job->save) ? job->capacity - job->done : 1;
+}
+
+/**
+ * Runs a job's step as a blocking system call.
+ *
+ * @param[in] job Job
+ *
+ * @returns System call result, negative errno on failure
+ */
+static int32_t run_step(FileJob const* job) {
+	long res = -1;
+	switch (job->step) {
+	case FS_STEP_OPEN:
+		res = job->save ? open(job->tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, FS_SAVE_MODE)
+				: open(job->path, O_RDONLY | O_CLOEXEC);
+		break;
+	case FS_STEP_READ:
+		res = pread(job->fd, &job->data[job->done], step_len(job), job->done);
+		break;
+	case FS_STEP_WRITE:
+		res = pwrite(job->fd, &job->data[job->done], step_len(job), job->done);
+		break;
+	case FS_STEP_FSYNC:
+		res = fsync(job->fd);
+		break;
+	case FS_STEP_CLOSE:
+		res = close(job->fd);
+		break;
+	case FS_STEP_RENAME:
+		res = rename(job->tmpPath, job->path);
+		break;
+	case FS_STEP_UNLINK:
+		res = unlink(job->tmpPath);
+		break;
+	}
+	return (res < 0) ? -errno : (int32_t)res;
+}
+
+/////////////////////////////////////////
+/// Worker thread backend
+/////////////////////////////////////////
+
+static pthread_t l_workers[FS_WORKERS];			///< Worker threads
+static int l_numWorkers;						///< Number of started workers
+static pthread_mutex_t l_lock = PTHREAD_MUTEX_INITIALIZER;	///< Guards the work queue
+static pthread_cond_t l_ready = PTHREAD_COND_INITIALIZER;	///< Signalled when work is queued
+static uint16_t l_work[FS_MAX_JOBS];			///< Jobs waiting for a worker
+static int l_workHead;							///< Oldest waiting job
+static int l_workLen;							///< Number of waiting jobs
+static int l_stopping;							///< Set to stop the backend
+
+/**
+ * Worker thread: runs queued steps one at a time.
+ */
+static void* worker_thread(void* arg) {
+	FileSystem* me = (FileSystem *)arg;
+	for (;;) {
+		pthread_mutex_lock(&l_lock);
+		while (l_workLen == 0 && !l_stopping) {
+			pthread_cond_wait(&l_ready, &l_lock);
+		}
+		if (l_stopping) {
+			pthread_mutex_unlock(&l_lock);
+			break;
+		}
+		uint16_t job = l_work[l_workHead];
+		l_workHead = (l_workHead + 1) % FS_MAX_JOBS;
+		l_workLen--;
+		pthread_mutex_unlock(&l_lock);
+
+		post_FILE_DONE(job, run_step(&me->jobs[job]));
+	}
+	return (void *)0;
+}
+
+/**
+ * Queues a job's step for the workers.
+ * Each job has at most one step in flight, so the queue cannot overflow.
+ */
+static void submit_worker(uint16_t job) {
+	pthread_mutex_lock(&l_lock);
+	l_work[(l_workHead + l_workLen++) % FS_MAX_JOBS] = job;
+	pthread_cond_signal(&l_ready);
+	pthread_mutex_unlock(&l_lock);
+}
+
+/**
+ * Starts the worker threads.
+ *
+ * @returns 0 on success, -1 if no worker could be started
+ */
+static int start_workers(FileSystem* me) {
+	for (l_numWorkers = 0; l_numWorkers < FS_WORKERS; l_numWorkers++) {
+		if (pthread_create(&l_workers[l_numWorkers], (pthread_attr_t *)0, &worker_thread, me) != 0) {
+			break;
+		}
+	}
+	l_submit = &submit_worker;
+	return (l_numWorkers > 0) ? 0 : -1;
+}
+
+/**
+ * Stops the worker threads; steps still queued are abandoned.
+ */
+static void stop_workers(void) {
+	pthread_mutex_lock(&l_lock);
+	l_stopping = 1;
+	pthread_cond_broadcast(&l_ready);
+	pthread_mutex_unlock(&l_lock);
+	for (int i = 0; i < l_numWorkers; i++) {
+		pthread_join(l_workers[i], (void **)0);
+	}
+	l_numWorkers = 0;
+}
+
+#if FS_HAVE_URING
+
+/////////////////////////////////////////
+/// io_uring backend
+/////////////////////////////////////////
+
+/**Submission queue entries; one per job plus the stop request.*/
+#define FS_RING_ENTRIES 32
+/**User data of the request that stops the reaper.*/
+#define FS_RING_STOP 0xFFFFU
+
+/**
+ * @struct FileRing
+ * Rings shared with the kernel. Submissions come from the event loop and
+ * completions are consumed by the reaper thread only.
+ */
+typedef struct {
+	int			fd;			///< Ring descriptor, or -1
+	void*		sqMap;		///< Submission ring mapping
+	size_t		sqMapLen;	///< Length of @ref sqMap
+	void*		cqMap;		///< Completion ring mapping, may equal @ref sqMap
+	size_t		cqMapLen;	///< Length of @ref cqMap
+	struct io_uring_sqe* sqes;	///< Submission entries
+	size_t		sqesLen;	///< Length of @ref sqes
+	unsigned*	sqTail;		///< Submission tail, written by us
+	unsigned*	sqMask;		///< Submission index mask
+	unsigned*	sqArray;	///< Submission index array
+	unsigned*	cqHead;		///< Completion head, written by us
+	unsigned*	cqTail;		///< Completion tail, written by the kernel
+	unsigned*	cqMask;		///< Completion index mask
+	struct io_uring_cqe* cqes;	///< Completion entries
+} FileRing;
+
+static FileRing l_ring = { .fd = -1 };	///< The ring
+static pthread_t l_reaper;				///< Completion thread
+static FileSystem* l_me;				///< Owner of the jobs, for preparing entries
+
+/**Operations every request may use.*/
+static const uint8_t l_ringOps[] = {
+	IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC,
+	IORING_OP_CLOSE, IORING_OP_RENAMEAT, IORING_OP_UNLINKAT, IORING_OP_NOP,
+};
+
+/**
+ * Checks that the kernel supports every operation used.
+ *
+ * @returns 1 if supported, 0 otherwise
+ */
+static int ring_supports_ops(void) {
+	size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe* probe = calloc(1, len);
+	int ok = 0;
+	if (probe != NULL && syscall(__NR_io_uring_register, l_ring.fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+		ok = 1;
+		for (size_t i = 0; i < sizeof(l_ringOps); i++) {
+			if (l_ringOps[i] > probe->last_op || !(probe->ops[l_ringOps[i]].flags & IO_URING_OP_SUPPORTED)) {
+				ok = 0;
+			}
+		}
+	}
+	free(probe);
+	return ok;
+}
+
+/**
+ * Unmaps and closes the ring.
+ */
+static void ring_close(void) {
+	if (l_ring.sqes != NULL && l_ring.sqes != MAP_FAILED) { munmap(l_ring.sqes, l_ring.sqesLen); }
+	if (l_ring.cqMap != NULL && l_ring.cqMap != MAP_FAILED && l_ring.cqMap != l_ring.sqMap) { munmap(l_ring.cqMap, l_ring.cqMapLen); }
+	if (l_ring.sqMap != NULL && l_ring.sqMap != MAP_FAILED) { munmap(l_ring.sqMap, l_ring.sqMapLen); }
+	if (l_ring.fd >= 0) { close(l_ring.fd); }
+	memset(&l_ring, 0, sizeof(l_ring));
+	l_ring.fd = -1;
+}
+
+/**
+ * Creates and maps the ring.
+ *
+ * @returns 0 on success, -1 if io_uring is unavailable
+ */
+static int ring_open(void) {
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	l_ring.fd = syscall(__NR_io_uring_setup, FS_RING_ENTRIES, &p);
+	if (l_ring.fd < 0) {
+		return -1;
+	}
+
+	l_ring.sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	l_ring.cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (l_ring.cqMapLen > l_ring.sqMapLen) { l_ring.sqMapLen = l_ring.cqMapLen; }
+		l_ring.cqMapLen = l_ring.sqMapLen;
+	}
+	l_ring.sqMap = mmap(NULL, l_ring.sqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, l_ring.fd, IORING_OFF_SQ_RING);
+	if (l_ring.sqMap == MAP_FAILED) {
+		ring_close();
+		return -1;
+	}
+	l_ring.cqMap = (p.features & IORING_FEAT_SINGLE_MMAP) ? l_ring.sqMap
+			: mmap(NULL, l_ring.cqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, l_ring.fd, IORING_OFF_CQ_RING);
+	l_ring.sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+	l_ring.sqes = mmap(NULL, l_ring.sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, l_ring.fd, IORING_OFF_SQES);
+	if (l_ring.cqMap == MAP_FAILED || l_ring.sqes == MAP_FAILED || !ring_supports_ops()) {
+		ring_close();
+		return -1;
+	}
+
+	char* sq = l_ring.sqMap;
+	char* cq = l_ring.cqMap;
+	l_ring.sqTail = (unsigned *)(sq + p.sq_off.tail);
+	l_ring.sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+	l_ring.sqArray = (unsigned *)(sq + p.sq_off.array);
+	l_ring.cqHead = (unsigned *)(cq + p.cq_off.head);
+	l_ring.cqTail = (unsigned *)(cq + p.cq_off.tail);
+	l_ring.cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+	l_ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	return 0;
+}
+
+/**
+ * Queues one entry and submits it.
+ * The kernel consumes entries during the submit call, so the ring never
+ * holds more than one.
+ */
+static void ring_push(struct io_uring_sqe const* sqe) {
+	unsigned tail = *l_ring.sqTail;
+	unsigned idx = tail & *l_ring.sqMask;
+	l_ring.sqes[idx] = *sqe;
+	l_ring.sqArray[idx] = idx;
+	__atomic_store_n(l_ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+	while (syscall(__NR_io_uring_enter, l_ring.fd, 1, 0, 0, NULL, 0) < 0 && errno == EINTR) {}
+}
+
+/**
+ * Submits a job's step to the ring.
+ */
+static void submit_ring(uint16_t id) {
+	FileJob* job = &l_me->jobs[id];
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.user_data = id;
+	sqe.fd = job->fd;
+
+	switch (job->step) {
+	case FS_STEP_OPEN:
+		sqe.opcode = IORING_OP_OPENAT;
+		sqe.fd = AT_FDCWD;
+		if (job->save) {
+			sqe.addr = (uintptr_t)job->tmpPath;
+			sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+			sqe.len = FS_SAVE_MODE;
+		} else {
+			sqe.addr = (uintptr_t)job->path;
+			sqe.open_flags = O_RDONLY | O_CLOEXEC;
+		}
+		break;
+	case FS_STEP_READ:
+	case FS_STEP_WRITE:
+		sqe.opcode = (job->step == FS_STEP_READ) ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe.addr = (uintptr_t)&job->data[job->done];
+		sqe.len = step_len(job);
+		sqe.off = job->done;
+		break;
+	case FS_STEP_FSYNC:
+		sqe.opcode = IORING_OP_FSYNC;
+		break;
+	case FS_STEP_CLOSE:
+		sqe.opcode = IORING_OP_CLOSE;
+		break;
+	case FS_STEP_RENAME:
+		sqe.opcode = IORING_OP_RENAMEAT;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = (uintptr_t)job->tmpPath;
+		sqe.len = AT_FDCWD;
+		sqe.addr2 = (uintptr_t)job->path;
+		break;
+	case FS_STEP_UNLINK:
+		sqe.opcode = IORING_OP_UNLINKAT;
+		sqe.fd = AT_FDCWD;
+		sqe.addr = (uintptr_t)job->tmpPath;
+		break;
+	}
+	ring_push(&sqe);
+}
+
+/**
+ * Reaper thread: turns completions into events until asked to stop.
+ */
+static void* reaper_thread(void* arg) {
+	int stop = 0;
+	(void)arg; /* unused parameter */
+
+	while (!stop) {
+		if (syscall(__NR_io_uring_enter, l_ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+			break;
+		}
+		unsigned head = *l_ring.cqHead;
+		unsigned tail = __atomic_load_n(l_ring.cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			struct io_uring_cqe const* cqe = &l_ring.cqes[head & *l_ring.cqMask];
+			if (cqe->user_data == FS_RING_STOP) {
+				stop = 1;
+			} else {
+				post_FILE_DONE((uint16_t)cqe->user_data, cqe->res);
+			}
+		}
+		__atomic_store_n(l_ring.cqHead, head, __ATOMIC_RELEASE);
+	}
+	return (void *)0;
+}
+
+/**
+ * Sets up the ring and its reaper.
+ *
+ * @returns 0 on success, -1 if io_uring is unavailable
+ */
+static int start_ring(FileSystem* me) {
+	l_me = me;
+	if (ring_open() != 0) {
+		return -1;
+	}
+	if (pthread_create(&l_reaper, (pthread_attr_t *)0, &reaper_thread, (void *)0) != 0) {
+		ring_close();
+		return -1;
+	}
+	l_submit = &submit_ring;
+	return 0;
+}
+
+/**
+ * Stops the reaper and releases the ring; requests in flight are abandoned.
+ */
+static void stop_ring(void) {
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_NOP;
+	sqe.user_data = FS_RING_STOP;
+	ring_push(&sqe);
+	pthread_join(l_reaper, (void **)0);
+	ring_close();
+}
+
+#endif // FS_HAVE_URING
+
+/**
+ * Ends a request: reports it and frees its slot.
+ *
+ * @param[in,out] job Finished job
+ */
+static void finish(FileJob* job) {
+	if (job->save || job->status != 0) {
+		free(job->data);
+		post_FILE_RESULT(job->requester, job->tag, job->status, NULL, 0);
+	} else {
+		job->data[job->done] = '\0';
+		post_FILE_RESULT(job->requester, job->tag, 0, job->data, job->done);
+	}
+	job->data = NULL;
+	job->requester = NULL;
+}
+
+/**
+ * Records a failure; the file is still closed, and a partial save removed.
+ *
+ * @param[in,out] job Job
+ * @param[in]	  res Negative errno
+ */
+static void fail(FileJob* job, int32_t res) {
+	job->status = res;
+	job->step = (job->fd >= 0) ? FS_STEP_CLOSE : FS_STEP_UNLINK;
+}
+
+/**
+ * Moves a job on after its step completed.
+ *
+ * @param[in,out] me FileSystem
+ * @param[in]	  id Request slot
+ * @param[in]	  res Result of the step
+ */
+static void advance(FileSystem* me, uint16_t id, int32_t res) {
+	if (id >= FS_MAX_JOBS || me->jobs[id].requester == NULL) { return; }
+	FileJob* job = &me->jobs[id];
+
+	switch (job->step) {
+	case FS_STEP_OPEN:
+		if (res < 0) {
+			// nothing was opened or created
+			job->status = res;
+			finish(job);
+			return;
+		}
+		job->fd = res;
+		job->step = job->save ? FS_STEP_WRITE : FS_STEP_READ;
+		if (job->save && job->capacity == 0) { job->step = FS_STEP_FSYNC; }
+		break;
+	case FS_STEP_READ:
+		if (res < 0) { fail(job, res); break; }
+		if (res == 0) { job->step = FS_STEP_CLOSE; break; }
+		if (job->done == job->capacity) {
+			// the probe past FS_MAX_FILE found more data
+			fail(job, -EFBIG);
+			break;
+		}
+		job->done += res;
+		if (job->done == job->capacity && job->capacity < FS_MAX_FILE) {
+			uint32_t grown = (job->capacity * 2 < FS_MAX_FILE) ? job->capacity * 2 : FS_MAX_FILE;
+			char* data = realloc(job->data, grown + 1);
+			if (data == NULL) {
+				fail(job, -ENOMEM);
+				break;
+			}
+			job->data = data;
+			job->capacity = grown;
+		}
+		break;
+	case FS_STEP_WRITE:
+		if (res < 0) { fail(job, res); break; }
+		job->done += res;
+		if (job->done == job->capacity) { job->step = FS_STEP_FSYNC; }
+		break;
+	case FS_STEP_FSYNC:
+		if (res < 0) { fail(job, res); break; }
+		job->step = FS_STEP_CLOSE;
+		break;
+	case FS_STEP_CLOSE:
+		job->fd = -1;
+		if (res < 0 && job->status == 0) { job->status = res; }
+		if (!job->save) { finish(job); return; }
+		job->step = (job->status == 0) ? FS_STEP_RENAME : FS_STEP_UNLINK;
+		break;
+	case FS_STEP_RENAME:
+		if (res < 0) { fail(job, res); break; }
+		finish(job);
+		return;
+	case FS_STEP_UNLINK:
+		finish(job);
+		return;
+	}
+	l_submit(id);
+}
+
+/**
+ * Starts a request in a free slot.
+ *
+ * @param[in,out] me FileSystem
+ * @param[in]	  e	 Request
+ */
+static void start_job(FileSystem* me, FileReqEvt const* e) {
+	int save = (e->evt.sig == FILE_SAVE_SIG);
+	uint16_t id;
+	for (id = 0; id < FS_MAX_JOBS; id++) {
+		if (me->jobs[id].requester == NULL) { break; }
+	}
+
+	char* data = save ? e->data : malloc(FS_CHUNK + 1);
+	if (id == FS_MAX_JOBS || (!save && data == NULL)) {
+		free(data);
+		post_FILE_RESULT(e->requester, e->tag, (id == FS_MAX_JOBS) ? -EBUSY : -ENOMEM, NULL, 0);
+		return;
+	}
+
+	FileJob* job = &me->jobs[id];
+	job->requester = e->requester;
+	job->tag = e->tag;
+	job->save = save;
+	job->step = FS_STEP_OPEN;
+	job->fd = -1;
+	job->status = 0;
+	strcpy(job->path, e->path);
+	snprintf(job->tmpPath, sizeof(job->tmpPath), "%s.tmp", e->path);
+	job->data = data;
+	job->capacity = save ? e->length : FS_CHUNK;
+	job->done = 0;
+	l_submit(id);
+}
+
+//////////////////////////////////////////
+/// @addtogroup AOFileSystem
+/// @{
+
+/**
+ * Local reference.
+ */
+static FileSystem l_fileSystem;
+/**Global FileSystem AO*/
+QActive * const AO_FileSystem = &l_fileSystem.super;
+
+/**
+ * Constructor.
+ */
+void FileSystem_ctor(void) {
+	FileSystem *me = (FileSystem *)AO_FileSystem;
+	QActive_ctor(&me->super, Q_STATE_CAST(&FileSystem_initial));
+	for (int i = 0; i < FS_MAX_JOBS; i++) {
+		me->jobs[i].requester = NULL;
+	}
+}
+
+/**
+ * Stops the I/O backend. Requests still in flight are abandoned.
+ */
+void FileSystem_stop(void) {
+	FileSystem *me = (FileSystem *)AO_FileSystem;
+	if (l_submit == NULL) { return; }
+#if FS_HAVE_URING
+	if (me->uring) {
+		stop_ring();
+	} else {
+		stop_workers();
+	}
+#else
+	(void)me;
+	stop_workers();
+#endif
+	l_submit = NULL;
+}
+
+/**
+ * Initial.
+ */
+static QState FileSystem_initial(FileSystem * const me, QEvt const * const e) {
+	(void)e; /* unused parameter */
+
+	me->uring = 0;
+#if FS_HAVE_URING
+	me->uring = (start_ring(me) == 0);
+#endif
+	if (!me->uring) {
+		start_workers(me);
+	}
+
+	return Q_TRAN(&Idle);
+}
+
+/**
+ * Idle state.
+ */
+static QState Idle(FileSystem * const me, QEvt const * const e) {
+	switch (e->sig) {
+	/// - @ref FILE_READ_SIG
+	case FILE_READ_SIG:
+	/// - @ref FILE_SAVE_SIG
+	case FILE_SAVE_SIG: {
+		start_job(me, (FileReqEvt *)e);
+		return Q_HANDLED();
+	}
+	/// - @ref FILE_DONE_SIG
+	case FILE_DONE_SIG: {
+		FileDoneEvt* doneEvt = (FileDoneEvt *)e;
+		advance(me, doneEvt->job, doneEvt->res);
+		return Q_HANDLED();
+	}
+	}
+	return Q_SUPER(&QHsm_top);
+}
+
+/// @}
+//////////////////////////////////////////
@@ -0,0 +1,397 @@
+/**
+ * @file frame_exporter.c
+ * Streams presented frames to local viewers over a Unix domain socket.
+ *
+ * Each presented frame is diffed against the previous one and encoded once;
+ * the same bytes are then queued for every synchronized viewer. Sockets are
+ * non-blocking: a viewer whose buffer cannot take the next diff is dropped
+ * to resync and receives a keyframe once its buffer has drained, so a slow
+ * viewer never holds up painting. Runs holding glyphs are sent as UTF-8.
+ *
+ * Built with FRAME_SHM, each presented frame is also published in shared
+ * memory, see frame_shm.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "main.h"
+
+/**Largest possible encoded message: every run costs at most 8 header bytes,
+ * runs are at least 2 cells apart, and a column takes at most one glyph.*/
+#define FRAME_MSG_MAX (32 + MAX_SCREEN_HEIGHT * MAX_SCREEN_WIDTH * (GLYPH_MAX_BYTES + 4))
+/**Unchanged cells tolerated inside a run before it is split.*/
+#define FRAME_RUN_GAP 3
+
+#if FRAME_MSG_MAX > FRAME_EXPORT_BUF_LEN
+#error "a viewer buffer must hold a whole keyframe"
+#endif
+
+/**
+ * @struct FrameMsg
+ * Message being encoded.
+ */
+typedef struct {
+	uint8_t	 data[FRAME_MSG_MAX];	///< Length prefix followed by payload
+	uint32_t len;					///< Bytes used
+	uint32_t runsAt;				///< Offset of the run count placeholder
+	uint32_t runs;					///< Runs written
+	int		 row;					///< Row of the previous run
+	int		 col;					///< End column of the previous run
+} FrameMsg;
+
+static FrameMsg l_diff;	///< Diff of the frame being presented
+static FrameMsg l_key;	///< Keyframe of the frame being presented
+
+/**
+ * Appends an unsigned LEB128 varint.
+ */
+static void put_varint(FrameMsg* m, uint32_t v) {
+	while (v >= 0x80) {
+		m->data[m->len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	m->data[m->len++] = (uint8_t)v;
+}
+
+/**
+ * Starts a message. The run count is a fixed 3-byte varint patched by
+ * end_msg(), which allows up to 2^21 runs.
+ */
+static void begin_msg(FrameMsg* m, FrameMsgType type, uint32_t frame) {
+	m->len = 4; // length prefix
+	m->data[m->len++] = (uint8_t)type;
+	put_varint(m, frame);
+	put_varint(m, MAX_SCREEN_HEIGHT);
+	put_varint(m, MAX_SCREEN_WIDTH);
+	m->runsAt = m->len;
+	m->len += 3;
+	m->runs = 0;
+	m->row = 0;
+	m->col = 0;
+}
+
+/**
+ * Appends the UTF-8 of a run of cells holding glyphs. Halves of wide
+ * glyphs cut off by later paints are sent blank.
+ */
+static void put_utf8(FrameMsg* m, GlyphTable const* glyphs, char const* cells, int len) {
+	uint8_t text[MAX_SCREEN_WIDTH * GLYPH_MAX_BYTES];
+	uint32_t bytes = 0;
+	for (int i = 0; i < len; i++) {
+		int bytesLen, width;
+		char const* glyph = Glyph_bytes(glyphs, cells[i], &bytesLen, &width);
+		if (glyph != NULL && (width == 1 || (i + 1 < len && cells[i + 1] == (char)GLYPH_TAIL))) {
+			memcpy(&text[bytes], glyph, bytesLen);
+			bytes += bytesLen;
+			i += width - 1;
+		} else {
+			text[bytes++] = Glyph_isGlyph(cells[i]) ? ' ' : (uint8_t)cells[i];
+		}
+	}
+	put_varint(m, bytes);
+	memcpy(&m->data[m->len], text, bytes);
+	m->len += bytes;
+}
+
+/**
+ * Appends a run of cells, as UTF-8 if it holds glyphs.
+ */
+static void put_run(FrameMsg* m, GlyphTable const* glyphs, int row, int col, char const* cells, int len) {
+	int utf8 = 0;
+	for (int i = 0; i < len && !utf8; i++) {
+		utf8 = Glyph_isGlyph(cells[i]);
+	}
+	put_varint(m, row - m->row);
+	put_varint(m, (row == m->row) ? col - m->col : col);
+	put_varint(m, (uint32_t)len << 1 | (utf8 ? FRAME_RUN_UTF8 : FRAME_RUN_CELLS));
+	if (utf8) {
+		put_utf8(m, glyphs, cells, len);
+	} else {
+		memcpy(&m->data[m->len], cells, len);
+		m->len += len;
+	}
+	m->runs++;
+	m->row = row;
+	m->col = col + len;
+}
+
+/**
+ * Patches the length prefix and run count.
+ */
+static void end_msg(FrameMsg* m) {
+	uint32_t payload = m->len - 4;
+	for (int i = 0; i < 4; i++) {
+		m->data[i] = (uint8_t)(payload >> (8 * i));
+	}
+	m->data[m->runsAt] = (uint8_t)(m->runs | 0x80);
+	m->data[m->runsAt + 1] = (uint8_t)((m->runs >> 7) | 0x80);
+	m->data[m->runsAt + 2] = (uint8_t)(m->runs >> 14);
+}
+
+/**
+ * Encodes the cells of dirty rows that differ from what viewers last got.
+ *
+ * @param[in,out] me Exporter; @ref FrameExporter::sent is brought up to date
+ */
+static void encode_diff(FrameExporter* me) {
+	begin_msg(&l_diff, FRAME_MSG_DIFF, me->frame);
+	for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+		if (!me->dirty[row]) { continue; }
+		char* cur = me->cells[row];
+		char* old = me->sent[row];
+		int col = 0;
+		while (col < MAX_SCREEN_WIDTH) {
+			if (cur[col] == old[col]) { col++; continue; }
+			int start = col;
+			int end = col + 1;
+			for (col = end; col < MAX_SCREEN_WIDTH && col - end < FRAME_RUN_GAP; col++) {
+				if (cur[col] != old[col]) { end = col + 1; }
+			}
+			// wide glyphs go out whole
+			if (start > 0 && cur[start] == (char)GLYPH_TAIL) { start--; }
+			if (end < MAX_SCREEN_WIDTH && cur[end] == (char)GLYPH_TAIL) { end++; }
+			put_run(&l_diff, me->glyphs, row, start, &cur[start], end - start);
+			col = end;
+		}
+		memcpy(old, cur, MAX_SCREEN_WIDTH);
+	}
+	end_msg(&l_diff);
+}
+
+/**
+ * Encodes the whole frame.
+ *
+ * @param[in] me Exporter
+ */
+static void encode_key(FrameExporter* me) {
+	begin_msg(&l_key, FRAME_MSG_KEY, me->frame);
+	for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+		put_run(&l_key, me->glyphs, row, 0, me->cells[row], MAX_SCREEN_WIDTH);
+	}
+	end_msg(&l_key);
+}
+
+/**
+ * Disconnects a viewer.
+ */
+static void drop_viewer(FrameViewer* v) {
+	close(v->fd);
+	free(v->buf);
+	v->fd = -1;
+	v->buf = NULL;
+}
+
+/**
+ * Sends as much of a viewer's pending bytes as the socket takes without blocking.
+ *
+ * @returns 0 on success, -1 if the viewer went away
+ */
+static int flush_viewer(FrameViewer* v) {
+	while (v->sent < v->len) {
+		ssize_t n = send(v->fd, &v->buf[v->sent], v->len - v->sent, MSG_NOSIGNAL);
+		if (n < 0) {
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+		}
+		v->sent += n;
+		Metrics_count(METRIC_EXPORT_BYTES, n);
+	}
+	v->sent = v->len = 0;
+	return 0;
+}
+
+/**
+ * Queues a message for a viewer if it fits.
+ *
+ * @returns 1 if queued, 0 if the viewer's buffer is too full
+ */
+static int queue_msg(FrameViewer* v, FrameMsg const* m) {
+	if (v->sent > 0) { // compact
+		memmove(v->buf, &v->buf[v->sent], v->len - v->sent);
+		v->len -= v->sent;
+		v->sent = 0;
+	}
+	if (m->len > (uint32_t)(FRAME_EXPORT_BUF_LEN - v->len)) {
+		return 0;
+	}
+	memcpy(&v->buf[v->len], m->data, m->len);
+	v->len += m->len;
+	return 1;
+}
+
+/**
+ * Accepts pending connections; new viewers start with a keyframe.
+ */
+static void accept_viewers(FrameExporter* me) {
+	int fd;
+	while ((fd = accept(me->listenFd, NULL, NULL)) >= 0) {
+		FrameViewer* v = NULL;
+		for (int i = 0; i < FRAME_EXPORT_MAX_VIEWERS; i++) {
+			if (me->viewers[i].fd < 0) {
+				v = &me->viewers[i];
+				break;
+			}
+		}
+		if (v == NULL || (v->buf = malloc(FRAME_EXPORT_BUF_LEN)) == NULL) {
+			close(fd);
+			continue;
+		}
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		shutdown(fd, SHUT_RD); // viewers are read-only
+		v->fd = fd;
+		v->resync = 1;
+		v->sent = v->len = 0;
+	}
+}
+
+/**
+ * Creates the session's listening socket.
+ *
+ * @param[out] me	   Exporter
+ * @param[in]  session Session ID
+ * @param[in]  glyphs  Table the session's glyph cells are laid out with
+ */
+void FrameExporter_open(FrameExporter* me, uint16_t session, GlyphTable const* glyphs) {
+	struct sockaddr_un addr;
+
+	memset(me, 0, sizeof(FrameExporter));
+	for (int i = 0; i < FRAME_EXPORT_MAX_VIEWERS; i++) {
+		me->viewers[i].fd = -1;
+	}
+	memset(me->cells, ' ', sizeof(me->cells));
+	memset(me->sent, ' ', sizeof(me->sent));
+	me->glyphs = glyphs;
+#if FRAME_SHM
+	me->shm = FrameShm_open(session);
+#endif
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), FRAME_EXPORT_PATH, (int)getpid(), session);
+	unlink(addr.sun_path);
+
+	me->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (me->listenFd < 0) {
+		return;
+	}
+	if (bind(me->listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+			|| listen(me->listenFd, FRAME_EXPORT_MAX_VIEWERS) != 0) {
+		close(me->listenFd);
+		me->listenFd = -1;
+		return;
+	}
+	fcntl(me->listenFd, F_SETFL, O_NONBLOCK);
+}
+
+/**
+ * Disconnects all viewers and removes the socket and shared memory.
+ *
+ * @param[in,out] me	  Exporter
+ * @param[in]	  session Session ID
+ */
+void FrameExporter_close(FrameExporter* me, uint16_t session) {
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+	for (int i = 0; i < FRAME_EXPORT_MAX_VIEWERS; i++) {
+		if (me->viewers[i].fd >= 0) {
+			drop_viewer(&me->viewers[i]);
+		}
+	}
+	if (me->listenFd >= 0) {
+		close(me->listenFd);
+		me->listenFd = -1;
+		snprintf(path, sizeof(path), FRAME_EXPORT_PATH, (int)getpid(), session);
+		unlink(path);
+	}
+	if (me->shm != NULL) {
+		FrameShm_close(me->shm, session);
+		me->shm = NULL;
+	}
+}
+
+/**
+ * Records cells drawn by the painter.
+ *
+ * @param[in,out] me   Exporter
+ * @param[in]	  y	   Row
+ * @param[in]	  x	   Column
+ * @param[in]	  text	 Cells, clipped at the screen edge; glyphs whole
+ * @param[in]	  length Bytes of @p text
+ */
+void FrameExporter_paint(FrameExporter* me, int y, int x, char const* text, size_t length) {
+	if (y < 0 || y >= MAX_SCREEN_HEIGHT || x < 0 || x >= MAX_SCREEN_WIDTH) {
+		return;
+	}
+	size_t room = MAX_SCREEN_WIDTH - x;
+	size_t len = strnlen(text, (length < room) ? length : room);
+	memcpy(&me->cells[y][x], text, len);
+	me->dirty[y] = 1;
+}
+
+/**
+ * Publishes the painted frame to every viewer and to shared memory.
+ *
+ * @param[in,out] me Exporter
+ */
+void FrameExporter_present(FrameExporter* me) {
+	int synced = 0;
+
+	me->frame++;
+	if (me->shm != NULL) {
+		FrameShm_publish(me->shm, me->frame, &me->cells[0][0], me->dirty);
+	}
+	if (me->listenFd < 0) {
+		memset(me->dirty, 0, sizeof(me->dirty));
+		return;
+	}
+	accept_viewers(me);
+
+	for (int i = 0; i < FRAME_EXPORT_MAX_VIEWERS; i++) {
+		FrameViewer* v = &me->viewers[i];
+		if (v->fd < 0) { continue; }
+		if (flush_viewer(v) != 0) {
+			drop_viewer(v);
+		} else if (!v->resync) {
+			synced = 1;
+		}
+	}
+
+	if (synced) {
+		encode_diff(me);
+	} else {
+		for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+			if (me->dirty[row]) {
+				memcpy(me->sent[row], me->cells[row], MAX_SCREEN_WIDTH);
+			}
+		}
+	}
+	memset(me->dirty, 0, sizeof(me->dirty));
+
+	int keyReady = 0;
+	for (int i = 0; i < FRAME_EXPORT_MAX_VIEWERS; i++) {
+		FrameViewer* v = &me->viewers[i];
+		if (v->fd < 0) { continue; }
+
+		if (v->resync) {
+			if (v->len != 0) { continue; } // still draining, resync once idle
+			if (!keyReady) {
+				encode_key(me);
+				keyReady = 1;
+			}
+			if (!queue_msg(v, &l_key)) { continue; } // stays in resync
+			v->resync = 0;
+		} else if (l_diff.runs != 0 && !queue_msg(v, &l_diff)) {
+			v->resync = 1; // too slow, skip ahead with a keyframe later
+			continue;
+		}
+		if (flush_viewer(v) != 0) {
+			drop_viewer(v);
+		}
+	}
+}
@@ -0,0 +1,185 @@
+/**
+ * @file frame_shm.c
+ * Publishes presented frames in POSIX shared memory.
+ *
+ * Local tools map the region and read the latest frame without a copy
+ * through the kernel or a system call. The painter is the only writer:
+ * publishing a frame is two stores to the sequence counter around the
+ * changed rows, so it takes the same time however many readers there
+ * are, and a reader stalled mid-copy costs the painter nothing. The
+ * module is QP-free so readers can link it on its own.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "frame_shm.h"
+#include "glyph.h"
+
+/**Attempts FrameShm_read() makes before giving up on a frame that is being rewritten.*/
+#define FRAME_SHM_READ_TRIES 1000
+
+/**
+ * Formats the shared memory object name of a session.
+ */
+static void shm_name(char* name, size_t size, pid_t pid, uint16_t session) {
+	snprintf(name, size, FRAME_SHM_NAME, (int)pid, session);
+}
+
+/**
+ * Creates a session's region, blank and at frame 0.
+ *
+ * @param[in] session Session ID
+ *
+ * @returns Mapped region, or NULL if shared memory is unavailable
+ */
+FrameShm* FrameShm_open(uint16_t session) {
+	char name[64];
+	shm_name(name, sizeof(name), getpid(), session);
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		return NULL;
+	}
+	FrameShm* shm = MAP_FAILED;
+	if (ftruncate(fd, sizeof(FrameShm)) == 0) {
+		shm = mmap(NULL, sizeof(FrameShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (shm == MAP_FAILED) {
+		shm_unlink(name);
+		return NULL;
+	}
+
+	shm->version = FRAME_SHM_VERSION;
+	shm->rows = MAX_SCREEN_HEIGHT;
+	shm->cols = MAX_SCREEN_WIDTH;
+	memset(shm->cells, ' ', sizeof(shm->cells));
+	__atomic_store_n(&shm->magic, FRAME_SHM_MAGIC, __ATOMIC_RELEASE);
+	return shm;
+}
+
+/**
+ * Unmaps and removes a session's region. Readers that still have it
+ * mapped keep the last frame.
+ *
+ * @param[in] shm	  Region
+ * @param[in] session Session ID
+ */
+void FrameShm_close(FrameShm* shm, uint16_t session) {
+	char name[64];
+	shm_name(name, sizeof(name), getpid(), session);
+	munmap(shm, sizeof(FrameShm));
+	shm_unlink(name);
+}
+
+/**
+ * Publishes a frame. Only the rows marked dirty are copied.
+ *
+ * @param[in,out] shm	Region
+ * @param[in]	  frame Frame number, increasing
+ * @param[in]	  cells Complete frame, MAX_SCREEN_WIDTH cells per row
+ * @param[in]	  dirty Non-zero for each row that changed since the last frame
+ */
+void FrameShm_publish(FrameShm* shm, uint32_t frame, char const* cells, uint8_t const* dirty) {
+	uint32_t bits[FRAME_SHM_DIRTY_WORDS] = { 0 };
+	uint32_t seq = shm->seq;
+
+	__atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+		if (!dirty[row]) { continue; }
+		char const* src = &cells[row * MAX_SCREEN_WIDTH];
+		for (int col = 0; col < MAX_SCREEN_WIDTH; col++) {
+			shm->cells[row][col] = Glyph_isGlyph(src[col]) ? GLYPH_REPLACEMENT : src[col];
+		}
+		__atomic_store_n(&shm->rowFrame[row], frame, __ATOMIC_RELAXED);
+		bits[row / 32] |= 1U << (row % 32);
+	}
+	for (int i = 0; i < FRAME_SHM_DIRTY_WORDS; i++) {
+		__atomic_store_n(&shm->dirty[i], bits[i], __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&shm->frame, frame, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Maps a session's region read-only.
+ *
+ * @param[in] pid	  Process serving the session
+ * @param[in] session Session ID
+ *
+ * @returns Region, or NULL if it does not exist or is of another version
+ */
+FrameShm const* FrameShm_attach(pid_t pid, uint16_t session) {
+	char name[64];
+	shm_name(name, sizeof(name), pid, session);
+
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+	FrameShm const* shm = mmap(NULL, sizeof(FrameShm), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		return NULL;
+	}
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != FRAME_SHM_MAGIC
+			|| shm->version != FRAME_SHM_VERSION
+			|| shm->rows != MAX_SCREEN_HEIGHT || shm->cols != MAX_SCREEN_WIDTH) {
+		munmap((void *)shm, sizeof(FrameShm));
+		return NULL;
+	}
+	return shm;
+}
+
+/**
+ * Unmaps a region mapped by FrameShm_attach().
+ *
+ * @param[in] shm Region
+ */
+void FrameShm_detach(FrameShm const* shm) {
+	munmap((void *)shm, sizeof(FrameShm));
+}
+
+/**
+ * Copies the rows that changed after a given frame. The copy is retried
+ * while the painter rewrites the region, so it is always of one frame.
+ *
+ * @param[in]	  shm	Region
+ * @param[in,out] cells Frame held by the caller, updated to the latest one
+ * @param[in]	  since	Frame @p cells holds, or 0 to copy every row
+ *
+ * @returns Frame now in @p cells; 0 before the first frame, or if the
+ *			painter never finished a frame while trying (e.g. it died writing one)
+ */
+uint32_t FrameShm_read(FrameShm const* shm, char cells[][MAX_SCREEN_WIDTH], uint32_t since) {
+	for (int tries = 0; tries < FRAME_SHM_READ_TRIES; tries++) {
+		uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		uint32_t frame = __atomic_load_n(&shm->frame, __ATOMIC_RELAXED);
+		for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+			if (since == 0 || __atomic_load_n(&shm->rowFrame[row], __ATOMIC_RELAXED) > since) {
+				memcpy(cells[row], shm->cells[row], MAX_SCREEN_WIDTH);
+			}
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq) {
+			return frame;
+		}
+	}
+	return 0;
+}
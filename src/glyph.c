@@ -0,0 +1,552 @@
+/**
+ * @file glyph.c
+ * UTF-8 text in byte cells.
+ *
+ * Layer cells stay one byte wide. A character outside ASCII, together
+ * with the combining marks that follow it, is interned once as a glyph
+ * and drawn as its handle, a cell value from @ref GLYPH_FIRST up; a
+ * glyph two columns wide is followed by a @ref GLYPH_TAIL cell. Cells
+ * therefore stay display columns, so clipping, borders and damage work
+ * as for ASCII, which is copied straight through without a lookup.
+ *
+ * Glyphs are interned in the table of the session the cells belong to,
+ * see GlyphTable. Handles are few, so glyphs no cell holds any more are
+ * reclaimed: when a table is full, its reclaim callback marks every glyph
+ * still in use and the rest are swept, see Glyph_setReclaim().
+ *
+ * A DEL byte would read as @ref GLYPH_TAIL, so it is laid out as
+ * @ref GLYPH_REPLACEMENT like other text that cannot be shown.
+ *
+ * Display widths come from a two-stage table, expanded once by
+ * Glyph_init() from the ranges below: the top bits of a code point pick
+ * a 256-entry block of 2-bit width codes, and identical blocks are
+ * stored once. Until then every code point is one column wide.
+ */
+
+#include <string.h>
+
+#include "glyph.h"
+
+/**Code points per block of the width table.*/
+#define BLOCK_SIZE 256
+/**Blocks addressed by the first stage, covering every code point.*/
+#define NUM_STAGES (0x110000 / BLOCK_SIZE)
+/**Distinct blocks the second stage can hold.*/
+#define MAX_BLOCKS 128
+/**Code point of a malformed UTF-8 sequence.*/
+#define INVALID_CP 0xFFFFFFFFU
+
+/**
+ * @enum WidthCode
+ * Widths as stored in the table; narrow is 0 so an empty table is all narrow.
+ */
+typedef enum {
+	WIDTH_NARROW,	///< One column
+	WIDTH_WIDE,		///< Two columns
+	WIDTH_ZERO,		///< Combines with the previous character
+	WIDTH_CONTROL,	///< Not printable
+} WidthCode;
+
+/**
+ * @struct CpRange
+ * Inclusive range of code points.
+ */
+typedef struct {
+	uint32_t first;
+	uint32_t last;
+} CpRange;
+
+/**East Asian wide and fullwidth characters, and emoji shown wide.*/
+static const CpRange l_wide[] = {
+	{ 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC },
+	{ 0x23F0, 0x23F0 }, { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 },
+	{ 0x2648, 0x2653 }, { 0x267F, 0x267F }, { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 },
+	{ 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 }, { 0x26CE, 0x26CE },
+	{ 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+	{ 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B },
+	{ 0x2728, 0x2728 }, { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 },
+	{ 0x2757, 0x2757 }, { 0x2795, 0x2797 }, { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF },
+	{ 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 }, { 0x2E80, 0x303E },
+	{ 0x3041, 0xA4CF }, { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF },
+	{ 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F }, { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 },
+	{ 0x16FE0, 0x16FE3 }, { 0x16FF0, 0x16FF1 }, { 0x17000, 0x18D08 }, { 0x1AFF0, 0x1B2FF },
+	{ 0x1F004, 0x1F004 }, { 0x1F0CF, 0x1F0CF }, { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A },
+	{ 0x1F200, 0x1F202 }, { 0x1F210, 0x1F23B }, { 0x1F240, 0x1F248 }, { 0x1F250, 0x1F251 },
+	{ 0x1F260, 0x1F265 }, { 0x1F300, 0x1F320 }, { 0x1F32D, 0x1F335 }, { 0x1F337, 0x1F37C },
+	{ 0x1F37E, 0x1F393 }, { 0x1F3A0, 0x1F3CA }, { 0x1F3CF, 0x1F3D3 }, { 0x1F3E0, 0x1F3F0 },
+	{ 0x1F3F4, 0x1F3F4 }, { 0x1F3F8, 0x1F43E }, { 0x1F440, 0x1F440 }, { 0x1F442, 0x1F4FC },
+	{ 0x1F4FF, 0x1F53D }, { 0x1F54B, 0x1F54E }, { 0x1F550, 0x1F567 }, { 0x1F57A, 0x1F57A },
+	{ 0x1F595, 0x1F596 }, { 0x1F5A4, 0x1F5A4 }, { 0x1F5FB, 0x1F64F }, { 0x1F680, 0x1F6C5 },
+	{ 0x1F6CC, 0x1F6CC }, { 0x1F6D0, 0x1F6D2 }, { 0x1F6D5, 0x1F6D7 }, { 0x1F6DC, 0x1F6DF },
+	{ 0x1F6EB, 0x1F6EC }, { 0x1F6F4, 0x1F6FC }, { 0x1F7E0, 0x1F7EB }, { 0x1F7F0, 0x1F7F0 },
+	{ 0x1F90C, 0x1F93A }, { 0x1F93C, 0x1F945 }, { 0x1F947, 0x1F9FF }, { 0x1FA70, 0x1FAFF },
+	{ 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD },
+};
+
+/**Combining marks, joiners and other characters without width; applied over @ref l_wide.*/
+static const CpRange l_zero[] = {
+	{ 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF },
+	{ 0x05C1, 0x05C2 }, { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A },
+	{ 0x064B, 0x065F }, { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 },
+	{ 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 }, { 0x0730, 0x074A },
+	{ 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x0816, 0x082D }, { 0x0859, 0x085B },
+	{ 0x0898, 0x089F }, { 0x08CA, 0x08E1 }, { 0x08E3, 0x0902 }, { 0x093A, 0x093A },
+	{ 0x093C, 0x093C }, { 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 },
+	{ 0x0962, 0x0963 }, { 0x0981, 0x0981 }, { 0x09BC, 0x09BC }, { 0x09C1, 0x09C4 },
+	{ 0x09CD, 0x09CD }, { 0x09E2, 0x09E3 }, { 0x0A01, 0x0A02 }, { 0x0A3C, 0x0A3C },
+	{ 0x0A41, 0x0A51 }, { 0x0A70, 0x0A71 }, { 0x0A75, 0x0A75 }, { 0x0A81, 0x0A82 },
+	{ 0x0ABC, 0x0ABC }, { 0x0AC1, 0x0AC8 }, { 0x0ACD, 0x0ACD }, { 0x0AE2, 0x0AE3 },
+	{ 0x0B01, 0x0B01 }, { 0x0B3C, 0x0B3C }, { 0x0B3F, 0x0B3F }, { 0x0B41, 0x0B44 },
+	{ 0x0B4D, 0x0B4D }, { 0x0B56, 0x0B56 }, { 0x0B62, 0x0B63 }, { 0x0B82, 0x0B82 },
+	{ 0x0BC0, 0x0BC0 }, { 0x0BCD, 0x0BCD }, { 0x0C00, 0x0C00 }, { 0x0C3E, 0x0C40 },
+	{ 0x0C46, 0x0C56 }, { 0x0C62, 0x0C63 }, { 0x0CBC, 0x0CBC }, { 0x0CCC, 0x0CCD },
+	{ 0x0D41, 0x0D44 }, { 0x0D4D, 0x0D4D }, { 0x0DCA, 0x0DCA }, { 0x0DD2, 0x0DD6 },
+	{ 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x0EB1, 0x0EB1 },
+	{ 0x0EB4, 0x0EBC }, { 0x0EC8, 0x0ECE }, { 0x0F18, 0x0F19 }, { 0x0F35, 0x0F35 },
+	{ 0x0F37, 0x0F37 }, { 0x0F39, 0x0F39 }, { 0x0F71, 0x0F7E }, { 0x0F80, 0x0F84 },
+	{ 0x0F86, 0x0F87 }, { 0x0F8D, 0x0FBC }, { 0x0FC6, 0x0FC6 }, { 0x102D, 0x1030 },
+	{ 0x1032, 0x1037 }, { 0x1039, 0x103A }, { 0x103D, 0x103E }, { 0x1058, 0x1059 },
+	{ 0x1160, 0x11FF }, { 0x135D, 0x135F }, { 0x1712, 0x1714 }, { 0x17B4, 0x17B5 },
+	{ 0x17B7, 0x17BD }, { 0x17C6, 0x17C6 }, { 0x17C9, 0x17D3 }, { 0x17DD, 0x17DD },
+	{ 0x180B, 0x180F }, { 0x18A9, 0x18A9 }, { 0x1920, 0x1922 }, { 0x1927, 0x1928 },
+	{ 0x1932, 0x1932 }, { 0x1939, 0x193B }, { 0x1A17, 0x1A18 }, { 0x1AB0, 0x1AFF },
+	{ 0x1B00, 0x1B03 }, { 0x1B34, 0x1B34 }, { 0x1B36, 0x1B3A }, { 0x1B6B, 0x1B73 },
+	{ 0x1DC0, 0x1DFF }, { 0x200B, 0x200F }, { 0x202A, 0x202E }, { 0x2060, 0x2064 },
+	{ 0x20D0, 0x20F0 }, { 0x2CEF, 0x2CF1 }, { 0x2DE0, 0x2DFF }, { 0x302A, 0x302D },
+	{ 0x3099, 0x309A }, { 0xA66F, 0xA672 }, { 0xA674, 0xA67D }, { 0xA69E, 0xA69F },
+	{ 0xA6F0, 0xA6F1 }, { 0xA802, 0xA802 }, { 0xA806, 0xA806 }, { 0xA80B, 0xA80B },
+	{ 0xA825, 0xA826 }, { 0xA8C4, 0xA8C5 }, { 0xA8E0, 0xA8F1 }, { 0xA926, 0xA92D },
+	{ 0xA947, 0xA951 }, { 0xA980, 0xA982 }, { 0xA9B3, 0xA9B3 }, { 0xA9B6, 0xA9B9 },
+	{ 0xA9BC, 0xA9BD }, { 0xAA29, 0xAA2E }, { 0xAA31, 0xAA32 }, { 0xAA35, 0xAA36 },
+	{ 0xAA43, 0xAA43 }, { 0xAA4C, 0xAA4C }, { 0xAAB0, 0xAAB0 }, { 0xAAB2, 0xAAB4 },
+	{ 0xAAB7, 0xAAB8 }, { 0xAABE, 0xAABF }, { 0xAAC1, 0xAAC1 }, { 0xABE5, 0xABE5 },
+	{ 0xABE8, 0xABE8 }, { 0xABED, 0xABED }, { 0xD7B0, 0xD7FF }, { 0xFB1E, 0xFB1E },
+	{ 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF }, { 0x1D167, 0x1D169 },
+	{ 0x1D173, 0x1D182 }, { 0x1D185, 0x1D18B }, { 0x1D1AA, 0x1D1AD }, { 0x1F3FB, 0x1F3FF },
+	{ 0xE0001, 0xE0001 }, { 0xE0020, 0xE007F }, { 0xE0100, 0xE01EF },
+};
+
+/**C1 controls, surrogates and non-characters; applied last.*/
+static const CpRange l_control[] = {
+	{ 0x0080, 0x009F }, { 0xD800, 0xDFFF }, { 0xFFFE, 0xFFFF },
+};
+
+static uint8_t l_stage[NUM_STAGES];					///< Block of each run of code points
+static uint8_t l_blocks[MAX_BLOCKS][BLOCK_SIZE / 4];	///< Distinct blocks of 2-bit width codes; block 0 is all narrow
+
+/**
+ * Sets the width code of the code points of a block that fall in some ranges.
+ *
+ * @param[in,out] block	 Block being built
+ * @param[in]	  start	 First code point of the block
+ * @param[in]	  ranges Sorted ranges
+ * @param[in]	  n		 Number of ranges
+ * @param[in]	  code	 Width code to set
+ */
+static void apply_ranges(uint8_t block[BLOCK_SIZE / 4], uint32_t start, CpRange const* ranges, int n, WidthCode code) {
+	uint32_t end = start + BLOCK_SIZE - 1;
+	int lo = 0;
+	int hi = n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (ranges[mid].last < start) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	for (int i = lo; i < n && ranges[i].first <= end; i++) {
+		uint32_t first = (ranges[i].first > start) ? ranges[i].first : start;
+		uint32_t last = (ranges[i].last < end) ? ranges[i].last : end;
+		for (uint32_t cp = first; cp <= last; cp++) {
+			int bit = (cp & 3) * 2;
+			uint8_t* b = &block[(cp - start) >> 2];
+			*b = (uint8_t)((*b & ~(3 << bit)) | (code << bit));
+		}
+	}
+}
+
+/**
+ * @returns Width code of a code point
+ */
+static WidthCode width_code(uint32_t cp) {
+	if (cp >= 0x110000) { return WIDTH_CONTROL; }
+	return (WidthCode)((l_blocks[l_stage[cp >> 8]][(cp & 0xFF) >> 2] >> ((cp & 3) * 2)) & 3);
+}
+
+/**
+ * @returns FNV-1a hash of a glyph's UTF-8
+ */
+static uint32_t hash_of(char const* bytes, int len) {
+	uint32_t hash = 2166136261U;
+	for (int i = 0; i < len; i++) {
+		hash = (hash ^ (unsigned char)bytes[i]) * 16777619U;
+	}
+	return hash;
+}
+
+/**
+ * Finds or adds a glyph.
+ *
+ * @param[in,out] table	Table
+ * @param[in]	  bytes	UTF-8 of the glyph
+ * @param[in]	  len	Length of @p bytes
+ * @param[in]	  width	Columns
+ *
+ * @returns Cell value of the glyph, or 0 if the table is full or the glyph too long
+ */
+static unsigned char intern(GlyphTable* table, char const* bytes, int len, int width) {
+	if (len > GLYPH_MAX_BYTES) { return 0; }
+
+	uint32_t hash = hash_of(bytes, len);
+	for (uint32_t probe = 0; probe < GLYPH_INDEX_SIZE; probe++) {
+		uint8_t* slot = &table->index[(hash + probe) % GLYPH_INDEX_SIZE];
+		if (*slot == 0) {
+			if (table->numGlyphs == GLYPH_MAX) { return 0; }
+			int i = 0;
+			while (table->glyphs[i].len != 0) {
+				i++;
+			}
+			GlyphEntry* g = &table->glyphs[i];
+			memcpy(g->bytes, bytes, len);
+			g->len = (uint8_t)len;
+			g->width = (uint8_t)width;
+			table->numGlyphs++;
+			*slot = (uint8_t)(i + 1);
+			return (unsigned char)(GLYPH_FIRST + i);
+		}
+		GlyphEntry const* g = &table->glyphs[*slot - 1];
+		if (g->len == len && memcmp(g->bytes, bytes, len) == 0) {
+			return (unsigned char)(GLYPH_FIRST + *slot - 1);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Interns a glyph for a line being laid out. If the table is full, the
+ * glyphs of the line so far are marked and the reclaim callback is run,
+ * once per line, before trying again.
+ *
+ * @param[in,out] table		Table
+ * @param[in]	  bytes		UTF-8 of the glyph
+ * @param[in]	  len		Length of @p bytes
+ * @param[in]	  width		Columns
+ * @param[in]	  cells		Cells of the line so far
+ * @param[in]	  col		Number of @p cells
+ * @param[in,out] reclaimed	Set once the callback has run for the line
+ *
+ * @returns Cell value of the glyph, or 0 if none could be had
+ */
+static unsigned char intern_for(GlyphTable* table, char const* bytes, int len, int width, char const* cells, int col,
+		int* reclaimed) {
+	unsigned char glyph = intern(table, bytes, len, width);
+	if (glyph == 0 && table->numGlyphs == GLYPH_MAX && table->reclaim != NULL && !*reclaimed) {
+		*reclaimed = 1;
+		Glyph_mark(table, cells, col);
+		table->reclaim(table->reclaimArg);
+		glyph = intern(table, bytes, len, width);
+	}
+	return glyph;
+}
+
+/**
+ * Expands the width table. Blocks equal to one already stored share it.
+ */
+void Glyph_init(void) {
+	int n = 1;
+	memset(l_blocks[0], 0, sizeof(l_blocks[0]));
+	for (uint32_t s = 0; s < NUM_STAGES; s++) {
+		uint8_t block[BLOCK_SIZE / 4] = { 0 };
+		uint32_t start = s * BLOCK_SIZE;
+		apply_ranges(block, start, l_wide, sizeof(l_wide) / sizeof(l_wide[0]), WIDTH_WIDE);
+		apply_ranges(block, start, l_zero, sizeof(l_zero) / sizeof(l_zero[0]), WIDTH_ZERO);
+		apply_ranges(block, start, l_control, sizeof(l_control) / sizeof(l_control[0]), WIDTH_CONTROL);
+
+		int b = (s > 0 && memcmp(block, l_blocks[l_stage[s - 1]], sizeof(block)) == 0) ? l_stage[s - 1] : -1;
+		for (int i = 0; i < n && b < 0; i++) {
+			if (memcmp(block, l_blocks[i], sizeof(block)) == 0) {
+				b = i;
+			}
+		}
+		if (b < 0 && n < MAX_BLOCKS) {
+			memcpy(l_blocks[n], block, sizeof(block));
+			b = n++;
+		}
+		l_stage[s] = (uint8_t)((b < 0) ? 0 : b);
+	}
+}
+
+/**
+ * Empties a glyph table; it has no reclaim callback until one is set.
+ *
+ * @param[out] table Table
+ */
+void Glyph_initTable(GlyphTable* table) {
+	memset(table, 0, sizeof(GlyphTable));
+}
+
+/**
+ * Looks up the display width of a character.
+ *
+ * @param[in] cp Code point
+ *
+ * @returns Columns: 1, 2, 0 for a combining character, -1 if not printable
+ */
+int Glyph_width(uint32_t cp) {
+	switch (width_code(cp)) {
+	case WIDTH_NARROW: return 1;
+	case WIDTH_WIDE: return 2;
+	case WIDTH_ZERO: return 0;
+	default: return -1;
+	}
+}
+
+/**
+ * Decodes one UTF-8 sequence. Overlong, truncated and out-of-range
+ * sequences decode as one invalid byte.
+ *
+ * @param[in]  text	Text, at least one byte
+ * @param[in]  len	Bytes available
+ * @param[out] cp	Code point, 0xFFFFFFFF if invalid
+ *
+ * @returns Bytes consumed, at least 1
+ */
+int Glyph_decode(char const* text, int len, uint32_t* cp) {
+	unsigned char const* s = (unsigned char const *)text;
+	int n = (s[0] < 0x80) ? 1 : (s[0] >= 0xC2 && s[0] < 0xE0) ? 2 : (s[0] >= 0xE0 && s[0] < 0xF0) ? 3
+			: (s[0] >= 0xF0 && s[0] < 0xF5) ? 4 : 0;
+	if (n == 0 || n > len) {
+		*cp = INVALID_CP;
+		return 1;
+	}
+
+	uint32_t c = (n == 1) ? s[0] : s[0] & (0x7F >> n);
+	for (int i = 1; i < n; i++) {
+		if ((s[i] & 0xC0) != 0x80) {
+			*cp = INVALID_CP;
+			return 1;
+		}
+		c = (c << 6) | (s[i] & 0x3F);
+	}
+	static const uint32_t least[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+	*cp = (c < least[n] || c >= 0x110000) ? INVALID_CP : c;
+	return (*cp == INVALID_CP) ? 1 : n;
+}
+
+/**
+ * Measures a character and the combining marks after it.
+ *
+ * @param[in]  text	 Text, starting at a non-ASCII byte
+ * @param[in]  len	 Bytes available
+ * @param[out] width Columns: 1 or 2, 0 for marks with nothing to combine with, -1 if not printable
+ *
+ * @returns Bytes taken by the character and its marks
+ */
+static int measure(char const* text, int len, int* width) {
+	uint32_t cp;
+	int end = Glyph_decode(text, len, &cp);
+	*width = (cp == INVALID_CP) ? -1 : Glyph_width(cp);
+	if (*width < 0) { return end; }
+
+	while (end < len && ((unsigned char)text[end] & 0x80)) {
+		int n = Glyph_decode(&text[end], len - end, &cp);
+		if (cp == INVALID_CP || Glyph_width(cp) != 0) { break; }
+		end += n;
+	}
+	return end;
+}
+
+/**
+ * Measures text in display columns. Bytes are counted in words of
+ * eight until a non-ASCII one turns up.
+ *
+ * @param[in] text Text
+ * @param[in] len  Bytes in @p text
+ *
+ * @returns Columns the text takes once laid out
+ */
+int Glyph_columns(char const* text, int len) {
+	int i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, &text[i], sizeof(word));
+		if (word & 0x8080808080808080ULL) { break; }
+	}
+	while (i < len && !((unsigned char)text[i] & 0x80)) {
+		i++;
+	}
+
+	int columns = i;
+	while (i < len) {
+		if (!((unsigned char)text[i] & 0x80)) {
+			columns++;
+			i++;
+			continue;
+		}
+		int width;
+		i += measure(&text[i], len - i, &width);
+		columns += (width < 0) ? 1 : width;
+	}
+	return columns;
+}
+
+/**
+ * Lays out UTF-8 text as cells. ASCII is copied as is; other characters
+ * become glyph cells in a table, and ones that cannot be shown or
+ * interned become @ref GLYPH_REPLACEMENT. A wide character that does not
+ * fit whole is left out, so the text never spills over the columns given.
+ *
+ * @param[in,out] table	  Table the glyphs are interned in
+ * @param[in]	  text	  Text
+ * @param[in]	  len	  Bytes in @p text
+ * @param[out]	  cells	  Cells
+ * @param[in]	  columns Columns available in @p cells
+ *
+ * @returns Cells written
+ */
+int Glyph_layout(GlyphTable* table, char const* text, int len, char* cells, int columns) {
+	int col = 0;
+	int i = 0;
+	int reclaimed = 0;
+	while (i < len && col < columns) {
+		int run = i;
+		int limit = (len - i < columns - col) ? len : i + columns - col;
+		while (run < limit && (unsigned char)text[run] < GLYPH_TAIL) {
+			run++;
+		}
+		memcpy(&cells[col], &text[i], run - i);
+		col += run - i;
+		i = run;
+		if (i == len || col == columns) { break; }
+		if (text[i] == (char)GLYPH_TAIL) {
+			cells[col++] = GLYPH_REPLACEMENT;
+			i++;
+			continue;
+		}
+
+		int width;
+		int end = i + measure(&text[i], len - i, &width);
+		if (width == 0 && col > 0 && !((unsigned char)text[i - 1] & 0x80)) {
+			unsigned char glyph = intern_for(table, &text[i - 1], end - i + 1, 1, cells, col - 1, &reclaimed);
+			if (glyph != 0) { cells[col - 1] = (char)glyph; }
+		} else if (width < 0) {
+			cells[col++] = GLYPH_REPLACEMENT;
+		} else if (width > columns - col) {
+			break;
+		} else if (width > 0) {
+			unsigned char glyph = intern_for(table, &text[i], end - i, width, cells, col, &reclaimed);
+			if (glyph == 0) {
+				memset(&cells[col], GLYPH_REPLACEMENT, width);
+			} else {
+				cells[col] = (char)glyph;
+				if (width == 2) { cells[col + 1] = (char)GLYPH_TAIL; }
+			}
+			col += width;
+		}
+		i = end;
+	}
+	return col;
+}
+
+/**
+ * Gives the text of a glyph cell.
+ *
+ * @param[in]  table Table the cell was laid out with
+ * @param[in]  cell	 Cell from @ref GLYPH_FIRST up
+ * @param[out] len	 Bytes of UTF-8
+ * @param[out] width Columns the glyph covers
+ *
+ * @returns UTF-8, or NULL if the cell is not an interned glyph
+ */
+char const* Glyph_bytes(GlyphTable const* table, char cell, int* len, int* width) {
+	int i = (unsigned char)cell - GLYPH_FIRST;
+	if (i < 0 || i >= GLYPH_MAX || table->glyphs[i].len == 0) { return NULL; }
+	*len = table->glyphs[i].len;
+	*width = table->glyphs[i].width;
+	return table->glyphs[i].bytes;
+}
+
+/**
+ * Sets what is called when a glyph is laid out while a table is full.
+ * The callback marks every cell laid out with the table that may still be
+ * drawn with Glyph_mark(), including cells kept off the layers, then calls
+ * Glyph_sweep(). The line being laid out is marked already.
+ *
+ * @param[in,out] table	  Table
+ * @param[in]	  reclaim Callback, NULL to leave a full table full
+ * @param[in]	  arg	  Passed to @p reclaim
+ */
+void Glyph_setReclaim(GlyphTable* table, GlyphReclaimCb reclaim, void* arg) {
+	table->reclaim = reclaim;
+	table->reclaimArg = arg;
+}
+
+/**
+ * Marks the glyphs some cells hold as in use until the next sweep.
+ * Bytes are checked in words of eight, skipping ASCII.
+ *
+ * @param[in,out] table Table the cells were laid out with
+ * @param[in]	  cells Cells
+ * @param[in]	  n		Number of cells
+ */
+void Glyph_mark(GlyphTable* table, char const* cells, size_t n) {
+	size_t i = 0;
+	while (i < n) {
+		if (i + 8 <= n) {
+			uint64_t word;
+			memcpy(&word, &cells[i], sizeof(word));
+			if (!(word & 0x8080808080808080ULL)) {
+				i += 8;
+				continue;
+			}
+		}
+		unsigned char c = (unsigned char)cells[i++];
+		if (c >= GLYPH_FIRST) {
+			table->marks[c - GLYPH_FIRST] = 1;
+		}
+	}
+}
+
+/**
+ * Frees the glyphs of a table not marked since the last sweep and clears
+ * the marks. Their handles are reused, so only glyphs no cell holds may
+ * be left unmarked.
+ *
+ * @param[in,out] table Table
+ *
+ * @returns Glyphs freed
+ */
+int Glyph_sweep(GlyphTable* table) {
+	int freed = 0;
+	for (int i = 0; i < GLYPH_MAX; i++) {
+		if (table->glyphs[i].len != 0 && !table->marks[i]) {
+			table->glyphs[i].len = 0;
+			freed++;
+		}
+	}
+	memset(table->marks, 0, sizeof(table->marks));
+	if (freed == 0) { return 0; }
+
+	table->numGlyphs -= freed;
+	memset(table->index, 0, sizeof(table->index));
+	for (int i = 0; i < GLYPH_MAX; i++) {
+		if (table->glyphs[i].len == 0) { continue; }
+		uint32_t hash = hash_of(table->glyphs[i].bytes, table->glyphs[i].len);
+		uint32_t probe = 0;
+		while (table->index[(hash + probe) % GLYPH_INDEX_SIZE] != 0) {
+			probe++;
+		}
+		table->index[(hash + probe) % GLYPH_INDEX_SIZE] = (uint8_t)(i + 1);
+	}
+	return freed;
+}
+
+/**
+ * @param[in] table Table
+ *
+ * @returns Glyphs interned and not swept
+ */
+int Glyph_count(GlyphTable const* table) {
+	return table->numGlyphs;
+}
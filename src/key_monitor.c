@@ -3,8 +3,15 @@
  * KeyMonitor, toot toot.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+
 #include "main.h"
 
+/**Scans a session keeps getting after its descriptor was last readable.*/
+#define KEY_SCAN_GRACE 3
+
 static QState KeyMonitor_initial(KeyMonitor * const me, QEvt const * const e);
 static QState Idle(KeyMonitor * const me, QEvt const * const e);
 
@@ -20,11 +27,13 @@ static QState Idle(KeyMonitor * const me, QEvt const * const e);
 /**
  * Notifies binding handler that a key was pressed.
  *
- * @param[in] key Key ID
+ * @param[in] session Session ID
+ * @param[in] key	  Key ID
  */
-static void post_KEY_DETECT_SIG(int key) {
+static void post_KEY_DETECT_SIG(uint16_t session, int key) {
 	KeyEvt* e = Q_NEW(KeyEvt, KEY_DETECT_SIG);
 	if (e) {
+		e->session = session;
 		e->key = key;
 		QACTIVE_POST(AO_BindingHandler, (QEvt *)e, AO_KeyMonitor);
 	}
@@ -37,8 +46,51 @@ static void post_KEY_DETECT_SIG(int key) {
  * Input initialization.
  */
 static void configure() {
-	keypad(stdscr, TRUE);
-	nodelay(stdscr, TRUE); // don't hang on getch
+	for (int i = 0; i < Session_count(); i++) {
+		Session* s = Session_get(i);
+		if (s == NULL) { continue; }
+		Session_select(s);
+		keypad(stdscr, TRUE);
+		nodelay(stdscr, TRUE); // don't hang on getch
+	}
+}
+
+/**
+ * Reads pending keys from every session with input.
+ * Descriptors are polled first so idle sessions cost no curses calls;
+ * a session is scanned for a few more ticks after its descriptor drains
+ * since curses may have buffered part of an escape sequence.
+ */
+static void scan() {
+	struct pollfd fds[MAX_SESSIONS];
+	int count = Session_count();
+
+	for (int i = 0; i < count; i++) {
+		Session* s = Session_get(i);
+		fds[i].fd = (s != NULL) ? s->fd : -1;
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+	poll(fds, count, 0);
+
+	for (int i = 0; i < count; i++) {
+		Session* s = Session_get(i);
+		if (s == NULL) { continue; }
+		if (fds[i].revents & POLLIN) {
+			s->scanGrace = KEY_SCAN_GRACE;
+		}
+		if (s->scanGrace == 0) { continue; }
+
+		uint64_t start = Session_clock();
+		Session_select(s);
+		int key = getch();
+		if (key != ERR) {
+			post_KEY_DETECT_SIG(s->id, key);
+		} else {
+			s->scanGrace--;
+		}
+		Session_charge(s, METRIC_STAGE_INPUT, start);
+	}
 }
 
 
@@ -61,6 +113,7 @@ void KeyMonitor_ctor(void) {
 	QActive_ctor(&me->super, Q_STATE_CAST(&KeyMonitor_initial));
 
 	QTimeEvt_ctorX(&me->keyScanEvt, (QActive *)me, KEY_SCAN_SIG, 0U);
+	Ticker_gateOnInput(&me->keyScanEvt); // scans only matter when input is pending
 }
 
 /**
@@ -82,15 +135,12 @@ static QState Idle(KeyMonitor * const me, QEvt const * const e) {
 	/// - @ref ENGINE_START_SIG
 	case ENGINE_START_SIG: {
 		configure();
-		QTimeEvt_armX(&me->keyScanEvt, 1, 1);
+		TICKER_ARM(&me->keyScanEvt, 1, 1);
 		return Q_HANDLED();
 	}
 	/// - @ref KEY_SCAN_SIG
 	case KEY_SCAN_SIG: {
-		int key = getch();
-		if (key != ERR) {
-			post_KEY_DETECT_SIG(key);
-		}
+		scan();
 		return Q_HANDLED();
 	}
 	}
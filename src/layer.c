@@ -0,0 +1,894 @@
+/**
+ * @file layer.c
+ * Layer drawing primitives.
+ * Free of framework dependencies so layouts can be pre-rendered at build time.
+ *
+ * Layer cells live in tiles taken from a shared pool the first time
+ * something is drawn into them, so a layer costs memory only for the
+ * area its sections cover. The pool grows a chunk at a time and tiles
+ * return to it when their layer is re-initialized.
+ *
+ * Tiles are reference counted and copied on write: a snapshot or a
+ * compiled layout shares the layer's tiles, and a tile is copied only
+ * when something is drawn into it while shared. Taking a snapshot thus
+ * costs a table of tile pointers, and installing a layout nothing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell_kernels.h"
+#include "glyph.h"
+#include "layer.h"
+
+/**Tiles allocated together when the pool runs dry.*/
+#define TILE_CHUNK 64
+/**Drawing level of the layer's sections, below every overlay.*/
+#define BASE_LEVEL (-1)
+
+static LayerTile* l_freeTiles;	///< Tile pool free list
+static size_t l_poolBytes;		///< Bytes allocated for the pool
+
+/**
+ * Takes a blank tile from the pool.
+ *
+ * @returns Tile, or NULL if out of memory
+ */
+static LayerTile* alloc_tile(void) {
+	if (l_freeTiles == NULL) {
+		LayerTile* chunk = malloc(TILE_CHUNK * sizeof(LayerTile));
+		if (chunk == NULL) { return NULL; }
+		l_poolBytes += TILE_CHUNK * sizeof(LayerTile);
+		for (int i = 0; i < TILE_CHUNK; i++) {
+			chunk[i].next = l_freeTiles;
+			l_freeTiles = &chunk[i];
+		}
+	}
+	LayerTile* tile = l_freeTiles;
+	l_freeTiles = tile->next;
+	memset(tile->cells, '\0', sizeof(tile->cells));
+	tile->refs = 1;
+	return tile;
+}
+
+/**
+ * Adds a reference to a tile.
+ *
+ * @param[in,out] tile Tile, or NULL
+ *
+ * @returns @p tile
+ */
+static LayerTile* share_tile(LayerTile* tile) {
+	if (tile != NULL && tile->refs != 0) {
+		tile->refs++;
+	}
+	return tile;
+}
+
+/**
+ * Drops a reference to a tile, returning it to the pool with the last one.
+ *
+ * @param[in,out] tile Tile, or NULL
+ */
+static void release_tile(LayerTile* tile) {
+	if (tile == NULL || tile->refs == 0 || --tile->refs != 0) {
+		return;
+	}
+	tile->next = l_freeTiles;
+	l_freeTiles = tile;
+}
+
+/**
+ * Drops every tile of a tile table.
+ *
+ * @param[in,out] tiles Table to empty
+ */
+static void release_tiles(LayerTile* tiles[LAYER_TILES_Y][LAYER_TILES_X]) {
+	for (int ty = 0; ty < LAYER_TILES_Y; ty++) {
+		for (int tx = 0; tx < LAYER_TILES_X; tx++) {
+			release_tile(tiles[ty][tx]);
+			tiles[ty][tx] = NULL;
+		}
+	}
+}
+
+/**
+ * Hands on the cells of every tile of a table.
+ */
+static void visit_tiles(LayerTile* const tiles[LAYER_TILES_Y][LAYER_TILES_X], LayerCellsCb visit, void* arg) {
+	for (int ty = 0; ty < LAYER_TILES_Y; ty++) {
+		for (int tx = 0; tx < LAYER_TILES_X; tx++) {
+			if (tiles[ty][tx] != NULL) {
+				visit(arg, &tiles[ty][tx]->cells[0][0], sizeof(tiles[ty][tx]->cells));
+			}
+		}
+	}
+}
+
+/**
+ * Finds a cell for writing, allocating its tile if needed.
+ * A shared tile is replaced by a private copy first.
+ *
+ * @returns Cell, or NULL if out of memory
+ */
+static char* cell_for_write(RenderLayer* layer, int x, int y) {
+	LayerTile** tile = &layer->tiles[y / LAYER_TILE_HEIGHT][x / LAYER_TILE_WIDTH];
+	if (*tile == NULL || (*tile)->refs != 1) {
+		LayerTile* copy = alloc_tile();
+		if (copy == NULL) {
+			return NULL;
+		}
+		if (*tile != NULL) {
+			memcpy(copy->cells, (*tile)->cells, sizeof(copy->cells));
+			release_tile(*tile);
+		}
+		*tile = copy;
+	}
+	return &(*tile)->cells[y % LAYER_TILE_HEIGHT][x % LAYER_TILE_WIDTH];
+}
+
+/**
+ * Finds where a cell drawn at some level is kept.
+ * A cell hidden by overlays above that level lives in the save-under of
+ * the lowest of them, which is what shows again once it closes.
+ *
+ * @param[in,out] layer	Layer to update
+ * @param[in]	  level	Overlay doing the drawing, BASE_LEVEL for sections
+ * @param[in]	  x		Column
+ * @param[in]	  y		Row
+ * @param[in]	  alloc	Set to allocate the cell's tile if it is empty
+ * @param[out]	  run	Cells from @p x kept next to each other in the same place
+ *
+ * @returns Cell, or NULL if its tile is empty and not allocated
+ */
+static char* cell_at(RenderLayer* layer, int level, int x, int y, int alloc, int* run) {
+	int limit = MAX_SCREEN_WIDTH;
+	for (int i = level + 1; i < layer->numOverlays; i++) {
+		RenderOverlay* o = &layer->overlays[i];
+		int left = o->section.xAnchor - 1;
+		int top = o->section.yAnchor - 1;
+		int right = o->section.xAnchor + o->section.xDim;
+		if (y < top || y > o->section.yAnchor + o->section.yDim) { continue; }
+		if (x >= left && x <= right) {
+			*run = ((right < limit) ? right + 1 : limit) - x;
+			return &o->saveUnder[(y - top) * (o->section.xDim + 2) + (x - left)];
+		}
+		if (left > x && left < limit) {
+			limit = left;
+		}
+	}
+
+	int tileEnd = (x / LAYER_TILE_WIDTH + 1) * LAYER_TILE_WIDTH;
+	*run = ((tileEnd < limit) ? tileEnd : limit) - x;
+	if (layer->tiles[y / LAYER_TILE_HEIGHT][x / LAYER_TILE_WIDTH] == NULL && !alloc) {
+		return NULL;
+	}
+	return cell_for_write(layer, x, y);
+}
+
+/**
+ * Sets a run of cells in one row. Clearing never allocates tiles.
+ *
+ * @param[in,out] layer	Layer to update
+ * @param[in]	  level	Overlay doing the drawing, BASE_LEVEL for sections
+ * @param[in]	  y		Row
+ * @param[in]	  left	Leftmost column
+ * @param[in]	  right	Rightmost column
+ * @param[in]	  c		Character to fill with
+ */
+static void fill_row(RenderLayer* layer, int level, int y, int left, int right, char c) {
+	int col = left;
+	while (col <= right) {
+		int run;
+		char* cell = cell_at(layer, level, col, y, c != '\0', &run);
+		if (run > right - col + 1) {
+			run = right - col + 1;
+		}
+		if (cell != NULL) {
+			Cells_fill(cell, c, run);
+		}
+		col += run;
+	}
+}
+
+/**
+ * Draws a run of border in one row, keeping existing corners.
+ *
+ * @param[in,out] layer	 Layer to update
+ * @param[in]	  level	 Overlay doing the drawing, BASE_LEVEL for sections
+ * @param[in]	  y		 Row
+ * @param[in]	  left	 Leftmost column
+ * @param[in]	  right	 Rightmost column
+ * @param[in]	  border Character to use for the border
+ */
+static void border_row(RenderLayer* layer, int level, int y, int left, int right, char border) {
+	int col = left;
+	while (col <= right) {
+		int run;
+		char* cell = cell_at(layer, level, col, y, 1, &run);
+		if (run > right - col + 1) {
+			run = right - col + 1;
+		}
+		if (cell != NULL) {
+			Cells_border(cell, border, run);
+		}
+		col += run;
+	}
+}
+
+/**
+ * Copies cells into a row, NULs included. Empty tiles stay unallocated
+ * while only NULs are copied into them.
+ *
+ * @param[in,out] layer	Layer to update
+ * @param[in]	  level	Overlay doing the drawing, BASE_LEVEL for sections
+ * @param[in]	  x		First column
+ * @param[in]	  y		Row
+ * @param[in]	  text	Cells to copy
+ * @param[in]	  len	Number of cells
+ */
+static void copy_row(RenderLayer* layer, int level, int x, int y, char const* text, int len) {
+	while (len > 0) {
+		int run;
+		char* cell = cell_at(layer, level, x, y, 0, &run);
+		if (run > len) {
+			run = len;
+		}
+		if (cell == NULL) {
+			for (int i = 0; i < run; i++) {
+				if (text[i] != '\0') {
+					cell = cell_for_write(layer, x, y);
+					break;
+				}
+			}
+		}
+		if (cell != NULL) {
+			memcpy(cell, text, run);
+		}
+		x += run;
+		text += run;
+		len -= run;
+	}
+}
+
+/**
+ * Initialize a single section.
+ *
+ * @param[out] section Section to be initialized
+ */
+static void init_section(RenderSection* section) {
+	section->key[0] = '\0';
+}
+
+/**
+ * Sets a single cell.
+ *
+ * @param[in,out] layer Layer to update
+ * @param[in]	  level	Overlay doing the drawing, BASE_LEVEL for sections
+ * @param[in]	  x		Column
+ * @param[in]	  y		Row
+ * @param[in]	  c		Character to draw
+ */
+static inline void set_cell(RenderLayer* layer, int level, int x, int y, char c) {
+	int run;
+	char* loc = cell_at(layer, level, x, y, 1, &run);
+	if (loc != NULL) {
+		*loc = c;
+	}
+}
+
+/**
+ * Draws a border if the location isn't already a corner for another section.
+ *
+ * @param[in,out] layer	 Layer to update
+ * @param[in]	  level	 Overlay doing the drawing, BASE_LEVEL for sections
+ * @param[in]	  x		 Column
+ * @param[in]	  y		 Row
+ * @param[in]	  border Character to use for the border
+ */
+static inline void coalesce_outline(RenderLayer* layer, int level, int x, int y, char border) {
+	int run;
+	char* loc = cell_at(layer, level, x, y, 1, &run);
+	if (loc != NULL && *loc != '+') {
+		*loc = border;
+	}
+}
+
+/**
+ * Draws the part of a blank section that falls inside a clip rectangle.
+ *
+ * @param[in,out] layer		Layer where section is drawn
+ * @param[in]	  leftEdge	Leftmost column (lowest x)
+ * @param[in]	  topEdge	Topmost row (lowest y)
+ * @param[in]	  rightEdge	Rightmost column (highest x)
+ * @param[in]	  botEdge	Bottom-most row (highest y)
+ * @param[in]	  clip		Cells that may be drawn, as {left, top, right, bottom}
+ */
+static void draw_clipped_section(RenderLayer* layer, int leftEdge, int topEdge, int rightEdge, int botEdge, int const clip[4]) {
+	int top = (topEdge > clip[1]) ? topEdge : clip[1];
+	int bot = (botEdge < clip[3]) ? botEdge : clip[3];
+	int left = (leftEdge + 1 > clip[0]) ? leftEdge + 1 : clip[0];
+	int right = (rightEdge - 1 < clip[2]) ? rightEdge - 1 : clip[2];
+	int hasLeft = (leftEdge >= clip[0] && leftEdge <= clip[2]);
+	int hasRight = (rightEdge >= clip[0] && rightEdge <= clip[2]);
+
+	for (int row = top; row <= bot; row++) {
+		if (row == topEdge || row == botEdge) {
+			if (hasLeft) { set_cell(layer, BASE_LEVEL, leftEdge, row, '+'); }
+			if (hasRight) { set_cell(layer, BASE_LEVEL, rightEdge, row, '+'); }
+			if (left <= right) {
+				border_row(layer, BASE_LEVEL, row, left, right, '-');
+			}
+		} else {
+			if (hasLeft) { coalesce_outline(layer, BASE_LEVEL, leftEdge, row, '|'); }
+			if (hasRight) { coalesce_outline(layer, BASE_LEVEL, rightEdge, row, '|'); }
+			if (left <= right) {
+				fill_row(layer, BASE_LEVEL, row, left, right, ' ');
+			}
+		}
+	}
+}
+
+/**
+ * Draws a blank section.
+ *
+ * @param[in,out] layer		Layer where section is drawn
+ * @param[in]	  level		Overlay being drawn, BASE_LEVEL for sections
+ * @param[in]	  leftEdge	Leftmost column (lowest x)
+ * @param[in]	  topEdge	Topmost row (lowest y)
+ * @param[in]	  rightEdge	Rightmost column (highest x)
+ * @param[in]	  botEdge	Bottom-most row (highest y)
+ */
+static void draw_blank_section(RenderLayer* layer, int level, int leftEdge, int topEdge, int rightEdge, int botEdge) {
+	set_cell(layer, level, leftEdge, topEdge, '+');
+	set_cell(layer, level, rightEdge, topEdge, '+');
+	set_cell(layer, level, leftEdge, botEdge, '+');
+	set_cell(layer, level, rightEdge, botEdge, '+');
+
+	for (int row = topEdge + 1; row < botEdge; row++) {
+		coalesce_outline(layer, level, leftEdge, row, '|');
+		coalesce_outline(layer, level, rightEdge, row, '|');
+		if (rightEdge - leftEdge > 1) {
+			fill_row(layer, level, row, leftEdge + 1, rightEdge - 1, ' ');
+		}
+	}
+	if (rightEdge - leftEdge > 1) {
+		border_row(layer, level, topEdge, leftEdge + 1, rightEdge - 1, '-');
+		border_row(layer, level, botEdge, leftEdge + 1, rightEdge - 1, '-');
+	}
+}
+
+/**
+ * Clears a region and redraws every section outline that touches it.
+ * Cells under open overlays are redrawn into their save-under.
+ *
+ * @param[in,out] layer		Layer to update
+ * @param[in]	  leftEdge	Leftmost column (lowest x)
+ * @param[in]	  topEdge	Topmost row (lowest y)
+ * @param[in]	  rightEdge	Rightmost column (highest x)
+ * @param[in]	  botEdge	Bottom-most row (highest y)
+ */
+static void redraw_region(RenderLayer* layer, int leftEdge, int topEdge, int rightEdge, int botEdge) {
+	int const clip[4] = { leftEdge, topEdge, rightEdge, botEdge };
+
+	for (int row = topEdge; row <= botEdge; row++) {
+		fill_row(layer, BASE_LEVEL, row, leftEdge, rightEdge, '\0');
+	}
+	for (int i = 0; i < SECTIONS_PER_LAYER && layer->sections[i].key[0] != '\0'; i++) {
+		RenderSection* section = &layer->sections[i];
+		int left = section->xAnchor - 1;
+		int top = section->yAnchor - 1;
+		int right = section->xAnchor + section->xDim;
+		int bot = section->yAnchor + section->yDim;
+		if (left > rightEdge || right < leftEdge || top > botEdge || bot < topEdge) {
+			continue;
+		}
+		draw_clipped_section(layer, left, top, right, bot, clip);
+	}
+}
+
+/**
+ * Moves the left-most edge of a section's rows out to the section.
+ *
+ * @param[in,out] layer	  Layer to update
+ * @param[in]	  section Section, outline included
+ */
+static void extend_left_edges(RenderLayer* layer, RenderSection const* section) {
+	int left = section->xAnchor - 1;
+	for (int row = section->yAnchor - 1; row <= section->yAnchor + section->yDim; row++) {
+		if (layer->leftEdge[row] < 0 || left < layer->leftEdge[row]) {
+			layer->leftEdge[row] = left;
+		}
+	}
+}
+
+/**
+ * Recomputes the left-most edge of every row.
+ *
+ * @param[in,out] layer Layer to update
+ */
+static void update_left_edges(RenderLayer* layer) {
+	memset(layer->leftEdge, -1, MAX_SCREEN_HEIGHT * sizeof(layer->leftEdge[0]));
+	for (int i = 0; i < SECTIONS_PER_LAYER && layer->sections[i].key[0] != '\0'; i++) {
+		extend_left_edges(layer, &layer->sections[i]);
+	}
+	for (int i = 0; i < layer->numOverlays; i++) {
+		extend_left_edges(layer, &layer->overlays[i].section);
+	}
+}
+
+/**
+ * Finds the drawing level of a section.
+ *
+ * @param[in] layer	  Layer containing the section
+ * @param[in] section Section found with Layer_getSection()
+ *
+ * @returns Overlay index, or BASE_LEVEL for the layer's own sections
+ */
+static int level_of(RenderLayer const* layer, RenderSection const* section) {
+	for (int i = 0; i < layer->numOverlays; i++) {
+		if (section == &layer->overlays[i].section) {
+			return i;
+		}
+	}
+	return BASE_LEVEL;
+}
+
+/**
+ * Discards every open overlay without restoring what it covers.
+ *
+ * @param[in,out] layer Layer to update
+ */
+static void drop_overlays(RenderLayer* layer) {
+	for (int i = 0; i < layer->numOverlays; i++) {
+		free(layer->overlays[i].saveUnder);
+		layer->overlays[i].saveUnder = NULL;
+	}
+	layer->numOverlays = 0;
+}
+
+/**
+ * Initialize a single layer.
+ * Tiles and overlays it still holds are released, so the layer must be
+ * zeroed or initialized before.
+ *
+ * @param[in,out] layer Layer to be initialized
+ */
+void Layer_init(RenderLayer* layer) {
+	release_tiles(layer->tiles);
+	drop_overlays(layer);
+	layer->version = 0;
+	memset(layer->rowVersion, 0, MAX_SCREEN_HEIGHT * sizeof(layer->rowVersion[0]));
+	memset(layer->hasGlyphs, 0, MAX_SCREEN_HEIGHT * sizeof(layer->hasGlyphs[0]));
+	memset(layer->leftEdge, -1, MAX_SCREEN_HEIGHT * sizeof(layer->leftEdge[0]));
+	for (int i = 0; i < SECTIONS_PER_LAYER; i++) {
+		init_section(&layer->sections[i]);
+	}
+}
+
+/**
+ * Replaces a layer with a compiled layout, closing any open overlays.
+ * The layout's tiles are shared, not copied.
+ * The version keeps counting up, so earlier references see every row as changed.
+ *
+ * @param[out] layer  Layer to be replaced
+ * @param[in]  layout Compiled layout
+ */
+void Layer_install(RenderLayer* layer, RenderLayout const* layout) {
+	uint32_t version = layer->version;
+	release_tiles(layer->tiles);
+	drop_overlays(layer);
+	memcpy(layer, &layout->layer, sizeof(RenderLayer));
+	layer->version = version;
+	Layer_touch(layer, 0, MAX_SCREEN_HEIGHT - 1);
+}
+
+/**
+ * Records a change to some rows of the artwork.
+ *
+ * @param[in,out] layer	  Layer that changed
+ * @param[in]	  topEdge Topmost changed row (lowest y)
+ * @param[in]	  botEdge Bottom-most changed row (highest y)
+ */
+void Layer_touch(RenderLayer* layer, int topEdge, int botEdge) {
+	layer->version++;
+	for (int row = topEdge; row <= botEdge; row++) {
+		layer->rowVersion[row] = layer->version;
+	}
+}
+
+/**
+ * Adds a section to a layer and draws its outline.
+ *
+ * @param[in,out] layer   Layer that should contain the new section
+ * @param[in]	  section Section to be added
+ *
+ * @returns Stored section, or NULL if it does not fit or the layer is full
+ */
+RenderSection* Layer_addSection(RenderLayer* layer, RenderSection const* section) {
+	int idx;
+	int leftEdge = section->xAnchor - 1;
+	int topEdge = section->yAnchor - 1;
+	int rightEdge = section->xAnchor + section->xDim;
+	int botEdge = section->yAnchor + section->yDim;
+	if (leftEdge < 0 || topEdge < 0 || rightEdge >= MAX_SCREEN_WIDTH || botEdge >= MAX_SCREEN_HEIGHT) {
+		return NULL;
+	}
+
+	for (idx = 0; idx < SECTIONS_PER_LAYER; idx++) {
+		if (layer->sections[idx].key[0] == '\0') {
+			break;
+		}
+	}
+	if (idx == SECTIONS_PER_LAYER) {
+		return NULL; // no free sections
+	}
+
+	memcpy(&layer->sections[idx], section, sizeof(RenderSection));
+	extend_left_edges(layer, section);
+
+	draw_blank_section(layer, BASE_LEVEL, leftEdge, topEdge, rightEdge, botEdge);
+	Layer_touch(layer, topEdge, botEdge);
+	return &layer->sections[idx];
+}
+
+/**
+ * Looks up a section by its key, open overlays included.
+ *
+ * @param[in] layer		 Layer to search
+ * @param[in] sectionKey Section key to find
+ *
+ * @returns Pointer to section, or NULL on failure
+ */
+RenderSection* Layer_getSection(RenderLayer* layer, char const* sectionKey) {
+	RenderSection* ret = NULL;
+	for (int i = 0; i < SECTIONS_PER_LAYER; i++) {
+		if (layer->sections[i].key[0] == '\0') { break; }
+		if (!strncmp(layer->sections[i].key, sectionKey, PAINTER_KEY_LEN)) {
+			ret = &layer->sections[i];
+			break;
+		}
+	}
+	for (int i = layer->numOverlays - 1; i >= 0 && ret == NULL; i--) {
+		if (!strncmp(layer->overlays[i].section.key, sectionKey, PAINTER_KEY_LEN)) {
+			ret = &layer->overlays[i].section;
+		}
+	}
+	return ret;
+}
+
+/**
+ * Moves or resizes a section, redrawing only the cells it left and entered.
+ * The section's content is cleared. Overlays cannot be moved.
+ *
+ * @param[in,out] layer	   Layer containing the section
+ * @param[in]	  section  New configuration; the key selects the section
+ * @param[out]	  previous Configuration before the change
+ *
+ * @returns 0 on success, -1 if the section is unknown or does not fit
+ */
+int Layer_configSection(RenderLayer* layer, RenderSection const* section, RenderSection* previous) {
+	RenderSection* target = Layer_getSection(layer, section->key);
+	if (target == NULL || level_of(layer, target) != BASE_LEVEL || section->xAnchor < 1 || section->yAnchor < 1
+			|| section->xAnchor + section->xDim >= MAX_SCREEN_WIDTH
+			|| section->yAnchor + section->yDim >= MAX_SCREEN_HEIGHT) {
+		return -1;
+	}
+
+	memcpy(previous, target, sizeof(RenderSection));
+	target->xAnchor = section->xAnchor;
+	target->yAnchor = section->yAnchor;
+	target->xDim = section->xDim;
+	target->yDim = section->yDim;
+
+	redraw_region(layer, previous->xAnchor - 1, previous->yAnchor - 1,
+			previous->xAnchor + previous->xDim, previous->yAnchor + previous->yDim);
+	redraw_region(layer, target->xAnchor - 1, target->yAnchor - 1,
+			target->xAnchor + target->xDim, target->yAnchor + target->yDim);
+	Layer_touch(layer, previous->yAnchor - 1, previous->yAnchor + previous->yDim);
+	Layer_touch(layer, target->yAnchor - 1, target->yAnchor + target->yDim);
+	update_left_edges(layer);
+	return 0;
+}
+
+/**
+ * Reads a single cell.
+ *
+ * @param[in] layer Layer to read
+ * @param[in] x		Column
+ * @param[in] y		Row
+ *
+ * @returns Cell, NUL where nothing is drawn
+ */
+char Layer_cell(RenderLayer const* layer, int x, int y) {
+	LayerTile const* tile = layer->tiles[y / LAYER_TILE_HEIGHT][x / LAYER_TILE_WIDTH];
+	return (tile != NULL) ? tile->cells[y % LAYER_TILE_HEIGHT][x % LAYER_TILE_WIDTH] : '\0';
+}
+
+/**
+ * Finds the cells from a position to the end of its tile, without copying.
+ *
+ * @param[in]  layer Layer to read
+ * @param[in]  x	 Column
+ * @param[in]  y	 Row
+ * @param[out] len	 Cells up to the end of the tile or screen
+ *
+ * @returns Cells, or NULL if the tile is empty
+ */
+char const* Layer_span(RenderLayer const* layer, int x, int y, int* len) {
+	int tileEnd = (x / LAYER_TILE_WIDTH + 1) * LAYER_TILE_WIDTH;
+	*len = ((tileEnd < MAX_SCREEN_WIDTH) ? tileEnd : MAX_SCREEN_WIDTH) - x;
+
+	LayerTile const* tile = layer->tiles[y / LAYER_TILE_HEIGHT][x / LAYER_TILE_WIDTH];
+	return (tile != NULL) ? &tile->cells[y % LAYER_TILE_HEIGHT][x % LAYER_TILE_WIDTH] : NULL;
+}
+
+/**
+ * Copies a section's text into a row.
+ * Cells hidden by overlays opened above the section are kept for when
+ * they close instead of being drawn over the overlays.
+ *
+ * @param[in,out] layer	  Layer to update
+ * @param[in]	  section Section the text belongs to, from Layer_getSection()
+ * @param[in]	  x		  First column
+ * @param[in]	  y		  Row
+ * @param[in]	  text	  Text to copy
+ * @param[in]	  len	  Characters to copy, clipped at the screen edge
+ */
+void Layer_write(RenderLayer* layer, RenderSection const* section, int x, int y, char const* text, int len) {
+	if (x + len > MAX_SCREEN_WIDTH) {
+		len = MAX_SCREEN_WIDTH - x;
+	}
+	for (int i = 0; i < len && !layer->hasGlyphs[y]; i++) {
+		layer->hasGlyphs[y] = Glyph_isGlyph(text[i]);
+	}
+	copy_row(layer, level_of(layer, section), x, y, text, len);
+}
+
+/**
+ * Finds an open overlay by key.
+ *
+ * @returns Overlay level, or -1 if none is open with that key
+ */
+static int find_overlay(RenderLayer const* layer, char const* sectionKey) {
+	int level;
+	for (level = layer->numOverlays - 1; level >= 0; level--) {
+		if (!strncmp(layer->overlays[level].section.key, sectionKey, PAINTER_KEY_LEN)) {
+			break;
+		}
+	}
+	return level;
+}
+
+/**
+ * Opens an overlay above the layer's sections and earlier overlays.
+ * The cells it covers are saved first, so opening and closing cost only
+ * the overlay's area.
+ *
+ * @param[in,out] layer	  Layer to draw over
+ * @param[in]	  section Overlay section
+ *
+ * @returns Stored section, or NULL if it does not fit, one with the same
+ *			key is already open, too many overlays are open or memory is short
+ */
+RenderSection* Layer_openOverlay(RenderLayer* layer, RenderSection const* section) {
+	int leftEdge = section->xAnchor - 1;
+	int topEdge = section->yAnchor - 1;
+	int rightEdge = section->xAnchor + section->xDim;
+	int botEdge = section->yAnchor + section->yDim;
+	int width = section->xDim + 2;
+	if (leftEdge < 0 || topEdge < 0 || rightEdge >= MAX_SCREEN_WIDTH || botEdge >= MAX_SCREEN_HEIGHT
+			|| layer->numOverlays == OVERLAYS_PER_LAYER || find_overlay(layer, section->key) >= 0) {
+		return NULL;
+	}
+
+	RenderOverlay* overlay = &layer->overlays[layer->numOverlays];
+	overlay->saveUnder = malloc(width * (section->yDim + 2));
+	if (overlay->saveUnder == NULL) {
+		return NULL;
+	}
+	for (int row = topEdge; row <= botEdge; row++) {
+		char* save = &overlay->saveUnder[(row - topEdge) * width];
+		int col = leftEdge;
+		while (col <= rightEdge) {
+			int len;
+			char const* cells = Layer_span(layer, col, row, &len);
+			if (col + len - 1 > rightEdge) {
+				len = rightEdge - col + 1;
+			}
+			if (cells != NULL) {
+				memcpy(&save[col - leftEdge], cells, len);
+			} else {
+				memset(&save[col - leftEdge], '\0', len);
+			}
+			col += len;
+		}
+	}
+
+	memcpy(&overlay->section, section, sizeof(RenderSection));
+	draw_blank_section(layer, layer->numOverlays++, leftEdge, topEdge, rightEdge, botEdge);
+	extend_left_edges(layer, section);
+	Layer_touch(layer, topEdge, botEdge);
+	return &overlay->section;
+}
+
+/**
+ * Closes an overlay, putting back the cells it covered.
+ * Parts still covered by later overlays go to their save-under instead.
+ *
+ * @param[in,out] layer		 Layer containing the overlay
+ * @param[in]	  sectionKey Overlay key
+ * @param[out]	  closed	 Overlay section, giving the area to repaint
+ *
+ * @returns 0 on success, -1 if no such overlay is open
+ */
+int Layer_closeOverlay(RenderLayer* layer, char const* sectionKey, RenderSection* closed) {
+	int level = find_overlay(layer, sectionKey);
+	if (level < 0) {
+		return -1;
+	}
+
+	RenderOverlay* overlay = &layer->overlays[level];
+	memcpy(closed, &overlay->section, sizeof(RenderSection));
+	int width = closed->xDim + 2;
+	for (int row = 0; row < closed->yDim + 2; row++) {
+		copy_row(layer, level, closed->xAnchor - 1, closed->yAnchor - 1 + row, &overlay->saveUnder[row * width], width);
+	}
+
+	free(overlay->saveUnder);
+	memmove(overlay, overlay + 1, (layer->numOverlays - level - 1) * sizeof(RenderOverlay));
+	layer->numOverlays--;
+	update_left_edges(layer);
+	Layer_touch(layer, closed->yAnchor - 1, closed->yAnchor + closed->yDim);
+	return 0;
+}
+
+/**
+ * Copies a rectangle of one layer onto another at the same position.
+ * Empty source cells leave the destination as it was, and empty source
+ * tiles are skipped without being read.
+ *
+ * @param[in,out] dst		Layer to draw onto
+ * @param[in]	  src		Layer to copy from
+ * @param[in]	  leftEdge	Leftmost column (lowest x)
+ * @param[in]	  topEdge	Topmost row (lowest y)
+ * @param[in]	  rightEdge	Rightmost column (highest x)
+ * @param[in]	  botEdge	Bottom-most row (highest y)
+ */
+void Layer_blit(RenderLayer* dst, RenderLayer const* src, int leftEdge, int topEdge, int rightEdge, int botEdge) {
+	for (int row = topEdge; row <= botEdge; row++) {
+		int col = leftEdge;
+		while (col <= rightEdge) {
+			int len;
+			char const* cells = Layer_span(src, col, row, &len);
+			if (col + len - 1 > rightEdge) {
+				len = rightEdge - col + 1;
+			}
+			if (cells != NULL) {
+				char* cell = cell_for_write(dst, col, row);
+				if (cell != NULL) {
+					Cells_blit(cell, cells, len);
+				}
+			}
+			col += len;
+		}
+		dst->hasGlyphs[row] |= src->hasGlyphs[row];
+	}
+	Layer_touch(dst, topEdge, botEdge);
+}
+
+/**
+ * Takes a snapshot of a layer's artwork and sections in constant time.
+ * Overlays are not part of a snapshot, so none may be open.
+ *
+ * @param[in,out] layer	Layer, whose tiles become shared
+ * @param[out]	  snap	Snapshot, to be restored or dropped
+ *
+ * @returns 0 on success, -1 while overlays are open
+ */
+int Layer_snapshot(RenderLayer* layer, LayerSnapshot* snap) {
+	if (layer->numOverlays > 0) {
+		return -1;
+	}
+	memcpy(snap->leftEdge, layer->leftEdge, sizeof(snap->leftEdge));
+	memcpy(snap->hasGlyphs, layer->hasGlyphs, sizeof(snap->hasGlyphs));
+	memcpy(snap->sections, layer->sections, sizeof(snap->sections));
+	for (int ty = 0; ty < LAYER_TILES_Y; ty++) {
+		for (int tx = 0; tx < LAYER_TILES_X; tx++) {
+			snap->tiles[ty][tx] = share_tile(layer->tiles[ty][tx]);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Puts a layer back as it was in a snapshot, which is used up.
+ * Only the rows of tiles that differ are touched, so the presenter
+ * repaints just those.
+ *
+ * @param[in,out] layer	  Layer to restore
+ * @param[in,out] snap	  Snapshot, dropped on success
+ * @param[out]	  topEdge Topmost changed row
+ * @param[out]	  botEdge Bottom-most changed row, above @p topEdge if nothing changed
+ *
+ * @returns 0 on success, -1 while overlays are open
+ */
+int Layer_restore(RenderLayer* layer, LayerSnapshot* snap, int* topEdge, int* botEdge) {
+	if (layer->numOverlays > 0) {
+		return -1;
+	}
+	*topEdge = MAX_SCREEN_HEIGHT;
+	*botEdge = -1;
+	for (int ty = 0; ty < LAYER_TILES_Y; ty++) {
+		int changed = 0;
+		for (int tx = 0; tx < LAYER_TILES_X; tx++) {
+			if (layer->tiles[ty][tx] != snap->tiles[ty][tx]) {
+				release_tile(layer->tiles[ty][tx]);
+				layer->tiles[ty][tx] = snap->tiles[ty][tx];
+				changed = 1;
+			} else {
+				release_tile(snap->tiles[ty][tx]);
+			}
+			snap->tiles[ty][tx] = NULL;
+		}
+		if (changed) {
+			int top = ty * LAYER_TILE_HEIGHT;
+			int bot = top + LAYER_TILE_HEIGHT - 1;
+			if (bot >= MAX_SCREEN_HEIGHT) {
+				bot = MAX_SCREEN_HEIGHT - 1;
+			}
+			if (top < *topEdge) { *topEdge = top; }
+			*botEdge = bot;
+			Layer_touch(layer, top, bot);
+		}
+	}
+	memcpy(layer->leftEdge, snap->leftEdge, sizeof(layer->leftEdge));
+	memcpy(layer->sections, snap->sections, sizeof(layer->sections));
+	for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+		layer->hasGlyphs[row] |= snap->hasGlyphs[row];
+	}
+	return 0;
+}
+
+/**
+ * Drops a snapshot that will not be restored.
+ *
+ * @param[in,out] snap Snapshot
+ */
+void Layer_dropSnapshot(LayerSnapshot* snap) {
+	release_tiles(snap->tiles);
+}
+
+/**
+ * Hands on every cell a layer holds, including those set aside under
+ * its overlays, in no particular order.
+ *
+ * @param[in] layer Layer
+ * @param[in] visit Called for each block of cells
+ * @param[in] arg	Passed to @p visit
+ */
+void Layer_visitCells(RenderLayer const* layer, LayerCellsCb visit, void* arg) {
+	visit_tiles(layer->tiles, visit, arg);
+	for (int i = 0; i < layer->numOverlays; i++) {
+		RenderSection const* section = &layer->overlays[i].section;
+		visit(arg, layer->overlays[i].saveUnder, (size_t)(section->xDim + 2) * (section->yDim + 2));
+	}
+}
+
+/**
+ * Hands on every cell a snapshot holds.
+ *
+ * @param[in] snap	Snapshot
+ * @param[in] visit Called for each block of cells
+ * @param[in] arg	Passed to @p visit
+ */
+void Layer_visitSnapshot(LayerSnapshot const* snap, LayerCellsCb visit, void* arg) {
+	visit_tiles(snap->tiles, visit, arg);
+}
+
+/**
+ * @returns Bytes allocated for layer tiles across all layers
+ */
+size_t Layer_poolBytes(void) {
+	return l_poolBytes;
+}
@@ -0,0 +1,291 @@
+/**
+ * @file layout_solver.c
+ * Row/column layout solver.
+ *
+ * Containers split their extent between their children by weight, within
+ * each child's min/max bounds. Changes only mark the affected container
+ * dirty; solving re-distributes dirty containers and descends only into
+ * children whose rectangle changed, so an unchanged subtree costs nothing.
+ */
+
+#include <string.h>
+
+#include "layout_solver.h"
+
+/**
+ * Splits @p total inner cells between the children of a container.
+ *
+ * @param[in]  me	  Tree
+ * @param[in]  parent Container
+ * @param[in]  total  Inner cells available along the container's axis
+ * @param[out] sizes  Inner size of each child, in sibling order
+ */
+static void distribute(LayoutTree* me, LayoutNode const* parent, int total, int sizes[LAYOUT_MAX_NODES]) {
+	LayoutNode* children[LAYOUT_MAX_NODES];
+	uint8_t fixed[LAYOUT_MAX_NODES];
+	int n = 0;
+
+	for (int c = parent->firstChild; c != LAYOUT_NONE; c = me->nodes[c].nextSibling) {
+		children[n] = &me->nodes[c];
+		fixed[n] = 0;
+		n++;
+	}
+
+	int remaining = total;
+	for (;;) {
+		uint32_t sumWeights = 0;
+		int clamped = 0;
+		for (int i = 0; i < n; i++) {
+			if (!fixed[i]) { sumWeights += children[i]->weight; }
+		}
+		for (int i = 0; i < n; i++) {
+			if (fixed[i]) { continue; }
+			int share = (sumWeights && remaining > 0) ? (int)((uint32_t)remaining * children[i]->weight / sumWeights) : 0;
+			if (share < children[i]->minSize) {
+				sizes[i] = children[i]->minSize;
+			} else if (share > children[i]->maxSize) {
+				sizes[i] = children[i]->maxSize;
+			} else {
+				sizes[i] = share;
+				continue;
+			}
+			fixed[i] = 1;
+			clamped = 1;
+		}
+		if (!clamped) { break; }
+
+		remaining = total;
+		for (int i = 0; i < n; i++) {
+			if (fixed[i]) { remaining -= sizes[i]; }
+		}
+	}
+
+	// hand out rounding leftovers in sibling order
+	int used = 0;
+	for (int i = 0; i < n; i++) {
+		used += sizes[i];
+	}
+	for (int i = 0; i < n && used < total; i++) {
+		if (!fixed[i] && sizes[i] < children[i]->maxSize) {
+			sizes[i]++;
+			used++;
+		}
+	}
+}
+
+/**
+ * Re-solves a dirty container and every child subtree whose rectangle changed.
+ *
+ * @returns Number of leaves moved
+ */
+static int solve_node(LayoutTree* me, LayoutNode* node, LayoutMovedCb moved, void* arg) {
+	int sizes[LAYOUT_MAX_NODES];
+	int horizontal = (node->kind == LAYOUT_ROW);
+	int extent = horizontal ? node->rect.w : node->rect.h;
+	int numChildren = 0;
+	for (int c = node->firstChild; c != LAYOUT_NONE; c = me->nodes[c].nextSibling) {
+		numChildren++;
+	}
+
+	// outlines: one leading, then one after each child
+	distribute(me, node, extent - 1 - numChildren, sizes);
+	int pos = horizontal ? node->rect.x : node->rect.y;
+	int count = 0;
+	int i = 0;
+	for (int c = node->firstChild; c != LAYOUT_NONE; c = me->nodes[c].nextSibling, i++) {
+		LayoutNode* child = &me->nodes[c];
+		LayoutRect rect = node->rect;
+		if (horizontal) {
+			rect.x = pos;
+			rect.w = sizes[i] + 2;
+		} else {
+			rect.y = pos;
+			rect.h = sizes[i] + 2;
+		}
+		pos += sizes[i] + 1;
+
+		if (memcmp(&rect, &child->rect, sizeof(LayoutRect)) != 0) {
+			child->rect = rect;
+			if (child->kind == LAYOUT_LEAF) {
+				moved(child, arg);
+				count++;
+			} else {
+				child->dirty = 1;
+			}
+		}
+		if (child->kind != LAYOUT_LEAF && child->dirty) {
+			count += solve_node(me, child, moved, arg);
+		}
+	}
+	node->dirty = 0;
+	return count;
+}
+
+/**
+ * Finds dirty containers below a clean one.
+ *
+ * @returns Number of leaves moved
+ */
+static int visit(LayoutTree* me, LayoutNode* node, LayoutMovedCb moved, void* arg) {
+	if (node->dirty) {
+		return solve_node(me, node, moved, arg);
+	}
+	int count = 0;
+	for (int c = node->firstChild; c != LAYOUT_NONE; c = me->nodes[c].nextSibling) {
+		if (me->nodes[c].kind != LAYOUT_LEAF) {
+			count += visit(me, &me->nodes[c], moved, arg);
+		}
+	}
+	return count;
+}
+
+/**
+ * Creates an empty tree.
+ *
+ * @param[out] me		Tree
+ * @param[in]  rootKind	@ref LAYOUT_ROW or @ref LAYOUT_COLUMN
+ */
+void LayoutTree_init(LayoutTree* me, LayoutKind rootKind) {
+	memset(me, 0, sizeof(LayoutTree));
+	me->nodes[LAYOUT_ROOT].kind = rootKind;
+	me->nodes[LAYOUT_ROOT].parent = LAYOUT_NONE;
+	me->nodes[LAYOUT_ROOT].firstChild = LAYOUT_NONE;
+	me->nodes[LAYOUT_ROOT].nextSibling = LAYOUT_NONE;
+	me->nodes[LAYOUT_ROOT].maxSize = LAYOUT_UNBOUNDED;
+	me->numNodes = 1;
+}
+
+/**
+ * Appends a node to a container.
+ *
+ * @param[in,out] me	  Tree
+ * @param[in]	  parent  Container node
+ * @param[in]	  kind	  Node kind
+ * @param[in]	  key	  Section key for leaves, ignored for containers
+ * @param[in]	  weight  Share of free space relative to siblings
+ * @param[in]	  minSize Minimum inner size along the parent's axis
+ * @param[in]	  maxSize Maximum inner size, or @ref LAYOUT_UNBOUNDED
+ *
+ * @returns Node index, or @ref LAYOUT_NONE if the tree is full
+ */
+int LayoutTree_add(LayoutTree* me, int parent, LayoutKind kind, char const* key,
+		uint16_t weight, uint16_t minSize, uint16_t maxSize) {
+	if (me->numNodes == LAYOUT_MAX_NODES || me->nodes[parent].kind == LAYOUT_LEAF) {
+		return LAYOUT_NONE;
+	}
+	int idx = me->numNodes++;
+	LayoutNode* node = &me->nodes[idx];
+	memset(node, 0, sizeof(LayoutNode));
+	if (kind == LAYOUT_LEAF) {
+		strncpy(node->key, key, PAINTER_KEY_LEN);
+	}
+	node->kind = kind;
+	node->weight = weight;
+	node->minSize = minSize;
+	node->maxSize = maxSize;
+	node->parent = parent;
+	node->firstChild = LAYOUT_NONE;
+	node->nextSibling = LAYOUT_NONE;
+
+	int8_t* link = &me->nodes[parent].firstChild;
+	while (*link != LAYOUT_NONE) {
+		link = &me->nodes[*link].nextSibling;
+	}
+	*link = idx;
+	me->nodes[parent].dirty = 1;
+	return idx;
+}
+
+/**
+ * Changes a node's constraints, e.g. when its content needs more room.
+ *
+ * @param[in,out] me	  Tree
+ * @param[in]	  node	  Node index
+ * @param[in]	  weight  Share of free space relative to siblings
+ * @param[in]	  minSize Minimum inner size along the parent's axis
+ * @param[in]	  maxSize Maximum inner size, or @ref LAYOUT_UNBOUNDED
+ */
+void LayoutTree_setConstraints(LayoutTree* me, int node, uint16_t weight, uint16_t minSize, uint16_t maxSize) {
+	LayoutNode* n = &me->nodes[node];
+	if (n->weight == weight && n->minSize == minSize && n->maxSize == maxSize) {
+		return;
+	}
+	n->weight = weight;
+	n->minSize = minSize;
+	n->maxSize = maxSize;
+	if (n->parent != LAYOUT_NONE) {
+		me->nodes[n->parent].dirty = 1;
+	}
+}
+
+/**
+ * Sets the screen size the tree is solved against.
+ *
+ * @param[in,out] me	 Tree
+ * @param[in]	  width	 Columns
+ * @param[in]	  height Rows
+ */
+void LayoutTree_resize(LayoutTree* me, uint16_t width, uint16_t height) {
+	LayoutNode* root = &me->nodes[LAYOUT_ROOT];
+	if (root->rect.w == width && root->rect.h == height) {
+		return;
+	}
+	root->rect.x = 0;
+	root->rect.y = 0;
+	root->rect.w = width;
+	root->rect.h = height;
+	root->dirty = 1;
+}
+
+/**
+ * Re-solves the dirty parts of the tree.
+ *
+ * @param[in,out] me	Tree
+ * @param[in]	  moved	Called for each leaf whose rectangle changed
+ * @param[in]	  arg	Passed to @p moved
+ *
+ * @returns Number of leaves moved
+ */
+int LayoutTree_solve(LayoutTree* me, LayoutMovedCb moved, void* arg) {
+	return visit(me, &me->nodes[LAYOUT_ROOT], moved, arg);
+}
+
+/**
+ * Reports every leaf with its solved rectangle, whether it moved or not,
+ * e.g. to apply the layout again to sections restored from a snapshot.
+ * Nothing is reported before the tree is first solved.
+ *
+ * @param[in] me	Tree
+ * @param[in] moved	Called for each leaf
+ * @param[in] arg	Passed to @p moved
+ *
+ * @returns Number of leaves reported
+ */
+int LayoutTree_report(LayoutTree const* me, LayoutMovedCb moved, void* arg) {
+	int count = 0;
+	if (me->nodes[LAYOUT_ROOT].rect.w == 0 || me->nodes[LAYOUT_ROOT].dirty) {
+		return 0;
+	}
+	for (int i = 0; i < me->numNodes; i++) {
+		if (me->nodes[i].kind == LAYOUT_LEAF) {
+			moved(&me->nodes[i], arg);
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Converts a solved leaf to a section configuration.
+ *
+ * @param[in]  node	   Solved leaf
+ * @param[out] section Section configuration
+ */
+void LayoutNode_toSection(LayoutNode const* node, RenderSection* section) {
+	memset(section, 0, sizeof(RenderSection));
+	strncpy(section->key, node->key, PAINTER_KEY_LEN);
+	section->xAnchor = node->rect.x + 1;
+	section->yAnchor = node->rect.y + 1;
+	section->xDim = (node->rect.w > 2) ? node->rect.w - 2 : 0;
+	section->yDim = (node->rect.h > 2) ? node->rect.h - 2 : 0;
+}
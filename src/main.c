@@ -3,6 +3,8 @@
  * This is where the spell begins.
  */
 
+#include <locale.h>
+
 #include "main.h"
 
 Q_DEFINE_THIS_FILE
@@ -13,14 +15,25 @@ Q_DEFINE_THIS_FILE
  * Crash handler.
  */
 void Q_onAssert(char const * const module, int loc) {
-	endwin(); // clean up curses
+	Session_closeAll(); // clean up curses
 	fprintf(stderr, "Assertion failed in %s:%d", module, loc);
 	exit(-1);
 }
-//! @{
-void QF_onStartup(void) {}
-void QF_onCleanup(void) {}
-//! @}
+/**
+ * Starts the tickless clock, if enabled, and the metrics exporter.
+ */
+void QF_onStartup(void) {
+	Ticker_start();
+	Metrics_start();
+}
+/**
+ * Stops the tickless clock, if enabled, the metrics exporter and the file I/O backend.
+ */
+void QF_onCleanup(void) {
+	Ticker_stop();
+	Metrics_stop();
+	FileSystem_stop();
+}
 /**
  * Perform the QF clock tick processing.
  */
@@ -28,25 +41,51 @@ void QF_onClockTick(void) {
 	QF_TICK_X(0U, (void *)0);
 }
 
-static QF_MPOOL_EL(TinyEvt)  l_tinyPoolSto[128];	///< Tiny event pool
-static QF_MPOOL_EL(SmallEvt) l_smallPoolSto[64];	///< Small event pool
+/**
+ * Queue depth for objects that may receive a key from every session in one tick.
+ */
+#define SESSION_QUEUE_LEN (64 + MAX_SESSIONS)
+
+static QF_MPOOL_EL(TinyEvt)  l_tinyPoolSto[128 + 2 * MAX_SESSIONS];	///< Tiny event pool
+static QF_MPOOL_EL(SmallEvt) l_smallPoolSto[256];	///< Small event pool
 static QF_MPOOL_EL(MediumEvt) l_mediumPoolSto[32];	///< Medium event pool
 
-static QEvt const *l_engine_queueSto[64];			///< Engine event pool
-static QEvt const *l_renderArtist_queueSto[64];		///< RenderArtist event pool
+static QEvt const *l_engine_queueSto[SESSION_QUEUE_LEN];	///< Engine event pool
+static QEvt const *l_renderArtist_queueSto[RENDER_QUEUE_LEN];	///< RenderArtist event pool
 static QEvt const *l_screenPainter_queueSto[64];	///< ScreenPainter event pool
 static QEvt const *l_keyMonitor_queueSto[64];		///< KeyMonitor event pool
-static QEvt const *l_bindingHandler_queueSto[64];	///< BindingHandler event pool
+static QEvt const *l_bindingHandler_queueSto[SESSION_QUEUE_LEN];	///< BindingHandler event pool
+static QEvt const *l_fileSystem_queueSto[2 * FS_MAX_JOBS];	///< FileSystem event pool
 
 static QSubscrList l_subscrSto[MAX_SUBSCRIBE_SIG];	///< Subscription manager
 
 /**
  * Initializes framework and starts loop.
+ *
+ * @param[in] argc Number of arguments
+ * @param[in] argv Terminal devices to serve; the controlling terminal if none
  */
-int main() {
+int main(int argc, char* argv[]) {
 	clear_log();
+	setlocale(LC_ALL, ""); /* curses prints UTF-8 only under a UTF-8 locale */
+
+	// sessions
+	if (argc < 2) {
+		Session_add(NULL);
+	}
+	for (int i = 1; i < argc; i++) {
+		if (Session_add(argv[i]) < 0) {
+			fprintf(stderr, "Cannot serve %s\n", argv[i]);
+		}
+	}
 
+	Cells_init();
+	Glyph_init();
+	PaintArena_init();
 	QF_init(); /* initialize the framework */
+#if BSP_TICKLESS
+	QF_setTickRate(0U, 0); /* clock is driven by the Ticker instead */
+#endif
 
 	// constructors
 	Engine_ctor();
@@ -54,6 +93,7 @@ int main() {
 	ScreenPainter_ctor();
 	KeyMonitor_ctor();
 	BindingHandler_ctor();
+	FileSystem_ctor();
 
 	// pools
 	QF_poolInit(l_tinyPoolSto,
@@ -70,6 +110,11 @@ int main() {
 	QF_psInit(l_subscrSto, Q_DIM(l_subscrSto));
 
 	// starts
+	QACTIVE_START(AO_FileSystem,
+			AO_FILE_SYSTEM, /* priority */
+			l_fileSystem_queueSto, Q_DIM(l_fileSystem_queueSto),
+			(void *)0, 0U, /* no stack */
+			(QEvt *)0);    /* no initialization event */
 	QACTIVE_START(AO_KeyMonitor,
 			AO_KEY_MONITOR, /* priority */
 			l_keyMonitor_queueSto, Q_DIM(l_keyMonitor_queueSto),
@@ -98,6 +143,14 @@ int main() {
 			(void *)0, 0U, /* no stack */
 			(QEvt *)0);    /* no initialization event */
 
+	// queues sampled by the metrics exporter
+	Metrics_watchQueue(AO_Engine, "engine");
+	Metrics_watchQueue(AO_RenderArtist, "render_artist");
+	Metrics_watchQueue(AO_ScreenPainter, "screen_painter");
+	Metrics_watchQueue(AO_KeyMonitor, "key_monitor");
+	Metrics_watchQueue(AO_BindingHandler, "binding_handler");
+	Metrics_watchQueue(AO_FileSystem, "file_system");
+
 	return QF_run(); /* run the QF application */
 }
 /// @}
@@ -0,0 +1,313 @@
+/**
+ * @file metrics.c
+ * Operational metrics, exported in the Prometheus text format.
+ *
+ * Counters, gauges and histograms are updated with relaxed atomic adds:
+ * no locks, no allocation and no formatting on the paint path, so they
+ * stay on in every build. A separate thread rewrites the export file
+ * every METRICS_EXPORT_MS, replacing it atomically so a scraper never
+ * reads half a file. Queue depths are sampled by that thread, so they
+ * cost the active objects nothing.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "main.h"
+#include "qf_pkg.h"
+
+/**
+ * @struct MetricInfo
+ * Exported name and description of a metric.
+ */
+typedef struct {
+	char const* name;	///< Metric name
+	char const* help;	///< One-line description
+} MetricInfo;
+
+/**
+ * @struct WatchedQueue
+ * Active object whose event queue is sampled.
+ */
+typedef struct {
+	QActive const* ao;	///< Active object
+	char const* name;	///< Label value
+} WatchedQueue;
+
+static const MetricInfo l_counterInfo[METRIC_NUM_COUNTERS] = {
+	{ "ti_frames_presented_total", "Frames presented to terminals." },
+	{ "ti_cells_painted_total", "Cells handed to curses." },
+	{ "ti_export_bytes_total", "Bytes sent to frame viewers." },
+	{ "ti_paints_total", "Line paints drawn." },
+	{ "ti_paints_merged_total", "Line paints dropped because a queued paint covered them." },
+	{ "ti_paints_dropped_total", "Line paints lost because the paint arena or render backlog was full." },
+	{ "ti_blocks_painted_total", "Block paints handled." },
+	{ "ti_render_deferred_total", "Render requests held back until the renderer had room." },
+	{ "ti_render_dropped_total", "Section changes lost because the render backlog was full." },
+	{ "ti_glyphs_reclaimed_total", "Glyphs freed once no cell held them." },
+	{ "ti_glyphs_exhausted_total", "Times a session's glyph table was full of glyphs in use, so characters were shown as '?'." },
+};
+
+static const MetricInfo l_gaugeInfo[METRIC_NUM_GAUGES] = {
+	{ "ti_sections", "Sections across all sessions." },
+};
+
+static char const* const l_stageNames[METRIC_NUM_STAGES] = {
+	"engine", "render", "paint", "present", "input",
+};
+
+/**Quantiles exported for each stage.*/
+static const double l_quantiles[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+
+static uint64_t l_counters[METRIC_NUM_COUNTERS];		///< Counter values
+static int64_t l_gauges[METRIC_NUM_GAUGES];				///< Gauge values
+static MetricHistogram l_histograms[METRIC_NUM_STAGES];	///< Stage latencies
+static WatchedQueue l_queues[METRICS_MAX_QUEUES];		///< Sampled queues
+static int l_numQueues;									///< Number of sampled queues
+
+static pthread_t l_thread;					///< Exporter thread
+static volatile int l_running;				///< Cleared to stop the thread
+static int l_wakePipe[2] = { -1, -1 };		///< Self-pipe used by Metrics_stop()
+static char l_path[64];						///< Export file
+static char l_tmpPath[sizeof(l_path) + 4];	///< File written before the rename
+
+/**
+ * Finds the histogram bucket of a value.
+ * Values below 2^METRICS_SUB_BITS get a bucket each; above that, the
+ * exponent selects a group and the bits after the leading one select
+ * the bucket within it.
+ *
+ * @param[in] v Value
+ *
+ * @returns Bucket index
+ */
+static unsigned bucket_of(uint64_t v) {
+	if (v >> METRICS_MAX_BITS) {
+		v = ((uint64_t)1 << METRICS_MAX_BITS) - 1;
+	}
+	if (v < (1U << METRICS_SUB_BITS)) {
+		return (unsigned)v;
+	}
+	unsigned e = 63 - __builtin_clzll(v) - METRICS_SUB_BITS;
+	return (e << METRICS_SUB_BITS) + (unsigned)(v >> e);
+}
+
+/**
+ * Highest value that falls in a bucket.
+ *
+ * @param[in] idx Bucket index
+ *
+ * @returns Value
+ */
+static uint64_t bucket_top(unsigned idx) {
+	if (idx < (1U << METRICS_SUB_BITS)) {
+		return idx;
+	}
+	unsigned e = (idx >> METRICS_SUB_BITS) - 1;
+	uint64_t m = idx - (e << METRICS_SUB_BITS);
+	return ((m + 1) << e) - 1;
+}
+
+/**
+ * Writes the counters and gauges.
+ */
+static void write_scalars(FILE* f) {
+	for (int i = 0; i < METRIC_NUM_COUNTERS; i++) {
+		fprintf(f, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+				l_counterInfo[i].name, l_counterInfo[i].help, l_counterInfo[i].name, l_counterInfo[i].name,
+				(unsigned long long)__atomic_load_n(&l_counters[i], __ATOMIC_RELAXED));
+	}
+	for (int i = 0; i < METRIC_NUM_GAUGES; i++) {
+		fprintf(f, "# HELP %s %s\n# TYPE %s gauge\n%s %lld\n",
+				l_gaugeInfo[i].name, l_gaugeInfo[i].help, l_gaugeInfo[i].name, l_gaugeInfo[i].name,
+				(long long)__atomic_load_n(&l_gauges[i], __ATOMIC_RELAXED));
+	}
+}
+
+/**
+ * Samples and writes the depth of every watched queue.
+ */
+static void write_queues(FILE* f) {
+	unsigned depth[METRICS_MAX_QUEUES];
+	unsigned peak[METRICS_MAX_QUEUES];
+
+	QF_CRIT_STAT_
+	QF_CRIT_ENTRY_();
+	for (int i = 0; i < l_numQueues; i++) {
+		QEQueue const* q = &l_queues[i].ao->eQueue;
+		// the front event is held outside the ring, hence the extra slot
+		depth[i] = (q->frontEvt != (QEvt *)0) ? q->end + 1U - q->nFree : 0U;
+		peak[i] = q->end + 1U - q->nMin;
+	}
+	QF_CRIT_EXIT_();
+
+	fprintf(f, "# HELP ti_queue_depth Events waiting in an active object's queue.\n# TYPE ti_queue_depth gauge\n");
+	for (int i = 0; i < l_numQueues; i++) {
+		fprintf(f, "ti_queue_depth{ao=\"%s\"} %u\n", l_queues[i].name, depth[i]);
+	}
+	fprintf(f, "# HELP ti_queue_depth_max Most events ever waiting in an active object's queue.\n# TYPE ti_queue_depth_max gauge\n");
+	for (int i = 0; i < l_numQueues; i++) {
+		fprintf(f, "ti_queue_depth_max{ao=\"%s\"} %u\n", l_queues[i].name, peak[i]);
+	}
+}
+
+/**
+ * Writes every stage histogram as a summary with fixed quantiles.
+ * Buckets are read one at a time while they are being updated, so the
+ * quantiles are computed against the total of the copy, not the live one.
+ */
+static void write_stages(FILE* f) {
+	static uint64_t counts[METRICS_BUCKETS];
+
+	fprintf(f, "# HELP ti_stage_seconds Time spent handling one event, per pipeline stage.\n# TYPE ti_stage_seconds summary\n");
+	for (int s = 0; s < METRIC_NUM_STAGES; s++) {
+		MetricHistogram* h = &l_histograms[s];
+		uint64_t total = 0;
+		for (int i = 0; i < METRICS_BUCKETS; i++) {
+			counts[i] = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+			total += counts[i];
+		}
+
+		int idx = 0;
+		uint64_t seen = 0;
+		for (size_t q = 0; q < sizeof(l_quantiles) / sizeof(l_quantiles[0]); q++) {
+			uint64_t rank = (uint64_t)(l_quantiles[q] * total + 0.5);
+			if (rank == 0) { rank = 1; }
+			while (idx < METRICS_BUCKETS - 1 && seen + counts[idx] < rank) {
+				seen += counts[idx++];
+			}
+			fprintf(f, "ti_stage_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n", l_stageNames[s],
+					l_quantiles[q], total ? bucket_top(idx) / 1e9 : 0.0);
+		}
+		fprintf(f, "ti_stage_seconds_sum{stage=\"%s\"} %.9f\n", l_stageNames[s],
+				__atomic_load_n(&h->sum, __ATOMIC_RELAXED) / 1e9);
+		fprintf(f, "ti_stage_seconds_count{stage=\"%s\"} %llu\n", l_stageNames[s], (unsigned long long)total);
+	}
+}
+
+/**
+ * Rewrites the export file.
+ */
+static void export_file(void) {
+	FILE* f = fopen(l_tmpPath, "w");
+	if (f == NULL) {
+		return;
+	}
+	write_scalars(f);
+	write_queues(f);
+	write_stages(f);
+	if (fclose(f) == 0) {
+		rename(l_tmpPath, l_path);
+	} else {
+		unlink(l_tmpPath);
+	}
+}
+
+/**
+ * Exporter thread: exports on every interval until stopped.
+ */
+static void* exporter_thread(void* arg) {
+	struct pollfd wake = { l_wakePipe[0], POLLIN, 0 };
+	(void)arg; /* unused parameter */
+
+	while (l_running) {
+		if (poll(&wake, 1, METRICS_EXPORT_MS) < 0 && errno != EINTR) {
+			break;
+		}
+		if (l_running) {
+			export_file();
+		}
+	}
+	return (void *)0;
+}
+
+/**
+ * Adds to a counter.
+ *
+ * @param[in] counter Counter
+ * @param[in] n		  Amount
+ */
+void Metrics_count(MetricCounter counter, uint64_t n) {
+	__atomic_fetch_add(&l_counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/**
+ * Moves a gauge.
+ *
+ * @param[in] gauge Gauge
+ * @param[in] delta Change, negative to decrease
+ */
+void Metrics_adjust(MetricGauge gauge, int64_t delta) {
+	__atomic_fetch_add(&l_gauges[gauge], delta, __ATOMIC_RELAXED);
+}
+
+/**
+ * Records the time a stage spent on one event.
+ *
+ * @param[in] stage Pipeline stage
+ * @param[in] ns	Time in nanoseconds
+ */
+void Metrics_record(MetricStage stage, uint64_t ns) {
+	MetricHistogram* h = &l_histograms[stage];
+	__atomic_fetch_add(&h->buckets[bucket_of(ns)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->sum, ns, __ATOMIC_RELAXED);
+}
+
+/**
+ * Adds an active object whose queue depth is exported.
+ * Must be called before Metrics_start().
+ *
+ * @param[in] ao   Started active object
+ * @param[in] name Label value, e.g. "engine"
+ */
+void Metrics_watchQueue(QActive const* ao, char const* name) {
+	if (l_numQueues < METRICS_MAX_QUEUES) {
+		l_queues[l_numQueues].ao = ao;
+		l_queues[l_numQueues].name = name;
+		l_numQueues++;
+	}
+}
+
+/**
+ * Starts the exporter thread.
+ */
+void Metrics_start(void) {
+	snprintf(l_path, sizeof(l_path), METRICS_EXPORT_PATH, (int)getpid());
+	snprintf(l_tmpPath, sizeof(l_tmpPath), "%s.tmp", l_path);
+	if (pipe(l_wakePipe) != 0) {
+		return;
+	}
+	fcntl(l_wakePipe[0], F_SETFL, O_NONBLOCK);
+
+	l_running = 1;
+	if (pthread_create(&l_thread, (pthread_attr_t *)0, &exporter_thread, (void *)0) != 0) {
+		l_running = 0;
+	}
+}
+
+/**
+ * Stops the exporter thread and removes the export file, so a scraper
+ * does not keep reporting a process that is gone.
+ */
+void Metrics_stop(void) {
+	if (l_running) {
+		char c = 0;
+		l_running = 0;
+		if (write(l_wakePipe[1], &c, 1) < 0) {
+			// pipe full, the thread is already awake
+		}
+		pthread_join(l_thread, (void **)0);
+		unlink(l_path);
+	}
+	if (l_wakePipe[0] >= 0) {
+		close(l_wakePipe[0]);
+		close(l_wakePipe[1]);
+		l_wakePipe[0] = l_wakePipe[1] = -1;
+	}
+}
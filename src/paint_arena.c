@@ -0,0 +1,146 @@
+/**
+ * @file paint_arena.c
+ * Reference-counted slab for paint payloads.
+ *
+ * Payloads are carved from fixed-size blocks in power-of-two size classes,
+ * so a short key echo costs a 16-byte block rather than a full canvas.
+ * When a class runs out, the next larger one is used. Events carry only
+ * a PaintRef and a length; the receiving object releases the reference
+ * once it has consumed the text, or hands its reference on.
+ *
+ * All active objects run in the same thread under the posix-qv port,
+ * so the arena needs no locking.
+ */
+
+#include <string.h>
+
+#include "paint_arena.h"
+
+/**Number of size classes.*/
+#define NUM_CLASSES 6
+
+static const uint16_t l_classSize[NUM_CLASSES]  = {  16,  32, 64, 128, 256, PAINT_ARENA_MAX_LEN };	///< Block size per class
+static const uint16_t l_classCount[NUM_CLASSES] = { 512, 256, 96,  32,  16,   8 };	///< Blocks per class
+
+/**Total number of blocks.*/
+#define NUM_BLOCKS (512 + 256 + 96 + 32 + 16 + 8)
+/**Total bytes of payload storage.*/
+#define NUM_BYTES (512 * 16 + 256 * 32 + 96 * 64 + 32 * 128 + 16 * 256 + 8 * PAINT_ARENA_MAX_LEN)
+
+static char		l_storage[NUM_BYTES];			///< Payload storage, class by class
+static uint32_t	l_offset[NUM_BLOCKS];			///< Storage offset of each block
+static uint8_t	l_refs[NUM_BLOCKS];				///< Reference count of each block
+static uint16_t	l_free[NUM_BLOCKS];				///< Free-list stacks, class by class
+static uint16_t	l_firstBlock[NUM_CLASSES + 1];	///< First block of each class
+static uint16_t	l_numFree[NUM_CLASSES];			///< Free blocks per class
+static uint32_t	l_inUse;						///< Blocks currently allocated
+
+/**
+ * Finds the class a block belongs to.
+ */
+static int class_of(PaintRef ref) {
+	int c = 0;
+	while (ref >= l_firstBlock[c + 1]) {
+		c++;
+	}
+	return c;
+}
+
+/**
+ * Sets up the size classes. Must be called before any other function.
+ */
+void PaintArena_init(void) {
+	uint32_t offset = 0;
+	uint16_t block = 0;
+
+	for (int c = 0; c < NUM_CLASSES; c++) {
+		l_firstBlock[c] = block;
+		l_numFree[c] = l_classCount[c];
+		for (int i = 0; i < l_classCount[c]; i++, block++) {
+			l_offset[block] = offset;
+			l_refs[block] = 0;
+			// stack top at the end, so low blocks are handed out first
+			l_free[l_firstBlock[c] + l_classCount[c] - 1 - i] = block;
+			offset += l_classSize[c];
+		}
+	}
+	l_firstBlock[NUM_CLASSES] = block;
+	l_inUse = 0;
+}
+
+/**
+ * Allocates a payload with one reference.
+ *
+ * @param[in] len Payload size in bytes
+ *
+ * @returns Handle, or @ref PAINT_REF_NONE if the arena is exhausted
+ */
+PaintRef PaintArena_alloc(uint16_t len) {
+	for (int c = 0; c < NUM_CLASSES; c++) {
+		if (len > l_classSize[c] || l_numFree[c] == 0) { continue; }
+		PaintRef ref = l_free[l_firstBlock[c] + --l_numFree[c]];
+		l_refs[ref] = 1;
+		l_inUse++;
+		return ref;
+	}
+	return PAINT_REF_NONE;
+}
+
+/**
+ * Allocates a payload holding a copy of some text.
+ *
+ * @param[in] text Text to copy
+ * @param[in] len  Bytes to copy
+ *
+ * @returns Handle, or @ref PAINT_REF_NONE if the arena is exhausted
+ */
+PaintRef PaintArena_copy(char const* text, uint16_t len) {
+	PaintRef ref = PaintArena_alloc(len);
+	if (ref != PAINT_REF_NONE) {
+		memcpy(PaintArena_data(ref), text, len);
+	}
+	return ref;
+}
+
+/**
+ * @param[in] ref Handle
+ *
+ * @returns Payload bytes
+ */
+char* PaintArena_data(PaintRef ref) {
+	return &l_storage[l_offset[ref]];
+}
+
+/**
+ * Adds a reference, e.g. before handing a payload to a second receiver.
+ *
+ * @param[in] ref Handle
+ */
+void PaintArena_retain(PaintRef ref) {
+	if (ref != PAINT_REF_NONE) {
+		l_refs[ref]++;
+	}
+}
+
+/**
+ * Drops a reference; the block is reused once none are left.
+ *
+ * @param[in] ref Handle
+ */
+void PaintArena_release(PaintRef ref) {
+	if (ref == PAINT_REF_NONE || l_refs[ref] == 0) {
+		return;
+	}
+	if (--l_refs[ref] == 0) {
+		int c = class_of(ref);
+		l_free[l_firstBlock[c] + l_numFree[c]++] = ref;
+		l_inUse--;
+	}
+}
+
+/**
+ * @returns Number of payloads currently allocated
+ */
+uint32_t PaintArena_inUse(void) {
+	return l_inUse;
+}
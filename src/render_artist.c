@@ -3,9 +3,12 @@
  * RenderArtist, toot toot.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <string.h>
 
 #include "main.h"
+#include "qf_pkg.h"
 
 static QState RenderArtist_initial(RenderArtist * const me, QEvt const * const e);
 static QState Idle(RenderArtist * const me, QEvt const * const e);
@@ -18,20 +21,27 @@ static QState Idle(RenderArtist * const me, QEvt const * const e);
 ////////////////////////////////////
 
 /**
- * Paints a single line to the screen.
+ * Paints a rectangle of a layer to the screen in a single event.
+ * The event references the layer; nothing is copied until it is painted.
  *
- * @ref PAINT_LINE_SIG, @ref AOScreenPainter
+ * @ref PAINT_BLOCK_SIG, @ref AOScreenPainter
  *
- * @param[in] yAnchor Vertical anchor (from top)
- * @param[in] xAnchor Horizontal anchor (from left)
- * @param[in] artwork String to draw
+ * @param[in] session	Session ID
+ * @param[in] layer		Layer to paint from
+ * @param[in] leftEdge	Leftmost column (lowest x)
+ * @param[in] topEdge	Topmost row (lowest y)
+ * @param[in] rightEdge	Rightmost column (highest x)
+ * @param[in] botEdge	Bottom-most row (highest y)
  */
-static void post_PAINT_LINE(uint16_t yAnchor, uint16_t xAnchor, char* artwork) {
-	PaintEvt* e = Q_NEW(PaintEvt, PAINT_LINE_SIG);
+static void post_PAINT_BLOCK(uint16_t session, RenderLayer const* layer, int leftEdge, int topEdge, int rightEdge, int botEdge) {
+	BlockEvt* e = Q_NEW(BlockEvt, PAINT_BLOCK_SIG);
 	if (e) {
-		e->yAnchor = yAnchor;
-		e->xAnchor = xAnchor;
-		strncpy(e->canvas, artwork, MAX_SCREEN_WIDTH);
+		e->session = session;
+		e->xAnchor = leftEdge;
+		e->yAnchor = topEdge;
+		e->width = rightEdge - leftEdge + 1;
+		e->height = botEdge - topEdge + 1;
+		e->version = layer->version;
 		QACTIVE_POST(AO_ScreenPainter, (QEvt *)e, AO_RenderArtist);
 	}
 }
@@ -40,155 +50,603 @@ static void post_PAINT_LINE(uint16_t yAnchor, uint16_t xAnchor, char* artwork) {
  * Refreshes the screen.
  *
  * @ref REFRESH_SCREEN_SIG, @ref AOScreenPainter
+ *
+ * @param[in] session Session ID
  */
-static void post_REFRESH_SCREEN() {
-	QEvt* e = Q_NEW(QEvt, REFRESH_SCREEN_SIG);
+static void post_REFRESH_SCREEN(uint16_t session) {
+	SessionEvt* e = Q_NEW(SessionEvt, REFRESH_SCREEN_SIG);
 	if (e) {
-		QACTIVE_POST(AO_ScreenPainter, e, AO_RenderArtist);
+		e->session = session;
+		QACTIVE_POST(AO_ScreenPainter, (QEvt *)e, AO_RenderArtist);
 	}
 }
 
-/// @}
-/////////////////////////////////////////
+/**
+ * Wakes the engine to collect returned credits.
+ *
+ * @ref RENDER_CREDIT_SIG, @ref AOEngine
+ */
+static void post_RENDER_CREDIT(void) {
+	QEvt* e = Q_NEW(QEvt, RENDER_CREDIT_SIG);
+	if (e) {
+		QACTIVE_POST(AO_Engine, e, AO_RenderArtist);
+	}
+}
 
 /**
- * Initialize a single section.
+ * Continues the pending repaints once every other object has run. The
+ * step goes by way of the engine, which ranks lowest and hands it back.
  *
- * @param[out] section Section to be initialized
+ * @ref RENDER_STEP_SIG, @ref AOEngine
  */
-static void init_section(RenderSection* section) {
-	section->key[0] = '\0';
+static void post_RENDER_STEP(void) {
+	QEvt* e = Q_NEW(QEvt, RENDER_STEP_SIG);
+	if (e) {
+		QACTIVE_POST(AO_Engine, e, AO_RenderArtist);
+	}
 }
 
 /**
- * Initialize a single layer.
+ * Continues the background work of widgets once every other object has
+ * run, by way of the engine like @ref RENDER_STEP_SIG. At most one step
+ * is queued at a time.
+ *
+ * @ref VIEW_STEP_SIG, @ref AOEngine
  *
- * @param[out] layer Layer to be initialized
+ * @param[in,out] me RenderArtist
  */
-static void init_layer(RenderLayer* layer) {
-	memset(layer->artwork, '\0', MAX_SCREEN_HEIGHT * MAX_SCREEN_WIDTH * sizeof(layer->artwork[0][0]));
-	memset(layer->leftEdge, -1, MAX_SCREEN_HEIGHT * sizeof(layer->leftEdge[0]));
-	for (int i = 0; i < SECTIONS_PER_LAYER; i++) {
-		init_section(&layer->sections[i]);
+static void post_VIEW_STEP(RenderArtist* me) {
+	if (me->viewStepPosted) { return; }
+	QEvt* e = Q_NEW(QEvt, VIEW_STEP_SIG);
+	if (e) {
+		me->viewStepPosted = 1;
+		QACTIVE_POST(AO_Engine, e, AO_RenderArtist);
 	}
 }
 
+/// @}
+/////////////////////////////////////////
+
+/**
+ * Checks whether a signal is a request posted with a credit.
+ * Everything in the queue but RenderArtist's own steps is.
+ */
+static int takes_credit(QSignal sig) {
+	return sig >= INSTALL_LAYOUT_SIG && sig <= VIEW_INPUT_SIG && sig != RENDER_STEP_SIG;
+}
+
 /**
- * Draws a border if the location isn't already a corner for another section.
+ * Returns the credit of a request taken off the queue. The engine is
+ * woken unless a wake-up is already on its way, in which case it collects
+ * this credit along with the earlier ones. The engine therefore never
+ * holds more than one @ref RENDER_CREDIT_SIG however fast requests drain.
  *
- * @param[in,out] loc	 Location to put border
- * @param[in]	  border Character to use for the border
+ * @param[in,out] me RenderArtist
  */
-static inline void coalesce_outline(char* loc, char border) {
-	if (*loc != '+') {
-		*loc = border;
+static void repay_credit(RenderArtist* me) {
+	__atomic_fetch_add(&me->returned, 1, __ATOMIC_SEQ_CST);
+	if (!__atomic_exchange_n(&me->creditPosted, 1, __ATOMIC_SEQ_CST)) {
+		post_RENDER_CREDIT();
 	}
 }
 
 /**
- * Draws a blank section.
+ * Queues a rectangle to be repainted in slices.
+ * If too many repaints are pending, the rectangle is painted in one go.
  *
- * @param[in,out] layer		Layer where section is drawn
+ * @param[in,out] me		RenderArtist
+ * @param[in]	  session	Session ID
+ * @param[in]	  layer		Layer to paint from
  * @param[in]	  leftEdge	Leftmost column (lowest x)
  * @param[in]	  topEdge	Topmost row (lowest y)
  * @param[in]	  rightEdge	Rightmost column (highest x)
  * @param[in]	  botEdge	Bottom-most row (highest y)
+ * @param[in]	  refresh	Refresh the screen once the rectangle is done
+ */
+static void queue_repaint(RenderArtist* me, uint16_t session, RenderLayer const* layer,
+		int leftEdge, int topEdge, int rightEdge, int botEdge, int refresh) {
+	if (me->numJobs == RENDER_MAX_JOBS) {
+		post_PAINT_BLOCK(session, layer, leftEdge, topEdge, rightEdge, botEdge);
+		if (refresh) { post_REFRESH_SCREEN(session); }
+		return;
+	}
+
+	RenderJob* job = &me->jobs[(me->firstJob + me->numJobs) % RENDER_MAX_JOBS];
+	job->session = session;
+	job->leftEdge = leftEdge;
+	job->topEdge = topEdge;
+	job->rightEdge = rightEdge;
+	job->botEdge = botEdge;
+	job->refresh = refresh;
+	if (me->numJobs++ == 0) {
+		post_RENDER_STEP();
+	}
+}
+
+/**
+ * Repaints one slice of the oldest pending rectangle.
+ * The next slice is asked for through the engine, so each slice is
+ * painted, and keys that reached the engine meanwhile are handled, before
+ * the next one is cut. Slices are sized from the painter's measured cost per cell so each
+ * takes about @ref RENDER_SLICE_NS to paint.
+ *
+ * @param[in,out] me RenderArtist
+ */
+static void render_step(RenderArtist* me) {
+	RenderJob* job = &me->jobs[me->firstJob];
+	Session* s = Session_get(job->session);
+	int done = 1;
+
+	if (s != NULL) {
+		uint64_t start = Session_clock();
+		int width = job->rightEdge - job->leftEdge + 1;
+		int rows = RENDER_SLICE_NS / ScreenPainter_cellCost() / width;
+		if (rows < 1) { rows = 1; }
+		int botEdge = job->topEdge + rows - 1;
+		if (botEdge >= job->botEdge) {
+			botEdge = job->botEdge;
+		} else {
+			done = 0;
+		}
+
+		post_PAINT_BLOCK(s->id, &s->layers[0], job->leftEdge, job->topEdge, job->rightEdge, botEdge);
+		job->topEdge = botEdge + 1;
+		if (done && job->refresh) {
+			post_REFRESH_SCREEN(s->id);
+		}
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+	}
+
+	if (done) {
+		me->firstJob = (me->firstJob + 1) % RENDER_MAX_JOBS;
+		me->numJobs--;
+	}
+	if (me->numJobs > 0) {
+		post_RENDER_STEP();
+	}
+}
+
+/**
+ * Writes what a widget renders again into the base layer and repaints
+ * those rows of its section.
+ *
+ * @param[in,out] me   RenderArtist
+ * @param[in,out] s	   Session
+ * @param[in,out] view Widget
+ */
+static void draw_view(RenderArtist* me, Session* s, SectionView* view) {
+	RenderLayer* layer = &s->layers[0];
+	int topEdge, botEdge;
+	if (SectionView_draw(view, layer, &topEdge, &botEdge) == 0 || topEdge > botEdge) {
+		return;
+	}
+	RenderSection const* section = Layer_getSection(layer, view->key);
+	queue_repaint(me, s->id, layer, section->xAnchor, topEdge,
+			section->xAnchor + section->xDim - 1, botEdge, 1);
+}
+
+/**
+ * Does a step of every widget's background work in a session and draws
+ * what changed.
+ *
+ * @param[in,out] me RenderArtist
+ * @param[in,out] s	 Session
+ *
+ * @returns Non-zero if work remains
+ */
+static int update_views(RenderArtist* me, Session* s) {
+	int busy = 0;
+	for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+		SectionView* view = &s->views[i];
+		if (view->kind == VIEW_NONE) { continue; }
+		busy |= SectionView_step(view, VIEW_STEP_ROWS);
+		draw_view(me, s, view);
+	}
+	return busy;
+}
+
+/**
+ * Fits widgets to their sections and draws them whole, after the
+ * sections were configured, replaced or restored.
+ *
+ * @param[in,out] me		 RenderArtist
+ * @param[in,out] s			 Session
+ * @param[in]	  sectionKey Section changed, NULL for all
+ */
+static void refit_views(RenderArtist* me, Session* s, char const* sectionKey) {
+	for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+		SectionView* view = &s->views[i];
+		if (view->kind == VIEW_NONE) { continue; }
+		if (sectionKey != NULL && strncmp(view->key, sectionKey, PAINTER_KEY_LEN)) { continue; }
+		RenderSection const* section = Layer_getSection(&s->layers[0], view->key);
+		if (section == NULL) { continue; }
+		SectionView_resize(view, section);
+		draw_view(me, s, view);
+	}
+}
+
+/**
+ * Binds a widget to a section of a session's base layer and draws it.
+ *
+ * @param[in,out] me RenderArtist
+ * @param[in,out] s	 Session
+ * @param[in]	  e	 Widget to bind
+ */
+static void attach_view(RenderArtist* me, Session* s, ViewEvt const* e) {
+	RenderSection const* section = Layer_getSection(&s->layers[0], e->sectionKey);
+	if (section == NULL) { return; }
+
+	SectionView* view = NULL;
+	switch (e->op) {
+	case VIEW_TABLE: view = SectionView_bindTable(s->views, section, e->spec, e->ctx); break;
+	case VIEW_WRAP: view = SectionView_bindWrap(s->views, section); break;
+	case VIEW_CHART: view = SectionView_bindChart(s->views, section, e->spec); break;
+	}
+	if (view != NULL && update_views(me, s)) {
+		post_VIEW_STEP(me);
+	}
+}
+
+/**
+ * Passes an input to the widget of a section and draws what changed.
+ *
+ * @param[in,out] me RenderArtist
+ * @param[in,out] s	 Session
+ * @param[in]	  e	 Input
  */
-static void draw_blank_section(RenderLayer* layer, int leftEdge, int topEdge, int rightEdge, int botEdge) {
-	layer->artwork[topEdge][leftEdge] = '+';
-	layer->artwork[topEdge][rightEdge] = '+';
-	layer->artwork[botEdge][leftEdge] = '+';
-	layer->artwork[botEdge][rightEdge] = '+';
+static void view_input(RenderArtist* me, Session* s, ViewEvt const* e) {
+	SectionView* view = SectionView_find(s->views, e->sectionKey);
+	if (view == NULL) { return; }
+
+	SectionView_input(view, e->op, e->arg);
+	if (update_views(me, s)) {
+		post_VIEW_STEP(me);
+	}
+}
 
-	for (int row = topEdge + 1; row < botEdge; row++) {
-		coalesce_outline(&layer->artwork[row][leftEdge], '|');
-		coalesce_outline(&layer->artwork[row][rightEdge], '|');
-		memset(&layer->artwork[row][leftEdge + 1], ' ', rightEdge - leftEdge - 1);
+/**
+ * Continues the background work of the sessions' widgets, taking turns
+ * from the session the last step stopped at. Stops once the step has
+ * taken @ref RENDER_SLICE_NS, leaving the other sessions to the next step.
+ *
+ * @param[in,out] me RenderArtist
+ */
+static void view_step(RenderArtist* me) {
+	int busy = 0;
+	int count = Session_count();
+	uint64_t begin = Session_clock();
+	me->viewStepPosted = 0;
+	for (int n = 0; n < count; n++) {
+		int i = (me->viewSession + n) % count;
+		Session* s = Session_get(i);
+		if (s == NULL) { continue; }
+		uint64_t start = Session_clock();
+		busy |= update_views(me, s);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		if (n + 1 < count && Session_clock() - begin >= RENDER_SLICE_NS) {
+			me->viewSession = (i + 1) % count;
+			busy = 1;
+			break;
+		}
 	}
-	for (int col = leftEdge + 1; col < rightEdge; col++) {
-		coalesce_outline(&layer->artwork[topEdge][col], '-');
-		coalesce_outline(&layer->artwork[botEdge][col], '-');
+	if (busy) {
+		post_VIEW_STEP(me);
 	}
 }
 
 /**
  * Initializes a section and draws on the screen.
  *
+ * @param[in,out] me	  RenderArtist
+ * @param[in]	  session Session ID
  * @param[in,out] layer   Layer that should contain the new section
  * @param[in]	  section Section to be added
  */
-static void create_section(RenderLayer* layer, RenderSection* section) {
-	int idx;
-	int leftEdge = section->xAnchor - 1;
-	int topEdge = section->yAnchor - 1;
-	int rightEdge = section->xAnchor + section->xDim;
-	int botEdge = section->yAnchor + section->yDim;
-	if (leftEdge < 0 || topEdge < 0 || rightEdge >= MAX_SCREEN_WIDTH || botEdge >= MAX_SCREEN_HEIGHT) {
+static void create_section(RenderArtist* me, uint16_t session, RenderLayer* layer, RenderSection* section) {
+	if (Layer_addSection(layer, section) == NULL) {
 		return;
 	}
+	Metrics_adjust(METRIC_SECTIONS, 1);
 
-	for (idx = 0; idx < SECTIONS_PER_LAYER; idx++) {
-		if (layer->sections[idx].key[0] == '\0') {
-			break;
-		}
+	queue_repaint(me, session, layer, section->xAnchor - 1, section->yAnchor - 1,
+			section->xAnchor + section->xDim, section->yAnchor + section->yDim, 1);
+}
+
+/**
+ * Moves or resizes a section and repaints the cells it left and entered.
+ * A section already in place is left as it is, content included.
+ *
+ * @param[in,out] me	  RenderArtist
+ * @param[in]	  session Session ID
+ * @param[in,out] layer   Layer that contains the section
+ * @param[in]	  section New section configuration
+ *
+ * @returns Non-zero if the section changed
+ */
+static int config_section(RenderArtist* me, uint16_t session, RenderLayer* layer, RenderSection const* section) {
+	RenderSection old;
+	RenderSection const* current = Layer_getSection(layer, section->key);
+	if (current != NULL && current->xAnchor == section->xAnchor && current->yAnchor == section->yAnchor
+			&& current->xDim == section->xDim && current->yDim == section->yDim) {
+		return 0;
 	}
-	if (idx == SECTIONS_PER_LAYER) {
-		return; // no free sections
+	if (Layer_configSection(layer, section, &old) != 0) {
+		return 0;
 	}
 
-	memcpy(&layer->sections[idx], section, sizeof(RenderSection));
+	queue_repaint(me, session, layer, old.xAnchor - 1, old.yAnchor - 1,
+			old.xAnchor + old.xDim, old.yAnchor + old.yDim, 0);
+	queue_repaint(me, session, layer, section->xAnchor - 1, section->yAnchor - 1,
+			section->xAnchor + section->xDim, section->yAnchor + section->yDim, 1);
+	return 1;
+}
+
+/**
+ * Counts the sections of a layer, overlays excluded.
+ */
+static int count_sections(RenderLayer const* layer) {
+	int n = 0;
+	while (n < SECTIONS_PER_LAYER && layer->sections[n].key[0] != '\0') {
+		n++;
+	}
+	return n;
+}
 
-	for (int row = topEdge; row <= botEdge; row++) {
-		if (leftEdge < layer->leftEdge[row]) {
-			layer->leftEdge[row] = leftEdge;
-		}
+/**
+ * Replaces a layer with a pre-rendered layout and presents it in one frame.
+ *
+ * @param[in,out] me	  RenderArtist
+ * @param[in]	  session Session ID
+ * @param[out]	  layer	  Layer to be replaced
+ * @param[in]	  layout  Compiled layout
+ */
+static void install_layout(RenderArtist* me, uint16_t session, RenderLayer* layer, RenderLayout const* layout) {
+	Metrics_adjust(METRIC_SECTIONS, (int64_t)layout->numSections - count_sections(layer));
+	Layer_install(layer, layout);
+	queue_repaint(me, session, layer, 0, 0, MAX_SCREEN_WIDTH - 1, MAX_SCREEN_HEIGHT - 1, 1);
+}
+
+/**
+ * Adds a snapshot of a session's base layer to its history, dropping the
+ * oldest one when the history is full. Nothing is copied; tiles are
+ * copied later, and only those drawn into.
+ *
+ * @param[in,out] s Session
+ */
+static void checkpoint_layer(Session* s) {
+	LayerHistory* h = &s->history;
+	if (h->count == LAYER_HISTORY_LEN) {
+		Layer_dropSnapshot(&h->snaps[h->first]);
+		h->first = (h->first + 1) % LAYER_HISTORY_LEN;
+		h->count--;
+	}
+	if (Layer_snapshot(&s->layers[0], &h->snaps[(h->first + h->count) % LAYER_HISTORY_LEN]) == 0) {
+		h->count++;
+	}
+}
+
+/**
+ * Restores a session's base layer from the latest snapshot in its history
+ * and repaints the rows that differ, in one frame.
+ *
+ * @param[in,out] me RenderArtist
+ * @param[in,out] s	 Session
+ */
+static void undo_layer(RenderArtist* me, Session* s) {
+	LayerHistory* h = &s->history;
+	RenderLayer* layer = &s->layers[0];
+	int topEdge, botEdge;
+	if (h->count == 0) {
+		return;
 	}
 
-	draw_blank_section(layer, leftEdge, topEdge, rightEdge, botEdge);
+	int before = count_sections(layer);
+	if (Layer_restore(layer, &h->snaps[(h->first + h->count - 1) % LAYER_HISTORY_LEN], &topEdge, &botEdge) != 0) {
+		return;
+	}
+	h->count--;
+	Metrics_adjust(METRIC_SECTIONS, (int64_t)count_sections(layer) - before);
+	if (topEdge <= botEdge) {
+		queue_repaint(me, s->id, layer, 0, topEdge, MAX_SCREEN_WIDTH - 1, botEdge, 1);
+	}
+}
 
-	for (int row = topEdge; row <= botEdge; row++) {
-		post_PAINT_LINE(row, leftEdge, &layer->artwork[row][leftEdge]);
+/**
+ * Opens a popup and paints it in one block.
+ *
+ * @param[in]	  session Session ID
+ * @param[in,out] layer	  Layer to draw over
+ * @param[in]	  section Popup section
+ */
+static void open_popup(uint16_t session, RenderLayer* layer, RenderSection const* section) {
+	if (Layer_openOverlay(layer, section) == NULL) {
+		return;
 	}
-	post_REFRESH_SCREEN();
+	Metrics_adjust(METRIC_SECTIONS, 1);
+
+	post_PAINT_BLOCK(session, layer, section->xAnchor - 1, section->yAnchor - 1,
+			section->xAnchor + section->xDim, section->yAnchor + section->yDim);
+	post_REFRESH_SCREEN(session);
 }
 
 /**
- * Looks up a section by its key.
+ * Closes a popup. What it covered comes back from its save-under with one
+ * block paint; nothing underneath is redrawn.
  *
- * @param[in] layer		 Layer to search
- * @param[in] sectionKey Section key to find
+ * @param[in]	  session	 Session ID
+ * @param[in,out] layer		 Layer containing the popup
+ * @param[in]	  sectionKey Popup key
+ */
+static void close_popup(uint16_t session, RenderLayer* layer, char const* sectionKey) {
+	RenderSection closed;
+	if (Layer_closeOverlay(layer, sectionKey, &closed) != 0) {
+		return;
+	}
+	Metrics_adjust(METRIC_SECTIONS, -1);
+
+	post_PAINT_BLOCK(session, layer, closed.xAnchor - 1, closed.yAnchor - 1,
+			closed.xAnchor + closed.xDim, closed.yAnchor + closed.yDim);
+	post_REFRESH_SCREEN(session);
+}
+
+/**
+ * Changes a session's search query and repaints the rows whose
+ * highlight changed, in one frame. Wrapped texts are searched whole
+ * first, and those scrolled to a match out of view are drawn again, so
+ * the highlight finds the match on the layer.
  *
- * @returns Pointer to section, or NULL on failure
+ * @param[in,out] me	 RenderArtist
+ * @param[in,out] s		 Session
+ * @param[in]	  e		 Query
  */
-static RenderSection* get_section(RenderLayer* layer, char* sectionKey) {
-	RenderSection* ret = NULL;
-	for (int i = 0; i < SECTIONS_PER_LAYER; i++) {
-		if (layer->sections[i].key[0] == '\0') { break; }
-		if (!strncmp(layer->sections[i].key, sectionKey, PAINTER_KEY_LEN)) {
-			ret = &layer->sections[i];
-			break;
+static void search_layer(RenderArtist* me, Session* s, SearchEvt const* e) {
+	int topEdge, botEdge;
+	if (SectionView_search(s->views, e->query, e->length) > 0) {
+		for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+			if (s->views[i].kind == VIEW_WRAP) {
+				draw_view(me, s, &s->views[i]);
+			}
 		}
 	}
-	return ret;
+	TextSearch_setQuery(&s->search, &s->layers[0], e->query, e->length, &topEdge, &botEdge);
+	if (topEdge <= botEdge) {
+		queue_repaint(me, s->id, &s->layers[0], 0, topEdge, MAX_SCREEN_WIDTH - 1, botEdge, 1);
+	}
+}
+
+/**
+ * Checks whether a later paint overwrites every cell of another.
+ *
+ * @param[in] later	  Later event
+ * @param[in] current Earlier paint
+ *
+ * @returns Non-zero if @p later covers @p current
+ */
+int RenderArtist_covers(QEvt const* later, PaintEvt const* current) {
+	if (later->sig != PAINT_LINE_SIG) { return 0; }
+	PaintEvt const* e = (PaintEvt const *)later;
+	return e->session == current->session
+			&& e->yAnchor == current->yAnchor
+			&& e->xAnchor == current->xAnchor
+			&& e->columns >= current->columns
+			&& !strncmp(e->sectionKey, current->sectionKey, PAINTER_KEY_LEN);
 }
 
 /**
- * Draws a single line in a section.
+ * Looks for a paint further down the queue that overwrites this one.
+ * Only the last writer of a span is ever visible, so a superseded paint
+ * can be dropped without drawing, forwarding or refreshing it.
+ *
+ * @param[in] me Active object whose queue is scanned
+ * @param[in] e	 Paint being handled
  *
- * @param[in,out] layer Layer to be updated
- * @param[in]	  e		Paint event
+ * @returns Non-zero if @p e is superseded
  */
-static void draw_section_line(RenderLayer* layer, PaintEvt* e) {
-	RenderSection* section = get_section(layer, e->sectionKey);
+static int is_superseded(QActive const* me, PaintEvt const* e) {
+	int found = 0;
+	QF_CRIT_STAT_
+	QF_CRIT_ENTRY_();
+	QEQueue const* q = &me->eQueue;
+	if (q->frontEvt != (QEvt *)0) {
+		found = RenderArtist_covers(q->frontEvt, e);
+		// ring holds the rest, oldest at tail, walking down with wrap
+		QEQueueCtr idx = q->tail;
+		for (QEQueueCtr n = q->end - q->nFree; n > 0 && !found; n--) {
+			found = RenderArtist_covers(q->ring[idx], e);
+			if (idx == 0U) { idx = q->end; }
+			idx--;
+		}
+	}
+	QF_CRIT_EXIT_();
+	return found;
+}
+
+/**
+ * Draws a single line in a section. The UTF-8 text is laid out as cells
+ * and clipped to the section's right edge, wide characters whole.
+ *
+ * @param[in,out] s Session
+ * @param[in]	  e Paint event
+ */
+static void draw_section_line(Session* s, PaintEvt* e) {
+	RenderLayer* layer = &s->layers[0];
+	RenderSection* section = Layer_getSection(layer, e->sectionKey);
 	if (section == NULL) { return; }
 
 	int yAnchor = section->yAnchor + e->yAnchor;
 	int xAnchor = section->xAnchor + e->xAnchor;
-	int size = strnlen(e->canvas, section->xDim);
-	memcpy(&layer->artwork[yAnchor][xAnchor], e->canvas, size * sizeof(char));
+	int room = section->xDim - e->xAnchor;
+	if (room <= 0) { return; }
+	char const* text = PaintArena_data(e->canvas);
+	char cells[MAX_SCREEN_WIDTH];
+	int size = Glyph_layout(&s->glyphs, text, strnlen(text, e->length), cells,
+			(room < MAX_SCREEN_WIDTH) ? room : MAX_SCREEN_WIDTH);
+	if (size == 0) { return; }
+	Layer_write(layer, section, xAnchor, yAnchor, cells, size);
+	Layer_touch(layer, yAnchor, yAnchor);
+
+	post_PAINT_BLOCK(e->session, layer, xAnchor, yAnchor, xAnchor + size - 1, yAnchor);
+	post_REFRESH_SCREEN(e->session);
+}
 
-	post_PAINT_LINE(yAnchor, xAnchor, &layer->artwork[yAnchor][xAnchor]);
-	post_REFRESH_SCREEN();
+/**
+ * Sets a paragraph of a wrapped section from a painted line. The line's
+ * row is the paragraph; the rows that show it change are redrawn.
+ *
+ * @param[in,out] me RenderArtist
+ * @param[in,out] s	 Session
+ * @param[in]	  e	 Paint event
+ *
+ * @returns Non-zero if the line was for a wrapped section
+ */
+static int paint_wrapped(RenderArtist* me, Session* s, PaintEvt const* e) {
+	SectionView* view = SectionView_find(s->views, e->sectionKey);
+	if (view == NULL || view->kind != VIEW_WRAP) { return 0; }
+
+	char const* text = PaintArena_data(e->canvas);
+	char cells[PAINT_ARENA_MAX_LEN];
+	int size = Glyph_layout(&s->glyphs, text, strnlen(text, e->length), cells, PAINT_ARENA_MAX_LEN);
+	SectionView_text(view, e->yAnchor, cells, size);
+	draw_view(me, s, view);
+	return 1;
+}
+
+/**
+ * Marks the glyphs of a block of cells in a glyph table.
+ *
+ * @param[in,out] arg	Glyph table
+ * @param[in]	  cells Cells
+ * @param[in]	  n		Number of cells
+ */
+static void mark_glyphs(void* arg, char const* cells, size_t n) {
+	Glyph_mark(arg, cells, n);
+}
+
+/**
+ * Frees the glyphs nothing can draw any more, once a session's glyph
+ * table is full. The session's layers, snapshots and wrapped texts are
+ * marked, and so are the frames its exporter holds, which keep glyph
+ * cells until viewers are sent something else.
+ *
+ * @param[in,out] arg Session
+ */
+static void reclaim_glyphs(void* arg) {
+	Session* s = arg;
+	for (int l = 0; l < NUM_LAYERS; l++) {
+		Layer_visitCells(&s->layers[l], &mark_glyphs, &s->glyphs);
+	}
+	for (int n = 0; n < s->history.count; n++) {
+		Layer_visitSnapshot(&s->history.snaps[(s->history.first + n) % LAYER_HISTORY_LEN], &mark_glyphs, &s->glyphs);
+	}
+	SectionView_visitCells(s->views, &mark_glyphs, &s->glyphs);
+	Glyph_mark(&s->glyphs, &s->exporter.cells[0][0], sizeof(s->exporter.cells));
+	Glyph_mark(&s->glyphs, &s->exporter.sent[0][0], sizeof(s->exporter.sent));
+	int freed = Glyph_sweep(&s->glyphs);
+	if (freed > 0) {
+		Metrics_count(METRIC_GLYPHS_RECLAIMED, freed);
+	} else {
+		Metrics_count(METRIC_GLYPHS_EXHAUSTED, 1);
+	}
 }
 
 //////////////////////////////////////////
@@ -208,10 +666,69 @@ QActive * const AO_RenderArtist = &l_renderEngine.super;
 void RenderArtist_ctor(void) {
 	RenderArtist *me = (RenderArtist *)AO_RenderArtist;
 	QActive_ctor(&me->super, Q_STATE_CAST(&RenderArtist_initial));
+	me->firstJob = 0;
+	me->numJobs = 0;
+	me->creditPosted = 0;
+	me->returned = 0;
+	me->viewStepPosted = 0;
+	me->viewSession = 0;
+}
 
+/**
+ * Takes the credits returned since the last call. Called by the engine
+ * when it handles @ref RENDER_CREDIT_SIG; credits returned after this
+ * call wake the engine again.
+ *
+ * @returns Number of credits
+ */
+uint16_t RenderArtist_collectCredits(void) {
+	RenderArtist *me = (RenderArtist *)AO_RenderArtist;
+	__atomic_store_n(&me->creditPosted, 0, __ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&me->returned, 0, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Drops every snapshot in a session's history, returning the tiles only
+ * they hold to the pool.
+ *
+ * @param[in,out] s Session
+ */
+static void drop_history(Session* s) {
+	LayerHistory* h = &s->history;
+	for (; h->count > 0; h->count--) {
+		Layer_dropSnapshot(&h->snaps[h->first]);
+		h->first = (h->first + 1) % LAYER_HISTORY_LEN;
+	}
+	h->first = 0;
+}
+
+/**
+ * Initializes the render state of a new session.
+ *
+ * @param[out] s Session
+ */
+void RenderArtist_attach(Session* s) {
 	for (int i = 0; i < NUM_LAYERS; i++) {
-		init_layer(&me->layers[i]);
+		Layer_init(&s->layers[i]);
 	}
+	drop_history(s);
+	TextSearch_init(&s->search);
+	SectionView_init(s->views);
+	Glyph_initTable(&s->glyphs);
+	Glyph_setReclaim(&s->glyphs, &reclaim_glyphs, s);
+}
+
+/**
+ * Releases the render state of a closing session and takes its sections
+ * out of the metrics.
+ *
+ * @param[in,out] s Session
+ */
+void RenderArtist_detach(Session* s) {
+	RenderLayer* layer = &s->layers[0];
+	Metrics_adjust(METRIC_SECTIONS, -(int64_t)(count_sections(layer) + layer->numOverlays));
+	SectionView_freeAll(s->views);
+	drop_history(s);
 }
 
 /**
@@ -227,15 +744,150 @@ static QState RenderArtist_initial(RenderArtist * const me, QEvt const * const e
  * Idle state.
  */
 static QState Idle(RenderArtist * const me, QEvt const * const e) {
+	if (takes_credit(e->sig)) {
+		repay_credit(me);
+	}
 	switch (e->sig) {
 	/// - @ref CREATE_SECTION_SIG
 	case CREATE_SECTION_SIG: {
-		create_section(&me->layers[0], &((SectionCfgEvt *)e)->section);
+		SectionCfgEvt* cfgEvt = (SectionCfgEvt *)e;
+		Session* s = Session_get(cfgEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		create_section(me, s->id, &s->layers[0], &cfgEvt->section);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref INSTALL_LAYOUT_SIG
+	case INSTALL_LAYOUT_SIG: {
+		LayoutEvt* layoutEvt = (LayoutEvt *)e;
+		Session* s = Session_get(layoutEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		install_layout(me, s->id, &s->layers[0], layoutEvt->layout);
+		refit_views(me, s, NULL);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref CONFIG_SECTION_SIG
+	case CONFIG_SECTION_SIG: {
+		SectionCfgEvt* cfgEvt = (SectionCfgEvt *)e;
+		Session* s = Session_get(cfgEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		if (config_section(me, s->id, &s->layers[0], &cfgEvt->section)) {
+			refit_views(me, s, cfgEvt->section.key);
+		}
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref OPEN_POPUP_SIG
+	case OPEN_POPUP_SIG: {
+		SectionCfgEvt* cfgEvt = (SectionCfgEvt *)e;
+		Session* s = Session_get(cfgEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		open_popup(s->id, &s->layers[0], &cfgEvt->section);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref CLOSE_POPUP_SIG
+	case CLOSE_POPUP_SIG: {
+		SectionCfgEvt* cfgEvt = (SectionCfgEvt *)e;
+		Session* s = Session_get(cfgEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		close_popup(s->id, &s->layers[0], cfgEvt->section.key);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref CHECKPOINT_LAYER_SIG
+	case CHECKPOINT_LAYER_SIG: {
+		Session* s = Session_get(((SessionEvt *)e)->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		checkpoint_layer(s);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref UNDO_LAYER_SIG
+	case UNDO_LAYER_SIG: {
+		Session* s = Session_get(((SessionEvt *)e)->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		undo_layer(me, s);
+		refit_views(me, s, NULL);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref SEARCH_SIG
+	case SEARCH_SIG: {
+		SearchEvt* searchEvt = (SearchEvt *)e;
+		Session* s = Session_get(searchEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		search_layer(me, s, searchEvt);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref ATTACH_VIEW_SIG
+	case ATTACH_VIEW_SIG: {
+		ViewEvt* viewEvt = (ViewEvt *)e;
+		Session* s = Session_get(viewEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		attach_view(me, s, viewEvt);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref VIEW_INPUT_SIG
+	case VIEW_INPUT_SIG: {
+		ViewEvt* viewEvt = (ViewEvt *)e;
+		Session* s = Session_get(viewEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		view_input(me, s, viewEvt);
+		Session_charge(s, METRIC_STAGE_RENDER, start);
+		return Q_HANDLED();
+	}
+	/// - @ref VIEW_STEP_SIG
+	case VIEW_STEP_SIG: {
+		view_step(me);
+		return Q_HANDLED();
+	}
+	/// - @ref RENDER_STEP_SIG
+	case RENDER_STEP_SIG: {
+		render_step(me);
 		return Q_HANDLED();
 	}
 	/// - @ref PAINT_LINE_SIG
 	case PAINT_LINE_SIG: {
-		draw_section_line(&me->layers[0], ((PaintEvt *)e));
+		PaintEvt* paintEvt = (PaintEvt *)e;
+		Session* s = Session_get(paintEvt->session);
+		if (s != NULL) {
+			uint64_t start = Session_clock();
+			if (is_superseded(&me->super, paintEvt)) {
+				s->stats.merged++;
+				Metrics_count(METRIC_PAINTS_MERGED, 1);
+			} else {
+				if (!paint_wrapped(me, s, paintEvt)) {
+					draw_section_line(s, paintEvt);
+				}
+				Metrics_count(METRIC_PAINTS, 1);
+			}
+			Session_charge(s, METRIC_STAGE_RENDER, start);
+		}
+		PaintArena_release(paintEvt->canvas);
 		return Q_HANDLED();
 	}
 	}
@@ -10,6 +10,175 @@ static QState ScreenPainter_initial(ScreenPainter * const me, QEvt const * const
 static QState Setup(ScreenPainter * const me, QEvt const * const e);
 static QState Idle(ScreenPainter * const me, QEvt const * const e);
 
+/**
+ * Blank cells, painted wherever the layer is empty.
+ */
+static char l_blank[MAX_SCREEN_WIDTH];
+
+/**
+ * Paints cells of one tile row, blank where nothing is drawn.
+ *
+ * @param[in,out] s		Session the row belongs to
+ * @param[in]	  cells	Cells to paint
+ * @param[in]	  y		Row
+ * @param[in]	  x		Column of the first cell
+ * @param[in]	  len	Number of cells
+ */
+static void paint_cells(Session* s, char const* cells, int y, int x, int len) {
+	int col = 0;
+	Metrics_count(METRIC_CELLS_PAINTED, len);
+	while (col < len) {
+		int run = col;
+		if (cells[col] == '\0') {
+			while (run < len && cells[run] == '\0') { run++; }
+			mvaddnstr(y, x + col, l_blank, run - col);
+			FrameExporter_paint(&s->exporter, y, x + col, l_blank, run - col);
+		} else {
+			while (run < len && cells[run] != '\0') { run++; }
+			mvaddnstr(y, x + col, &cells[col], run - col);
+			FrameExporter_paint(&s->exporter, y, x + col, &cells[col], run - col);
+		}
+		col = run;
+	}
+}
+
+/**
+ * Paints part of a layer row straight from the layer's tiles.
+ * Empty tiles are painted blank without being looked at.
+ *
+ * @param[in,out] s		Session the row belongs to
+ * @param[in]	  layer	Layer to paint from
+ * @param[in]	  y		Row
+ * @param[in]	  left	Leftmost column
+ * @param[in]	  right	Rightmost column
+ */
+static void paint_span(Session* s, RenderLayer const* layer, int y, int left, int right) {
+	int col = left;
+	while (col <= right) {
+		int len;
+		char const* cells = Layer_span(layer, col, y, &len);
+		if (col + len - 1 > right) {
+			len = right - col + 1;
+		}
+		if (cells == NULL) {
+			Metrics_count(METRIC_CELLS_PAINTED, len);
+			mvaddnstr(y, col, l_blank, len);
+			FrameExporter_paint(&s->exporter, y, col, l_blank, len);
+		} else {
+			paint_cells(s, cells, y, col, len);
+		}
+		col += len;
+	}
+}
+
+/**
+ * Paints part of a row that may hold glyphs. The span is widened to
+ * take in both halves of a wide glyph it cuts, and the whole span goes
+ * out in one call as UTF-8. Halves left over by later writes are painted
+ * blank. The exporter gets whole glyphs as their cells.
+ *
+ * @param[in,out] s		Session the row belongs to
+ * @param[in]	  layer	Layer to paint from
+ * @param[in]	  y		Row
+ * @param[in]	  left	Leftmost column
+ * @param[in]	  right	Rightmost column
+ */
+static void paint_glyph_span(Session* s, RenderLayer const* layer, int y, int left, int right) {
+	char cells[MAX_SCREEN_WIDTH + 1];
+	char text[MAX_SCREEN_WIDTH * GLYPH_MAX_BYTES];
+	char exported[MAX_SCREEN_WIDTH];
+	int len = 0;
+
+	if (left > 0 && Layer_cell(layer, left, y) == (char)GLYPH_TAIL) { left--; }
+	if (right < MAX_SCREEN_WIDTH - 1 && Layer_cell(layer, right + 1, y) == (char)GLYPH_TAIL) { right++; }
+	for (int col = left; col <= right; col++) {
+		cells[col - left] = Layer_cell(layer, col, y);
+	}
+	cells[right - left + 1] = '\0';
+	Metrics_count(METRIC_CELLS_PAINTED, right - left + 1);
+
+	for (int i = 0; i <= right - left; i++) {
+		char c = cells[i];
+		int bytesLen;
+		int width;
+		char const* bytes = Glyph_bytes(&s->glyphs, c, &bytesLen, &width);
+		if (bytes != NULL && (width == 1 || cells[i + 1] == (char)GLYPH_TAIL)) {
+			memcpy(&exported[i], &cells[i], width);
+#if GLYPH_OUTPUT
+			memcpy(&text[len], bytes, bytesLen);
+			len += bytesLen;
+#else
+			memset(&text[len], GLYPH_REPLACEMENT, width);
+			len += width;
+#endif
+			i += width - 1;
+		} else {
+			exported[i] = (c == '\0' || Glyph_isGlyph(c)) ? ' ' : c;
+			text[len++] = exported[i];
+		}
+	}
+	mvaddnstr(y, left, text, len);
+	FrameExporter_paint(&s->exporter, y, left, exported, right - left + 1);
+}
+
+/**
+ * Sets the video attribute of a run of cells on the selected terminal.
+ */
+static void set_attr(int y, int col, int len, int reverse, void* arg) {
+	(void)arg;
+	mvchgat(y, col, len, reverse ? A_REVERSE : A_NORMAL, 0, NULL);
+}
+
+/**
+ * Shows the search matches of a painted row in reverse video. The whole
+ * row is highlighted again, since an edit in the part painted can make
+ * or break a match that reaches past it.
+ *
+ * @param[in,out] s		Session the row belongs to
+ * @param[in]	  layer	Layer painted
+ * @param[in]	  y		Row
+ */
+static void highlight_row(Session* s, RenderLayer const* layer, int y) {
+	if (s->search.length == 0) { return; }
+	TextSearch_highlight(&s->search, layer, y, &set_attr, NULL);
+}
+
+/**
+ * Paints every row of a block to the selected terminal.
+ * Rows already painted at their latest version are skipped; rows that
+ * changed after the block was posted are painted whole, at their latest
+ * version, so later references to them can be skipped.
+ *
+ * @param[in,out] s Session the block belongs to
+ * @param[in]	  e Block paint event
+ *
+ * @returns Number of cells painted
+ */
+static int paint_block(Session* s, BlockEvt const* e) {
+	RenderLayer const* layer = &s->layers[0];
+	int cells = 0;
+	for (int y = e->yAnchor; y < e->yAnchor + e->height && y < MAX_SCREEN_HEIGHT; y++) {
+		uint32_t latest = layer->rowVersion[y];
+		if (s->painted[y] >= latest) { continue; }
+		int left = 0;
+		int right = MAX_SCREEN_WIDTH - 1;
+		if (latest > e->version) {
+			s->painted[y] = latest;
+		} else {
+			left = e->xAnchor;
+			if (e->xAnchor + e->width - 1 < right) { right = e->xAnchor + e->width - 1; }
+		}
+		if (layer->hasGlyphs[y]) {
+			paint_glyph_span(s, layer, y, left, right);
+		} else {
+			paint_span(s, layer, y, left, right);
+		}
+		highlight_row(s, layer, y);
+		cells += right - left + 1;
+	}
+	return cells;
+}
+
 //////////////////////////////////////////
 /// @ingroup Fwk
 /// @defgroup AOScreenPainter Active Object - ScreenPainter
@@ -30,6 +199,17 @@ QActive * const AO_ScreenPainter = &l_screenPainter.super;
 void ScreenPainter_ctor(void) {
 	ScreenPainter *me = (ScreenPainter *)AO_ScreenPainter;
 	QActive_ctor(&me->super, Q_STATE_CAST(&ScreenPainter_initial));
+	me->cellNs = RENDER_CELL_NS;
+	memset(l_blank, ' ', MAX_SCREEN_WIDTH);
+}
+
+/**
+ * Gives the measured cost of painting a cell, for sizing repaint slices.
+ *
+ * @returns Nanoseconds per cell, at least 1
+ */
+uint32_t ScreenPainter_cellCost(void) {
+	return ((ScreenPainter *)AO_ScreenPainter)->cellNs;
 }
 
 /**
@@ -61,15 +241,35 @@ static QState Setup(ScreenPainter * const me, QEvt const * const e) {
  */
 static QState Idle(ScreenPainter * const me, QEvt const * const e) {
 	switch (e->sig) {
-	/// - @ref PAINT_LINE_SIG
-	case PAINT_LINE_SIG: {
-		PaintEvt* paintEvt = (PaintEvt *)e;
-		mvaddstr(paintEvt->yAnchor, paintEvt->xAnchor, paintEvt->canvas);
+	/// - @ref PAINT_BLOCK_SIG
+	case PAINT_BLOCK_SIG: {
+		BlockEvt* blockEvt = (BlockEvt *)e;
+		Session* s = Session_get(blockEvt->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		Session_select(s);
+		int cells = paint_block(s, blockEvt);
+		if (cells > 0) {
+			uint64_t ns = (Session_clock() - start) / cells;
+			ns = (me->cellNs * 7ULL + ns) / 8; // smooth out single slow blocks
+			me->cellNs = (ns < 1) ? 1 : (ns > RENDER_SLICE_NS) ? RENDER_SLICE_NS : (uint32_t)ns;
+		}
+		Metrics_count(METRIC_BLOCKS, 1);
+		Session_charge(s, METRIC_STAGE_PAINT, start);
 		return Q_HANDLED();
 	}
 	/// - @ref REFRESH_SCREEN_SIG
 	case REFRESH_SCREEN_SIG: {
+		Session* s = Session_get(((SessionEvt *)e)->session);
+		if (s == NULL) { return Q_HANDLED(); }
+
+		uint64_t start = Session_clock();
+		Session_select(s);
 		refresh();
+		FrameExporter_present(&s->exporter);
+		Metrics_count(METRIC_FRAMES, 1);
+		Session_charge(s, METRIC_STAGE_PRESENT, start);
 		return Q_HANDLED();
 	}
 	}
@@ -0,0 +1,371 @@
+/**
+ * @file section_view.c
+ * Widgets bound to sections.
+ *
+ * A bound widget owns the inside of its section: RenderArtist hands it
+ * inputs, text and the section's size, lets it spread index and reflow
+ * work over steps, and asks it to draw. Widgets render only what changed, and each line
+ * they render is written straight into the layer. The module is QP-free;
+ * RenderArtist repaints the rows reported.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+
+#include "section_view.h"
+
+/**
+ * @struct ViewTarget
+ * Where the lines of a widget go.
+ */
+typedef struct {
+	RenderLayer* layer;				///< Layer drawn into
+	RenderSection const* section;	///< Section drawn
+	int topEdge;					///< Topmost row written
+	int botEdge;					///< Bottom-most row written
+} ViewTarget;
+
+/**
+ * Writes one line of a widget into its section.
+ */
+static void write_line(int y, char const* text, void* arg) {
+	ViewTarget* t = arg;
+	if (y >= t->section->yDim) { return; }
+
+	int row = t->section->yAnchor + y;
+	int len = strnlen(text, t->section->xDim);
+	Layer_write(t->layer, t->section, t->section->xAnchor, row, text, len);
+	if (row < t->topEdge) { t->topEdge = row; }
+	if (row > t->botEdge) { t->botEdge = row; }
+}
+
+/**
+ * Writes a run of chart cells into its section.
+ */
+static void write_span(int y, int x, char const* text, int len, void* arg) {
+	ViewTarget* t = arg;
+	if (y >= t->section->yDim || x >= t->section->xDim) { return; }
+
+	int row = t->section->yAnchor + y;
+	if (len > t->section->xDim - x) {
+		len = t->section->xDim - x;
+	}
+	Layer_write(t->layer, t->section, t->section->xAnchor + x, row, text, len);
+	if (row < t->topEdge) { t->topEdge = row; }
+	if (row > t->botEdge) { t->botEdge = row; }
+}
+
+/**
+ * Frees the widget of a slot.
+ */
+static void unbind(SectionView* view) {
+	switch (view->kind) {
+	case VIEW_TABLE: TableView_free(&view->w.table); break;
+	case VIEW_WRAP: WrapText_free(&view->w.wrap); break;
+	case VIEW_CHART: ChartView_free(&view->w.chart); break;
+	}
+	view->kind = VIEW_NONE;
+	view->key[0] = '\0';
+}
+
+/**
+ * Finds the slot for a section, freeing the widget bound to it before.
+ *
+ * @returns Slot, or NULL if all are taken
+ */
+static SectionView* claim(SectionView views[VIEWS_PER_SESSION], char const* sectionKey) {
+	SectionView* view = SectionView_find(views, sectionKey);
+	for (int i = 0; i < VIEWS_PER_SESSION && view == NULL; i++) {
+		if (views[i].kind == VIEW_NONE) {
+			view = &views[i];
+		}
+	}
+	if (view != NULL) {
+		unbind(view);
+		snprintf(view->key, sizeof(view->key), "%s", sectionKey);
+	}
+	return view;
+}
+
+/**
+ * Empties every slot.
+ *
+ * @param[out] views Slots of a session
+ */
+void SectionView_init(SectionView views[VIEWS_PER_SESSION]) {
+	memset(views, 0, VIEWS_PER_SESSION * sizeof(SectionView));
+}
+
+/**
+ * Frees every bound widget.
+ *
+ * @param[in,out] views Slots of a session
+ */
+void SectionView_freeAll(SectionView views[VIEWS_PER_SESSION]) {
+	for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+		unbind(&views[i]);
+	}
+}
+
+/**
+ * Looks up the widget bound to a section.
+ *
+ * @param[in] views		 Slots of a session
+ * @param[in] sectionKey Section key
+ *
+ * @returns Widget, or NULL if none is bound
+ */
+SectionView* SectionView_find(SectionView views[VIEWS_PER_SESSION], char const* sectionKey) {
+	for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+		if (views[i].kind != VIEW_NONE && !strncmp(views[i].key, sectionKey, PAINTER_KEY_LEN)) {
+			return &views[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Binds a table to a section, replacing any widget bound to it.
+ *
+ * @param[in,out] views	  Slots of a session
+ * @param[in]	  section Section to draw
+ * @param[in]	  spec	  Source and columns
+ * @param[in]	  ctx	  Context passed to the source
+ *
+ * @returns Widget, or NULL if all slots are taken
+ */
+SectionView* SectionView_bindTable(SectionView views[VIEWS_PER_SESSION], RenderSection const* section,
+		TableSpec const* spec, void* ctx) {
+	SectionView* view = claim(views, section->key);
+	if (view == NULL) { return NULL; }
+
+	TableSource source = spec->source;
+	source.ctx = ctx;
+	TableView_init(&view->w.table, &source, section->xDim, section->yDim);
+	for (int c = 0; c < spec->numColumns; c++) {
+		TableView_addColumn(&view->w.table, spec->columns[c].title, spec->columns[c].width);
+	}
+	view->filter = spec->filter;
+	view->kind = VIEW_TABLE;
+	return view;
+}
+
+/**
+ * Binds an empty word-wrapped text to a section, replacing any widget
+ * bound to it.
+ *
+ * @param[in,out] views	  Slots of a session
+ * @param[in]	  section Section to draw
+ *
+ * @returns Widget, or NULL if all slots are taken
+ */
+SectionView* SectionView_bindWrap(SectionView views[VIEWS_PER_SESSION], RenderSection const* section) {
+	SectionView* view = claim(views, section->key);
+	if (view == NULL) { return NULL; }
+
+	WrapText_init(&view->w.wrap, section->xDim, section->yDim);
+	view->kind = VIEW_WRAP;
+	return view;
+}
+
+/**
+ * Binds an empty chart to a section, replacing any widget bound to it.
+ *
+ * @param[in,out] views	  Slots of a session
+ * @param[in]	  section Section to draw
+ * @param[in]	  spec	  Series and scale
+ *
+ * @returns Widget, or NULL if all slots are taken or out of memory
+ */
+SectionView* SectionView_bindChart(SectionView views[VIEWS_PER_SESSION], RenderSection const* section,
+		ChartSpec const* spec) {
+	SectionView* view = claim(views, section->key);
+	if (view == NULL) { return NULL; }
+
+	if (ChartView_init(&view->w.chart, spec->capacity, section->xDim, section->yDim) != 0) {
+		view->key[0] = '\0';
+		return NULL;
+	}
+	ChartView_setRange(&view->w.chart, spec->scaleLo, spec->scaleHi);
+	view->kind = VIEW_CHART;
+	return view;
+}
+
+/**
+ * Fits a widget to its section after the section moved, was resized or
+ * was cleared; the whole widget is drawn again.
+ *
+ * @param[in,out] view	  Widget
+ * @param[in]	  section Section, as now configured
+ */
+void SectionView_resize(SectionView* view, RenderSection const* section) {
+	switch (view->kind) {
+	case VIEW_TABLE: TableView_resize(&view->w.table, section->xDim, section->yDim); break;
+	case VIEW_WRAP: WrapText_resize(&view->w.wrap, section->xDim, section->yDim); break;
+	case VIEW_CHART: ChartView_resize(&view->w.chart, section->xDim, section->yDim); break;
+	}
+}
+
+/**
+ * Sets a paragraph of a wrapped text, adding empty ones before it as
+ * needed. Only the paragraphs changed are rewrapped.
+ *
+ * @param[in,out] view Wrapped text
+ * @param[in]	  para Paragraph
+ * @param[in]	  text Cells of the paragraph
+ * @param[in]	  len  Number of cells
+ *
+ * @returns 0 on success, -1 if @p view is not a wrapped text or out of memory
+ */
+int SectionView_text(SectionView* view, uint32_t para, char const* text, uint32_t len) {
+	if (view->kind != VIEW_WRAP) { return -1; }
+
+	WrapText* wrap = &view->w.wrap;
+	if (wrap->numParas == 0 && WrapText_append(wrap, "", 0) != 0) {
+		return -1;
+	}
+	while (wrap->numParas <= para) {
+		if (WrapText_append(wrap, "\n", 1) != 0) {
+			return -1;
+		}
+	}
+	return WrapText_edit(wrap, para, text, len);
+}
+
+/**
+ * Hands on the cells widgets keep off the layer: the paragraphs of
+ * wrapped texts, which may hold glyphs.
+ *
+ * @param[in] views Slots of a session
+ * @param[in] visit Called for each block of cells
+ * @param[in] arg	Passed to @p visit
+ */
+void SectionView_visitCells(SectionView views[VIEWS_PER_SESSION], LayerCellsCb visit, void* arg) {
+	for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+		if (views[i].kind != VIEW_WRAP) { continue; }
+		WrapText const* wrap = &views[i].w.wrap;
+		for (uint32_t p = 0; p < wrap->numParas; p++) {
+			visit(arg, wrap->paras[p].text, wrap->paras[p].length);
+		}
+	}
+}
+
+/**
+ * Brings a match of a search query into view in every wrapped text. The
+ * whole document is searched, not just the rows on the layer: a viewport
+ * that does not show the next match from its top line on is scrolled to
+ * put that match, or the first one of the document if none follows, at
+ * its top.
+ *
+ * @param[in,out] views Slots of a session
+ * @param[in]	  query Query
+ * @param[in]	  len	Length of @p query, 0 for no search
+ *
+ * @returns Number of views scrolled
+ */
+int SectionView_search(SectionView views[VIEWS_PER_SESSION], char const* query, uint32_t len) {
+	int scrolled = 0;
+	if (len == 0) { return 0; }
+
+	for (int i = 0; i < VIEWS_PER_SESSION; i++) {
+		if (views[i].kind != VIEW_WRAP) { continue; }
+		WrapText* wrap = &views[i].w.wrap;
+		uint32_t offset;
+		uint32_t para = WrapText_locate(wrap, wrap->top, &offset);
+		if (WrapText_find(wrap, query, len, &para, &offset) != 0) {
+			para = 0;
+			offset = 0;
+			if (WrapText_find(wrap, query, len, &para, &offset) != 0) { continue; }
+		}
+		uint32_t line = WrapText_lineOf(wrap, para, offset);
+		if (line >= wrap->top && line < wrap->top + wrap->height) { continue; }
+		WrapText_scroll(wrap, (line > wrap->top) ? (int32_t)(line - wrap->top) : -(int32_t)(wrap->top - line));
+		scrolled++;
+	}
+	return scrolled;
+}
+
+/**
+ * Passes an input to a widget. Inputs a widget has no use for are ignored.
+ *
+ * @param[in,out] view Widget
+ * @param[in]	  op   Input
+ * @param[in]	  arg  Argument of @p op
+ */
+void SectionView_input(SectionView* view, ViewOp op, int32_t arg) {
+	if (view->kind == VIEW_WRAP && op == VIEW_MOVE) {
+		WrapText_scroll(&view->w.wrap, arg);
+	} else if (view->kind == VIEW_CHART && op == VIEW_SAMPLE) {
+		float sample = (float)arg;
+		ChartView_push(&view->w.chart, &sample, 1);
+	} else if (view->kind == VIEW_TABLE) {
+		TableView* table = &view->w.table;
+		switch (op) {
+		case VIEW_MOVE:
+			TableView_moveCursor(table, arg);
+			break;
+		case VIEW_SORT:
+			TableView_sortBy(table, arg, arg >= 0 && arg == table->sortColumn && !table->descending);
+			break;
+		case VIEW_WIDEN:
+			TableView_resizeColumn(table, (table->sortColumn >= 0) ? table->sortColumn : 0, arg);
+			break;
+		case VIEW_FILTER:
+			TableView_setFilter(table, (arg >= 0) ? view->filter : NULL, (void *)(intptr_t)arg);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/**
+ * Does a bounded amount of a widget's background work.
+ *
+ * @param[in,out] view	 Widget
+ * @param[in]	  budget Work to do before returning, in index rows;
+ *						 see @ref VIEW_PARA_COST
+ *
+ * @returns Non-zero if work remains
+ */
+int SectionView_step(SectionView* view, uint32_t budget) {
+	switch (view->kind) {
+	case VIEW_TABLE: return TableView_step(&view->w.table, budget);
+	case VIEW_WRAP: return WrapText_step(&view->w.wrap, (budget + VIEW_PARA_COST - 1) / VIEW_PARA_COST);
+	}
+	return 0;
+}
+
+/**
+ * Writes the lines a widget renders again into its section.
+ *
+ * @param[in,out] view	  Widget
+ * @param[in,out] layer	  Layer holding the section
+ * @param[out]	  topEdge Topmost row written
+ * @param[out]	  botEdge Bottom-most row written, above @p topEdge if none was
+ *
+ * @returns Number of lines written
+ */
+int SectionView_draw(SectionView* view, RenderLayer* layer, int* topEdge, int* botEdge) {
+	ViewTarget t = { layer, Layer_getSection(layer, view->key), MAX_SCREEN_HEIGHT, -1 };
+	int lines = 0;
+	if (t.section != NULL) {
+		switch (view->kind) {
+		case VIEW_TABLE: lines = TableView_render(&view->w.table, &write_line, &t); break;
+		case VIEW_WRAP: lines = WrapText_render(&view->w.wrap, &write_line, &t); break;
+		case VIEW_CHART:
+			if (ChartView_render(&view->w.chart, &write_span, &t) > 0) {
+				lines = t.botEdge - t.topEdge + 1;
+			}
+			break;
+		}
+	}
+	if (t.topEdge <= t.botEdge) {
+		Layer_touch(layer, t.topEdge, t.botEdge);
+	}
+	*topEdge = t.topEdge;
+	*botEdge = t.botEdge;
+	return lines;
+}
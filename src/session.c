@@ -0,0 +1,213 @@
+/**
+ * @file session.c
+ * Terminal sessions served by the process.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "main.h"
+
+static Session* l_sessions[MAX_SESSIONS];	///< Registered sessions
+static int l_numSessions;					///< Number of registered sessions
+
+/**
+ * Heap currently in use, used to attribute curses allocations to a session.
+ *
+ * @returns Bytes in use, or 0 if the allocator cannot report it
+ */
+static size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 mi = mallinfo2();
+	return mi.uordblks + mi.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Registers a terminal to be served.
+ *
+ * @param[in] path Terminal device (e.g. a PTY slave), or NULL for stdin/stdout
+ *
+ * @returns Session ID, or -1 on failure
+ */
+int Session_add(char const* path) {
+	if (l_numSessions == MAX_SESSIONS) {
+		return -1;
+	}
+	Session* s = calloc(1, sizeof(Session));
+	if (s == NULL) {
+		return -1;
+	}
+	s->id = l_numSessions;
+	s->path = path;
+	s->fd = -1;
+	RenderArtist_attach(s);
+
+	l_sessions[l_numSessions++] = s;
+	return s->id;
+}
+
+/**
+ * @returns Number of registered sessions
+ */
+int Session_count(void) {
+	return l_numSessions;
+}
+
+/**
+ * Looks up a session.
+ *
+ * @param[in] id Session ID
+ *
+ * @returns Session, or NULL if the ID is unknown or the session is closed
+ */
+Session* Session_get(uint16_t id) {
+	if (id >= l_numSessions || l_sessions[id]->term == NULL) {
+		return NULL;
+	}
+	return l_sessions[id];
+}
+
+/**
+ * Opens a session's terminal and selects it for curses calls.
+ *
+ * @param[in] id Session ID
+ *
+ * @returns 0 on success, -1 on failure
+ */
+int Session_open(uint16_t id) {
+	if (id >= l_numSessions) {
+		return -1;
+	}
+	Session* s = l_sessions[id];
+	if (s->path == NULL) {
+		s->in = stdin;
+		s->out = stdout;
+		s->fd = STDIN_FILENO;
+	} else {
+		int fd = open(s->path, O_RDWR | O_NOCTTY);
+		if (fd < 0) {
+			return -1;
+		}
+		int outFd = dup(fd);
+		s->fd = fd;
+		s->in = fdopen(fd, "r");
+		s->out = (outFd < 0) ? NULL : fdopen(outFd, "w");
+		if (s->in == NULL || s->out == NULL) {
+			if (s->in != NULL) { fclose(s->in); } else { close(fd); }
+			if (s->out != NULL) { fclose(s->out); } else if (outFd >= 0) { close(outFd); }
+			s->in = NULL;
+			s->out = NULL;
+			s->fd = -1;
+			return -1;
+		}
+	}
+
+	size_t before = heap_in_use();
+	s->term = newterm(NULL, s->out, s->in);
+	if (s->term == NULL) {
+		if (s->path != NULL) {
+			fclose(s->in);
+			fclose(s->out);
+			s->in = NULL;
+			s->out = NULL;
+		}
+		s->fd = -1;
+		return -1;
+	}
+	s->stats.termBytes = heap_in_use() - before;
+
+	set_term(s->term);
+	Ticker_watchInput(s->fd);
+	FrameExporter_open(&s->exporter, s->id, &s->glyphs);
+	return 0;
+}
+
+/**
+ * Directs subsequent curses calls at a session's terminal.
+ *
+ * @param[in] s Session
+ */
+void Session_select(Session* s) {
+	set_term(s->term);
+}
+
+/**
+ * Restores and releases every open terminal.
+ */
+void Session_closeAll(void) {
+	for (int i = 0; i < l_numSessions; i++) {
+		Session* s = l_sessions[i];
+		if (s->term == NULL) { continue; }
+
+		FrameExporter_close(&s->exporter, s->id);
+		RenderArtist_detach(s);
+		set_term(s->term);
+		endwin();
+		delscreen(s->term);
+		s->term = NULL;
+		if (s->path != NULL) {
+			fclose(s->in);
+			fclose(s->out);
+		}
+	}
+}
+
+/**
+ * @returns Monotonic time in nanoseconds, for use with Session_charge()
+ */
+uint64_t Session_clock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Accounts the time since @p start to a session and to a pipeline stage.
+ *
+ * @param[in,out] s		Session to charge
+ * @param[in]	  stage	Stage that did the work
+ * @param[in]	  start	Value of Session_clock() when work began
+ */
+void Session_charge(Session* s, MetricStage stage, uint64_t start) {
+	uint64_t ns = Session_clock() - start;
+	s->stats.busyNs += ns;
+	s->stats.events++;
+	Metrics_record(stage, ns);
+}
+
+/**
+ * Writes per-session memory footprint and event handling cost to the log.
+ */
+void Session_report(void) {
+	char line[192];
+	uint64_t totalNs = 0;
+	size_t totalBytes = 0;
+
+	for (int i = 0; i < l_numSessions; i++) {
+		Session* s = l_sessions[i];
+		size_t bytes = sizeof(Session) + s->stats.termBytes;
+		snprintf(line, sizeof(line),
+				"session %d (%s): %zu B state + %zu B curses, %u events, %u paints merged, %llu us busy, %llu ns/event\n",
+				s->id, s->path ? s->path : "stdio",
+				sizeof(Session), s->stats.termBytes,
+				(unsigned)s->stats.events, (unsigned)s->stats.merged,
+				(unsigned long long)(s->stats.busyNs / 1000U),
+				(unsigned long long)(s->stats.events ? s->stats.busyNs / s->stats.events : 0U));
+		log(line);
+		totalNs += s->stats.busyNs;
+		totalBytes += bytes;
+	}
+	snprintf(line, sizeof(line), "%d sessions: %zu B total + %zu B layer tiles, %llu us busy\n",
+			l_numSessions, totalBytes, Layer_poolBytes(), (unsigned long long)(totalNs / 1000U));
+	log(line);
+}
@@ -0,0 +1,539 @@
+/**
+ * @file table_view.c
+ * Virtualised table widget.
+ *
+ * The view never stores formatted text: each render formats the rows in
+ * the viewport straight from the source. The display order is an index
+ * of source rows, built by a pipeline that new rows pass through:
+ * filter (scan), sort (bottom-up merge sort of the new rows) and merge
+ * (into the current index). Every stage can stop after any element, so
+ * the owner can spread the work over several steps. Changing the sort or
+ * filter runs the whole source through the pipeline while the old index
+ * stays on screen.
+ *
+ * Rows appended a few at a time skip the pipeline: each is inserted in
+ * place into a sorted tail of at most TABLE_TAIL_MAX rows, along with
+ * its rank, the number of index rows ahead of it. The view shows the
+ * index and the tail as one list, so an append costs a binary search of
+ * the index and a shift of the tail; the index is merged only once the
+ * tail is full.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "table_view.h"
+
+/**
+ * @enum TableStage
+ * Stages of the index pipeline.
+ */
+typedef enum {
+	TABLE_IDLE,		///< Index is up to date
+	TABLE_SCAN,		///< Filtering new rows into the tail
+	TABLE_SORT,		///< Sorting the tail
+	TABLE_MERGE,	///< Merging the tail into the index
+} TableStage;
+
+/**
+ * Orders two source rows by the sort column, ties by source position.
+ */
+static int compare_rows(TableView const* me, uint32_t a, uint32_t b) {
+	if (me->sortColumn >= 0) {
+		int c = me->source.compare(me->source.ctx, me->sortColumn, a, b);
+		if (c != 0) {
+			return me->descending ? -c : c;
+		}
+	}
+	return (a > b) - (a < b);
+}
+
+/**
+ * Grows the index buffers to hold every source row.
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+static int reserve(TableView* me, uint32_t rows) {
+	if (rows <= me->capacity) { return 0; }
+
+	uint32_t capacity = me->capacity ? me->capacity : 1024;
+	while (capacity < rows) {
+		capacity *= 2;
+	}
+	if (me->rank == NULL && (me->rank = malloc(TABLE_TAIL_MAX * sizeof(uint32_t))) == NULL) {
+		return -1;
+	}
+	uint32_t** buffers[] = { &me->index, &me->tail, &me->scratch, &me->merged };
+	for (unsigned i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+		uint32_t* grown = realloc(*buffers[i], capacity * sizeof(uint32_t));
+		if (grown == NULL) { return -1; }
+		*buffers[i] = grown;
+	}
+	me->capacity = capacity;
+	return 0;
+}
+
+/**
+ * Starts merging the next pair of runs of the tail.
+ */
+static void start_run_pair(TableView* me) {
+	uint32_t mid = me->runStart + me->runWidth;
+	me->posA = me->runStart;
+	me->posB = (mid < me->numTail) ? mid : me->numTail;
+	me->posOut = me->runStart;
+}
+
+/**
+ * Starts merging the tail into the index.
+ */
+static void start_merge(TableView* me) {
+	me->stage = TABLE_MERGE;
+	me->posA = 0;
+	me->posB = 0;
+	me->posOut = 0;
+}
+
+/**
+ * Restarts the pipeline from the first source row.
+ */
+static void restart(TableView* me) {
+	me->stage = TABLE_SCAN;
+	me->rebuild = 1;
+	me->scanned = 0;
+	me->numTail = 0;
+	me->numLive = 0;
+}
+
+/**
+ * Finds the source row shown at a position, in the index or the tail.
+ *
+ * @returns Source row
+ */
+static uint32_t row_at(TableView const* me, uint32_t pos) {
+	uint32_t lo = 0;
+	uint32_t hi = me->numLive;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		if (me->rank[mid] + mid < pos) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo < me->numLive && me->rank[lo] + lo == pos) {
+		return me->tail[lo];
+	}
+	return me->index[pos - lo];
+}
+
+/**
+ * Inserts an appended row into the sorted tail, if the filter keeps it.
+ */
+static void insert_tail(TableView* me, uint32_t row) {
+	if (me->filter != NULL && !me->filter(me->source.ctx, row, me->filterArg)) {
+		return;
+	}
+
+	uint32_t lo = 0;
+	uint32_t hi = me->numLive;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		if (compare_rows(me, me->tail[mid], row) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	uint32_t at = lo;
+
+	lo = 0;
+	hi = me->numIndexed;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		if (compare_rows(me, me->index[mid], row) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	memmove(&me->tail[at + 1], &me->tail[at], (me->numLive - at) * sizeof(uint32_t));
+	memmove(&me->rank[at + 1], &me->rank[at], (me->numLive - at) * sizeof(uint32_t));
+	me->tail[at] = row;
+	me->rank[at] = lo;
+	me->numTail = ++me->numLive;
+	if (lo + at < me->top + me->height) {
+		me->dirty = 1;
+	}
+}
+
+/**
+ * Filters new source rows into the tail.
+ *
+ * @returns Work used
+ */
+static uint32_t scan_some(TableView* me, uint32_t rows, uint32_t budget) {
+	uint32_t used = 0;
+	while (used < budget && me->scanned < rows) {
+		uint32_t row = me->scanned++;
+		if (me->filter == NULL || me->filter(me->source.ctx, row, me->filterArg)) {
+			me->tail[me->numTail++] = row;
+		}
+		used++;
+	}
+	if (me->scanned == rows) {
+		me->stage = TABLE_SORT;
+		me->runWidth = 1;
+		me->runStart = 0;
+		start_run_pair(me);
+	}
+	return used;
+}
+
+/**
+ * Merges runs of the tail, one element per unit of work.
+ *
+ * @returns Work used
+ */
+static uint32_t sort_some(TableView* me, uint32_t budget) {
+	uint32_t n = me->numTail;
+	uint32_t used = 0;
+
+	while (me->runWidth < n && used < budget) {
+		uint32_t mid = me->runStart + me->runWidth;
+		uint32_t end = mid + me->runWidth;
+		if (mid > n) { mid = n; }
+		if (end > n) { end = n; }
+
+		if (me->posA < mid && (me->posB >= end
+				|| compare_rows(me, me->tail[me->posA], me->tail[me->posB]) <= 0)) {
+			me->scratch[me->posOut++] = me->tail[me->posA++];
+		} else {
+			me->scratch[me->posOut++] = me->tail[me->posB++];
+		}
+		used++;
+
+		if (me->posOut == end) {
+			me->runStart = end;
+			if (end == n) {
+				uint32_t* sorted = me->scratch;
+				me->scratch = me->tail;
+				me->tail = sorted;
+				me->runWidth *= 2;
+				me->runStart = 0;
+			}
+			start_run_pair(me);
+		}
+	}
+	if (me->runWidth >= n) {
+		start_merge(me);
+	}
+	return used;
+}
+
+/**
+ * Merges the sorted tail into the index, one element per unit of work.
+ *
+ * @returns Work used
+ */
+static uint32_t merge_some(TableView* me, uint32_t budget) {
+	uint32_t numA = me->rebuild ? 0 : me->numIndexed;
+	uint32_t total = numA + me->numTail;
+	uint32_t used = 0;
+
+	while (me->posOut < total && used < budget) {
+		if (me->posA < numA && (me->posB >= me->numTail
+				|| compare_rows(me, me->index[me->posA], me->tail[me->posB]) <= 0)) {
+			me->merged[me->posOut++] = me->index[me->posA++];
+		} else {
+			me->merged[me->posOut++] = me->tail[me->posB++];
+		}
+		used++;
+	}
+	if (me->posOut == total) {
+		uint32_t* done = me->merged;
+		me->merged = me->index;
+		me->index = done;
+		me->numIndexed = total;
+		me->numTail = 0;
+		me->numLive = 0;
+		me->rebuild = 0;
+		me->stage = TABLE_IDLE;
+		TableView_moveCursor(me, 0);
+		me->dirty = 1;
+	}
+	return used;
+}
+
+/**
+ * Appends @p count characters of @p text, clipped to the viewport.
+ *
+ * @returns New line length
+ */
+static int append(TableView const* me, char* line, int len, char const* text, int count) {
+	for (int i = 0; i < count && len < me->width; i++) {
+		line[len++] = text[i];
+	}
+	return len;
+}
+
+/**
+ * Appends one cell, padded to its column width.
+ *
+ * @returns New line length
+ */
+static int append_cell(TableView* me, char* line, int len, uint32_t row, int column) {
+	char cell[MAX_SCREEN_WIDTH];
+	int width = me->columns[column].width;
+	int count = 0;
+
+	if (row == TABLE_NO_ROW) {
+		count = strnlen(me->columns[column].title, TABLE_TITLE_LEN);
+		if (count > width) { count = width; }
+		memcpy(cell, me->columns[column].title, count);
+	} else {
+		count = me->source.format(me->source.ctx, row, column, cell, width);
+		if (count < 0) { count = 0; }
+		if (count > width) { count = width; }
+	}
+	memset(&cell[count], ' ', width - count);
+	len = append(me, line, len, cell, width);
+	return append(me, line, len, " ", 1);
+}
+
+/**
+ * Creates an empty view.
+ *
+ * @param[out] me	  View
+ * @param[in]  source Data behind the table
+ * @param[in]  width  Viewport width
+ * @param[in]  height Viewport height, including the header
+ */
+void TableView_init(TableView* me, TableSource const* source, uint16_t width, uint16_t height) {
+	memset(me, 0, sizeof(TableView));
+	me->source = *source;
+	me->sortColumn = -1;
+	me->stage = TABLE_IDLE;
+	me->dirty = 1;
+	TableView_resize(me, width, height);
+}
+
+/**
+ * Releases the index buffers.
+ *
+ * @param[in,out] me View
+ */
+void TableView_free(TableView* me) {
+	free(me->index);
+	free(me->tail);
+	free(me->scratch);
+	free(me->merged);
+	free(me->rank);
+	me->index = me->tail = me->scratch = me->merged = me->rank = NULL;
+	me->capacity = 0;
+	me->numIndexed = 0;
+	restart(me);
+	me->stage = TABLE_IDLE;
+}
+
+/**
+ * Appends a column.
+ *
+ * @param[in,out] me	View
+ * @param[in]	  title	Header text
+ * @param[in]	  width	Width in characters
+ *
+ * @returns Column index, or -1 if the table is full
+ */
+int TableView_addColumn(TableView* me, char const* title, uint16_t width) {
+	if (me->numColumns == TABLE_MAX_COLUMNS) {
+		return -1;
+	}
+	TableColumn* column = &me->columns[me->numColumns];
+	strncpy(column->title, title, TABLE_TITLE_LEN);
+	column->width = 0;
+	me->dirty = 1;
+	TableView_resizeColumn(me, me->numColumns, width);
+	return me->numColumns++;
+}
+
+/**
+ * Widens or narrows a column.
+ *
+ * @param[in,out] me	 View
+ * @param[in]	  column Column index
+ * @param[in]	  delta	 Characters to add, negative to remove
+ */
+void TableView_resizeColumn(TableView* me, int column, int delta) {
+	if (column < 0 || column >= TABLE_MAX_COLUMNS) { return; }
+	int width = me->columns[column].width + delta;
+	if (width < 1) { width = 1; }
+	if (width > MAX_SCREEN_WIDTH - 2) { width = MAX_SCREEN_WIDTH - 2; }
+	me->columns[column].width = width;
+	me->dirty = 1;
+}
+
+/**
+ * Sets the viewport size, e.g. after the section was reconfigured.
+ *
+ * @param[in,out] me	 View
+ * @param[in]	  width	 Viewport width
+ * @param[in]	  height Viewport height, including the header
+ */
+void TableView_resize(TableView* me, uint16_t width, uint16_t height) {
+	me->width = (width < MAX_SCREEN_WIDTH) ? width : MAX_SCREEN_WIDTH;
+	me->height = height;
+	me->dirty = 1;
+	TableView_moveCursor(me, 0);
+}
+
+/**
+ * Changes the display order. The index is rebuilt by TableView_step().
+ *
+ * @param[in,out] me		 View
+ * @param[in]	  column	 Sort column, or -1 for source order
+ * @param[in]	  descending Non-zero for descending order
+ */
+void TableView_sortBy(TableView* me, int column, int descending) {
+	if (column >= me->numColumns) { return; }
+	me->sortColumn = column;
+	me->descending = (descending != 0);
+	restart(me);
+}
+
+/**
+ * Changes which rows are shown. The index is rebuilt by TableView_step().
+ *
+ * @param[in,out] me	 View
+ * @param[in]	  filter Row filter, or NULL to show every row
+ * @param[in]	  arg	 Passed to @p filter
+ */
+void TableView_setFilter(TableView* me, TableFilter filter, void* arg) {
+	me->filter = filter;
+	me->filterArg = arg;
+	restart(me);
+}
+
+/**
+ * Brings the index up to date with the source, a bounded amount at a time.
+ * Appends that fit in the tail are inserted in place; larger batches,
+ * and a full tail, go through the pipeline.
+ *
+ * @param[in,out] me	 View
+ * @param[in]	  budget Rows to process before returning
+ *
+ * @returns Non-zero if work remains
+ */
+int TableView_step(TableView* me, uint32_t budget) {
+	uint32_t rows = me->source.numRows(me->source.ctx);
+	if (me->stage == TABLE_IDLE && me->scanned >= rows) {
+		return 0;
+	}
+	if (reserve(me, rows) != 0) {
+		return 0;
+	}
+
+	while (budget > 0) {
+		uint32_t used = 0;
+		switch (me->stage) {
+		case TABLE_IDLE:
+			if (me->scanned >= rows) {
+				budget = 0;
+			} else if (me->numLive + (rows - me->scanned) <= TABLE_TAIL_MAX) {
+				insert_tail(me, me->scanned++);
+				used = 1;
+			} else if (me->numLive > 0) {
+				start_merge(me);
+			} else {
+				me->stage = TABLE_SCAN;
+			}
+			break;
+		case TABLE_SCAN:  used = scan_some(me, rows, budget); break;
+		case TABLE_SORT:  used = sort_some(me, budget); break;
+		case TABLE_MERGE: used = merge_some(me, budget); break;
+		}
+		budget -= (used < budget) ? used : budget;
+	}
+	return me->stage != TABLE_IDLE || me->scanned < rows;
+}
+
+/**
+ * Moves the cursor, scrolling the viewport to keep it visible.
+ *
+ * @param[in,out] me	View
+ * @param[in]	  delta	Rows to move, negative to move up
+ */
+void TableView_moveCursor(TableView* me, int32_t delta) {
+	uint32_t visible = (me->height > 1) ? me->height - 1 : 0;
+	int64_t cursor = (int64_t)me->cursor + delta;
+	if (cursor >= (int64_t)TableView_numShown(me)) { cursor = (int64_t)TableView_numShown(me) - 1; }
+	if (cursor < 0) { cursor = 0; }
+
+	if ((uint32_t)cursor != me->cursor) {
+		me->cursor = cursor;
+		me->dirty = 1;
+	}
+	if (me->cursor < me->top) {
+		me->top = me->cursor;
+		me->dirty = 1;
+	} else if (visible > 0 && me->cursor >= me->top + visible) {
+		me->top = me->cursor - visible + 1;
+		me->dirty = 1;
+	}
+}
+
+/**
+ * @param[in] me View
+ *
+ * @returns Number of rows shown, in the index and the tail
+ */
+uint32_t TableView_numShown(TableView const* me) {
+	return me->numIndexed + me->numLive;
+}
+
+/**
+ * @param[in] me View
+ *
+ * @returns Source row under the cursor, or @ref TABLE_NO_ROW if the table is empty
+ */
+uint32_t TableView_selected(TableView const* me) {
+	return (me->cursor < TableView_numShown(me)) ? row_at(me, me->cursor) : TABLE_NO_ROW;
+}
+
+/**
+ * Formats the header and the rows in the viewport, if anything changed.
+ *
+ * @param[in,out] me   View
+ * @param[in]	  line Called for every line of the viewport
+ * @param[in]	  arg  Passed to @p line
+ *
+ * @returns Number of lines rendered
+ */
+int TableView_render(TableView* me, TableLineCb line, void* arg) {
+	char text[MAX_SCREEN_WIDTH + 1];
+
+	if (!me->dirty) { return 0; }
+	for (int y = 0; y < me->height; y++) {
+		uint32_t pos = me->top + y - 1;
+		int len = 0;
+		if (y == 0) {
+			len = append(me, text, len, " ", 1);
+			for (int c = 0; c < me->numColumns; c++) {
+				len = append_cell(me, text, len, TABLE_NO_ROW, c);
+			}
+		} else if (pos < TableView_numShown(me)) {
+			uint32_t row = row_at(me, pos);
+			len = append(me, text, len, (pos == me->cursor) ? ">" : " ", 1);
+			for (int c = 0; c < me->numColumns; c++) {
+				len = append_cell(me, text, len, row, c);
+			}
+		}
+		memset(&text[len], ' ', me->width - len);
+		text[me->width] = '\0';
+		line(y, text, arg);
+	}
+	me->dirty = 0;
+	return me->height;
+}
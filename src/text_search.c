@@ -0,0 +1,180 @@
+/**
+ * @file text_search.c
+ * Search of the text drawn in a layer.
+ *
+ * Rows are scanned with the vector find kernel, which compares the
+ * query's first and last bytes across a whole row at once and looks
+ * closer only where both match. A row's matches stay valid until the
+ * layer changes the row or the query changes. Typing adds to the query,
+ * and a row without a match cannot match a longer query, so each key
+ * typed scans only the rows that matched before or changed since.
+ * The module is QP-free; its owner decides when rows are repainted.
+ */
+
+#include <string.h>
+
+#include "cell_kernels.h"
+#include "text_search.h"
+
+/**
+ * Finds the matches of the query in one row.
+ *
+ * @param[in]  me	 Search
+ * @param[in]  layer Layer to read
+ * @param[in]  y	 Row
+ * @param[out] mask	 Matched cells
+ *
+ * @returns Number of matches
+ */
+static int scan_row(TextSearch const* me, RenderLayer const* layer, int y, uint32_t mask[SEARCH_MASK_WORDS]) {
+	char row[MAX_SCREEN_WIDTH];
+	int hits = 0;
+	memset(mask, 0, SEARCH_MASK_WORDS * sizeof(mask[0]));
+	if (me->length == 0) {
+		return 0;
+	}
+
+	int col = 0;
+	while (col < MAX_SCREEN_WIDTH) {
+		int len;
+		char const* cells = Layer_span(layer, col, y, &len);
+		if (cells != NULL) {
+			memcpy(&row[col], cells, len);
+		} else {
+			memset(&row[col], '\0', len);
+		}
+		col += len;
+	}
+
+	size_t from = 0;
+	while (from + me->length <= MAX_SCREEN_WIDTH) {
+		size_t at = from + Cells_find(&row[from], MAX_SCREEN_WIDTH - from, me->query, me->length);
+		if (at == MAX_SCREEN_WIDTH) { break; }
+		for (size_t x = at; x < at + me->length; x++) {
+			mask[x / 32] |= 1U << (x % 32);
+		}
+		hits++;
+		from = at + 1;
+	}
+	return hits;
+}
+
+/**
+ * Scans a row again and records its matches.
+ *
+ * @returns Non-zero if the row's highlight changed
+ */
+static int update_row(TextSearch* me, RenderLayer const* layer, int y) {
+	uint32_t mask[SEARCH_MASK_WORDS];
+	int hits = scan_row(me, layer, y, mask);
+	int changed = memcmp(mask, me->mask[y], sizeof(mask)) != 0;
+	memcpy(me->mask[y], mask, sizeof(mask));
+	me->hits[y] = (hits > UINT8_MAX) ? UINT8_MAX : (uint8_t)hits;
+	me->scanned[y] = layer->rowVersion[y];
+	return changed;
+}
+
+/**
+ * Initializes an empty search.
+ *
+ * @param[out] me Search
+ */
+void TextSearch_init(TextSearch* me) {
+	memset(me, 0, sizeof(TextSearch));
+}
+
+/**
+ * Changes the query and finds its matches. Rows whose highlight changed
+ * are touched, so the painter repaints them.
+ *
+ * @param[in,out] me	  Search
+ * @param[in,out] layer	  Layer to search
+ * @param[in]	  query	  Query, empty to clear the highlight
+ * @param[in]	  len	  Length of @p query, clipped to SEARCH_MAX_QUERY - 1
+ * @param[out]	  topEdge Topmost row whose highlight changed
+ * @param[out]	  botEdge Bottom-most row whose highlight changed, above @p topEdge if none did
+ *
+ * @returns Number of matches
+ */
+int TextSearch_setQuery(TextSearch* me, RenderLayer* layer, char const* query, int len, int* topEdge, int* botEdge) {
+	if (len > SEARCH_MAX_QUERY - 1) {
+		len = SEARCH_MAX_QUERY - 1;
+	}
+	int extends = len >= me->length && memcmp(query, me->query, me->length) == 0;
+	int same = extends && len == me->length;
+	extends = extends && me->length > 0;
+	memcpy(me->query, query, len);
+	me->query[len] = '\0';
+	me->length = (uint8_t)len;
+
+	*topEdge = MAX_SCREEN_HEIGHT;
+	*botEdge = -1;
+	for (int y = 0; y < MAX_SCREEN_HEIGHT; y++) {
+		if (me->scanned[y] == layer->rowVersion[y] && (same || (extends && me->hits[y] == 0))) {
+			continue;
+		}
+		if (update_row(me, layer, y)) {
+			Layer_touch(layer, y, y);
+			me->scanned[y] = layer->rowVersion[y];
+			if (y < *topEdge) { *topEdge = y; }
+			*botEdge = y;
+		}
+	}
+	return TextSearch_count(me);
+}
+
+/**
+ * Gives the highlight of a row, scanning it again first if the layer
+ * changed it since the last scan.
+ *
+ * @param[in,out] me	Search
+ * @param[in]	  layer	Layer searched
+ * @param[in]	  y		Row
+ *
+ * @returns Matched cells, a bit per cell
+ */
+uint32_t const* TextSearch_row(TextSearch* me, RenderLayer const* layer, int y) {
+	if (me->scanned[y] != layer->rowVersion[y]) {
+		update_row(me, layer, y);
+	}
+	return me->mask[y];
+}
+
+/**
+ * Gives the highlight of a whole row from scratch: the row is set to
+ * normal video, then every run of matched cells to reverse video. A
+ * repaint of part of a row thus cannot leave a stale highlight, or half
+ * of a match, outside the part painted.
+ *
+ * @param[in,out] me	Search
+ * @param[in]	  layer	Layer searched
+ * @param[in]	  y		Row
+ * @param[in]	  attr	Called for the row, then for each run of matches
+ * @param[in]	  arg	Passed to @p attr
+ */
+void TextSearch_highlight(TextSearch* me, RenderLayer const* layer, int y, SearchAttrCb attr, void* arg) {
+	uint32_t const* mask = TextSearch_row(me, layer, y);
+	attr(y, 0, MAX_SCREEN_WIDTH, 0, arg);
+	int col = 0;
+	while (col < MAX_SCREEN_WIDTH) {
+		if (!(mask[col / 32] & (1U << (col % 32)))) {
+			col++;
+			continue;
+		}
+		int run = col;
+		while (run < MAX_SCREEN_WIDTH && (mask[run / 32] & (1U << (run % 32)))) { run++; }
+		attr(y, col, run - col, 1, arg);
+		col = run;
+	}
+}
+
+/**
+ * @returns Matches found by the latest scan of every row
+ */
+int TextSearch_count(TextSearch const* me) {
+	int count = 0;
+	for (int y = 0; y < MAX_SCREEN_HEIGHT; y++) {
+		count += me->hits[y];
+	}
+	return count;
+}
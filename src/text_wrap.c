@@ -0,0 +1,547 @@
+/**
+ * @file text_wrap.c
+ * Word-wrapped text widget.
+ *
+ * Lines are broken greedily: as many words as fit, a word longer than
+ * the width being split. Breaks are kept per paragraph as line start
+ * offsets. A greedy break depends only on the text within one width of
+ * the line start, so appending to a paragraph only rewraps its last
+ * line, and editing one only rewraps that paragraph. The line counts of
+ * all paragraphs sit in a Fenwick tree, which turns a document line into
+ * a paragraph and back and absorbs a count change in O(log n), so no
+ * edit walks the document. Changing the width rewraps the paragraphs in
+ * view at once, so the viewport keeps showing the same text, and leaves
+ * the others to WrapText_step(); each paragraph records the width it is
+ * wrapped at, and one found stale by an edit is rewrapped whole.
+ * Searches run over the paragraphs' text with the vector find kernel,
+ * so matches that cross a wrapped line are found too.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell_kernels.h"
+#include "text_wrap.h"
+
+/**
+ * Grows an array to hold at least @p needed elements.
+ *
+ * @param[in,out] array	   Array, may be NULL
+ * @param[in,out] capacity Elements the array holds
+ * @param[in]	  needed   Elements required
+ * @param[in]	  size	   Size of an element
+ * @param[in]	  initial  Capacity of a new array
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+static int reserve(void** array, uint32_t* capacity, uint32_t needed, size_t size, uint32_t initial) {
+	if (needed <= *capacity) { return 0; }
+
+	uint32_t grown = *capacity ? *capacity : initial;
+	while (grown < needed) {
+		grown *= 2;
+	}
+	void* data = realloc(*array, (size_t)grown * size);
+	if (data == NULL) { return -1; }
+	*array = data;
+	*capacity = grown;
+	return 0;
+}
+
+/**
+ * Adds to the line count of a paragraph.
+ */
+static void tree_add(WrapText* me, uint32_t para, int32_t delta) {
+	for (uint32_t i = para + 1; i <= me->numParas; i += i & (0U - i)) {
+		me->tree[i] += (uint32_t)delta;
+	}
+}
+
+/**
+ * @returns Lines in the first @p n paragraphs
+ */
+static uint32_t tree_prefix(WrapText const* me, uint32_t n) {
+	uint32_t sum = 0;
+	for (uint32_t i = n; i > 0; i -= i & (0U - i)) {
+		sum += me->tree[i];
+	}
+	return sum;
+}
+
+/**
+ * Enters the line count of the paragraph just added at the end.
+ */
+static void tree_push(WrapText* me, uint32_t count) {
+	uint32_t i = me->numParas;
+	me->tree[i] = count + tree_prefix(me, i - 1) - tree_prefix(me, i - (i & (0U - i)));
+}
+
+/**
+ * Finds the paragraph holding a document line.
+ *
+ * @param[in]  me	View, with at least one paragraph
+ * @param[in]  line Document line, below @ref WrapText::numLines
+ * @param[out] rem	Line within the paragraph
+ *
+ * @returns Paragraph
+ */
+static uint32_t tree_find(WrapText const* me, uint32_t line, uint32_t* rem) {
+	uint32_t pos = 0;
+	for (uint32_t step = 1U << (31 - __builtin_clz(me->numParas)); step > 0; step >>= 1) {
+		if (pos + step <= me->numParas && me->tree[pos + step] <= line) {
+			pos += step;
+			line -= me->tree[pos];
+		}
+	}
+	*rem = line;
+	return pos;
+}
+
+/**
+ * Breaks a paragraph into lines from one of its lines onward; the lines
+ * before it are kept. If the break list cannot grow, the rest of the
+ * paragraph stays on the last line and is clipped when rendered.
+ *
+ * @param[in,out] p		Paragraph
+ * @param[in]	  first Line whose start offset is known
+ * @param[in]	  width Wrap width
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+static int wrap_from(WrapParagraph* p, uint32_t first, uint16_t width) {
+	uint32_t pos = p->lines[first];
+	uint32_t n = first + 1;
+
+	while (p->length - pos > width) {
+		uint32_t end = pos + width;
+		uint32_t brk = end;
+		while (brk > pos && p->text[brk] != ' ') {
+			brk--;
+		}
+		uint32_t next = (brk > pos) ? brk : end;
+		while (next < p->length && p->text[next] == ' ') {
+			next++;
+		}
+		if (next >= p->length) {
+			break;
+		}
+		if (reserve((void **)&p->lines, &p->lineCapacity, n + 1, sizeof(uint32_t), 4) != 0) {
+			p->numLines = n;
+			return -1;
+		}
+		p->lines[n++] = next;
+		pos = next;
+	}
+	p->numLines = n;
+	return 0;
+}
+
+/**
+ * Adds an empty paragraph at the end.
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+static int add_paragraph(WrapText* me) {
+	uint32_t capacity = me->capacity;
+	if (reserve((void **)&me->paras, &capacity, me->numParas + 1, sizeof(WrapParagraph), 64) != 0) {
+		return -1;
+	}
+	if (capacity != me->capacity) {
+		uint32_t* tree = realloc(me->tree, (capacity + 1) * sizeof(uint32_t));
+		if (tree == NULL) { return -1; }
+		me->tree = tree;
+		me->capacity = capacity;
+	}
+
+	WrapParagraph* p = &me->paras[me->numParas];
+	memset(p, 0, sizeof(*p));
+	if (reserve((void **)&p->lines, &p->lineCapacity, 1, sizeof(uint32_t), 4) != 0) {
+		return -1;
+	}
+	p->lines[0] = 0;
+	p->numLines = 1;
+	p->width = me->width;
+	me->numParas++;
+	tree_push(me, 1);
+	me->numLines++;
+	return 0;
+}
+
+/**
+ * Rewraps a paragraph from one of its lines and enters the change in line count.
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+static int rewrap(WrapText* me, uint32_t para, uint32_t first, int32_t* delta) {
+	WrapParagraph* p = &me->paras[para];
+	uint32_t old = p->numLines;
+	if (p->width != me->width) {
+		first = 0;
+		p->width = me->width;
+	}
+	int rc = wrap_from(p, first, me->width);
+	*delta = (int32_t)(p->numLines - old);
+	tree_add(me, para, *delta);
+	me->numLines += (uint32_t)*delta;
+	return rc;
+}
+
+/**
+ * @returns Largest top line that still fills the viewport
+ */
+static uint32_t max_top(WrapText const* me) {
+	return (me->numLines > me->height) ? me->numLines - me->height : 0;
+}
+
+/**
+ * Keeps the viewport within the document, and on the last line while following.
+ */
+static void clamp_top(WrapText* me) {
+	if (me->follow || me->top > max_top(me)) {
+		me->top = max_top(me);
+	}
+}
+
+/**
+ * Initializes an empty document.
+ *
+ * @param[out] me	  View
+ * @param[in]  width  Viewport and wrap width
+ * @param[in]  height Viewport height
+ */
+void WrapText_init(WrapText* me, uint16_t width, uint16_t height) {
+	memset(me, 0, sizeof(*me));
+	me->width = (width < 1) ? 1 : (width > MAX_SCREEN_WIDTH) ? MAX_SCREEN_WIDTH : width;
+	me->height = height;
+	me->follow = 1;
+	me->dirty = 1;
+}
+
+/**
+ * Releases the document.
+ *
+ * @param[in,out] me View
+ */
+void WrapText_free(WrapText* me) {
+	for (uint32_t i = 0; i < me->numParas; i++) {
+		free(me->paras[i].text);
+		free(me->paras[i].lines);
+	}
+	free(me->paras);
+	free(me->tree);
+	WrapText_init(me, me->width, me->height);
+}
+
+/**
+ * Appends text to the document. Text up to the first newline extends the
+ * last paragraph, and every newline starts a new one. Costs time in
+ * proportion to @p len, plus the last line of the extended paragraph.
+ *
+ * @param[in,out] me   View
+ * @param[in]	  text Text
+ * @param[in]	  len  Bytes in @p text
+ *
+ * @returns 0 on success, -1 if out of memory
+ */
+int WrapText_append(WrapText* me, char const* text, uint32_t len) {
+	uint32_t oldTop = me->top;
+	uint32_t firstChanged = me->numLines ? me->numLines - 1 : 0;
+	int rc = 0;
+
+	if (me->numParas == 0 && add_paragraph(me) != 0) {
+		return -1;
+	}
+	for (uint32_t start = 0; rc == 0; ) {
+		char const* nl = memchr(&text[start], '\n', len - start);
+		uint32_t end = nl ? (uint32_t)(nl - text) : len;
+		uint32_t para = me->numParas - 1;
+		WrapParagraph* p = &me->paras[para];
+
+		if (end > start) {
+			if (reserve((void **)&p->text, &p->capacity, p->length + (end - start), 1, 64) != 0) {
+				rc = -1;
+				break;
+			}
+			memcpy(&p->text[p->length], &text[start], end - start);
+			p->length += end - start;
+			int32_t delta;
+			rc = rewrap(me, para, p->numLines - 1, &delta);
+		}
+		if (rc != 0 || end == len) {
+			break;
+		}
+		rc = add_paragraph(me);
+		start = end + 1;
+	}
+
+	clamp_top(me);
+	if (me->top != oldTop || firstChanged < me->top + me->height) {
+		me->dirty = 1;
+	}
+	return rc;
+}
+
+/**
+ * Replaces the text of a paragraph; newlines in @p text become spaces.
+ * Only that paragraph is rewrapped. If it lies above the viewport, the
+ * viewport moves with its line count so the same text stays in view.
+ *
+ * @param[in,out] me   View
+ * @param[in]	  para Paragraph
+ * @param[in]	  text New text
+ * @param[in]	  len  Bytes in @p text
+ *
+ * @returns 0 on success, -1 if the paragraph does not exist or out of memory
+ */
+int WrapText_edit(WrapText* me, uint32_t para, char const* text, uint32_t len) {
+	if (para >= me->numParas) { return -1; }
+
+	WrapParagraph* p = &me->paras[para];
+	if (reserve((void **)&p->text, &p->capacity, len, 1, 64) != 0) {
+		return -1;
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		p->text[i] = (text[i] == '\n') ? ' ' : text[i];
+	}
+	p->length = len;
+
+	uint32_t first = tree_prefix(me, para);
+	uint32_t old = p->numLines;
+	int32_t delta;
+	int rc = rewrap(me, para, 0, &delta);
+
+	uint32_t oldTop = me->top;
+	if (first + old <= me->top) {
+		me->top += (uint32_t)delta;
+		oldTop = me->top;
+	} else if (first < me->top + me->height) {
+		me->dirty = 1;
+	}
+	clamp_top(me);
+	if (me->top != oldTop) {
+		me->dirty = 1;
+	}
+	return rc;
+}
+
+/**
+ * Rewraps a stale paragraph at the current width, moving the viewport
+ * with its line count if it lies above it.
+ */
+static void reflow_paragraph(WrapText* me, uint32_t para) {
+	if (me->paras[para].width == me->width) { return; }
+
+	uint32_t first = tree_prefix(me, para);
+	uint32_t old = me->paras[para].numLines;
+	int32_t delta;
+	rewrap(me, para, 0, &delta);
+	if (first + old <= me->top) {
+		me->top += (uint32_t)delta;
+	} else if (first < me->top + me->height) {
+		me->dirty = 1;
+	}
+}
+
+/**
+ * Resizes the viewport. A new width rewraps the paragraphs that fill the
+ * viewport, keeping the text at its top in view, or its last lines while
+ * following; the rest of the document is rewrapped by WrapText_step().
+ *
+ * @param[in,out] me	 View
+ * @param[in]	  width	 Viewport and wrap width
+ * @param[in]	  height Viewport height
+ */
+void WrapText_resize(WrapText* me, uint16_t width, uint16_t height) {
+	width = (width < 1) ? 1 : (width > MAX_SCREEN_WIDTH) ? MAX_SCREEN_WIDTH : width;
+	me->height = height;
+	if (width != me->width && me->numParas > 0) {
+		uint32_t offset;
+		uint32_t para = WrapText_locate(me, me->top, &offset);
+		uint32_t lines = 0;
+		me->width = width;
+		me->reflow = 0;
+		if (me->follow) {
+			for (uint32_t i = me->numParas; i > 0 && lines < height; i--) {
+				reflow_paragraph(me, i - 1);
+				lines += me->paras[i - 1].numLines;
+			}
+		} else {
+			for (uint32_t i = para; i < me->numParas && lines < height + me->paras[para].numLines; i++) {
+				reflow_paragraph(me, i);
+				lines += me->paras[i].numLines;
+			}
+			me->top = WrapText_lineOf(me, para, offset);
+		}
+	}
+	me->width = width;
+	clamp_top(me);
+	me->dirty = 1;
+}
+
+/**
+ * Rewraps a bounded number of paragraphs left stale by a width change.
+ *
+ * @param[in,out] me	 View
+ * @param[in]	  budget Paragraphs to look at before returning
+ *
+ * @returns Non-zero if stale paragraphs remain
+ */
+int WrapText_step(WrapText* me, uint32_t budget) {
+	uint32_t oldTop = me->top;
+	while (me->reflow < me->numParas && budget-- > 0) {
+		reflow_paragraph(me, me->reflow++);
+	}
+	clamp_top(me);
+	if (me->top != oldTop) {
+		me->dirty = 1;
+	}
+	return me->reflow < me->numParas;
+}
+
+/**
+ * Scrolls the viewport, within the document. Scrolling to the last line
+ * follows appended text; scrolling up stops following.
+ *
+ * @param[in,out] me	View
+ * @param[in]	  delta Lines, negative to scroll up
+ */
+void WrapText_scroll(WrapText* me, int32_t delta) {
+	int64_t top = (int64_t)me->top + delta;
+	if (top < 0) {
+		top = 0;
+	} else if (top > max_top(me)) {
+		top = max_top(me);
+	}
+	me->follow = ((uint32_t)top == max_top(me));
+	if ((uint32_t)top != me->top) {
+		me->top = (uint32_t)top;
+		me->dirty = 1;
+	}
+}
+
+/**
+ * Maps a document line to the text it starts at.
+ *
+ * @param[in]  me	  View
+ * @param[in]  line	  Document line, clamped to the last one
+ * @param[out] offset Offset of the line within its paragraph
+ *
+ * @returns Paragraph, 0 for an empty document
+ */
+uint32_t WrapText_locate(WrapText const* me, uint32_t line, uint32_t* offset) {
+	uint32_t rem;
+	if (me->numParas == 0) {
+		*offset = 0;
+		return 0;
+	}
+	if (line >= me->numLines) {
+		line = me->numLines - 1;
+	}
+	uint32_t para = tree_find(me, line, &rem);
+	*offset = me->paras[para].lines[rem];
+	return para;
+}
+
+/**
+ * Maps a position in the text to the document line showing it.
+ *
+ * @param[in] me	 View
+ * @param[in] para	 Paragraph, clamped to the last one
+ * @param[in] offset Offset within the paragraph
+ *
+ * @returns Document line, 0 for an empty document
+ */
+uint32_t WrapText_lineOf(WrapText const* me, uint32_t para, uint32_t offset) {
+	if (me->numParas == 0) { return 0; }
+	if (para >= me->numParas) {
+		para = me->numParas - 1;
+	}
+
+	WrapParagraph const* p = &me->paras[para];
+	uint32_t lo = 0;
+	uint32_t hi = p->numLines;
+	while (hi - lo > 1) {
+		uint32_t mid = (lo + hi) / 2;
+		if (p->lines[mid] <= offset) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return tree_prefix(me, para) + lo;
+}
+
+/**
+ * Finds the next occurrence of a string, at or after a position.
+ * Matches do not span paragraphs; map one to a line with WrapText_lineOf().
+ *
+ * @param[in]	  me	 View
+ * @param[in]	  needle String to find
+ * @param[in]	  len	 Length of @p needle, at least 1
+ * @param[in,out] para	 Paragraph to start in; paragraph of the match
+ * @param[in,out] offset Offset to start at; offset of the match
+ *
+ * @returns 0 if found, -1 if the rest of the document does not contain @p needle
+ */
+int WrapText_find(WrapText const* me, char const* needle, uint32_t len, uint32_t* para, uint32_t* offset) {
+	uint32_t from = *offset;
+	for (uint32_t i = *para; i < me->numParas; i++, from = 0) {
+		WrapParagraph const* p = &me->paras[i];
+		if (from + len > p->length) { continue; }
+		size_t at = Cells_find(&p->text[from], p->length - from, needle, len);
+		if (at < p->length - from) {
+			*para = i;
+			*offset = from + (uint32_t)at;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Renders the lines in the viewport, if anything changed.
+ * Finding the top line costs O(log n); every other line is the next one
+ * of the same or the following paragraph.
+ *
+ * @param[in,out] me   View
+ * @param[in]	  line Called for every line of the viewport
+ * @param[in]	  arg  Passed to @p line
+ *
+ * @returns Number of lines rendered
+ */
+int WrapText_render(WrapText* me, WrapLineCb line, void* arg) {
+	char text[MAX_SCREEN_WIDTH + 1];
+	uint32_t para = me->numParas;
+	uint32_t k = 0;
+
+	if (!me->dirty) { return 0; }
+	if (me->numLines > 0) {
+		para = tree_find(me, me->top, &k);
+	}
+	for (int y = 0; y < me->height; y++) {
+		uint32_t len = 0;
+		if (para < me->numParas) {
+			WrapParagraph const* p = &me->paras[para];
+			uint32_t start = p->lines[k];
+			uint32_t end = (k + 1 < p->numLines) ? p->lines[k + 1] : p->length;
+			while (end > start && p->text[end - 1] == ' ') {
+				end--;
+			}
+			len = (end - start < me->width) ? end - start : me->width;
+			if (len > 0) {
+				memcpy(text, &p->text[start], len);
+			}
+			if (++k == p->numLines) {
+				para++;
+				k = 0;
+			}
+		}
+		memset(&text[len], ' ', me->width - len);
+		text[me->width] = '\0';
+		line(y, text, arg);
+	}
+	me->dirty = 0;
+	return me->height;
+}
@@ -0,0 +1,272 @@
+/**
+ * @file ticker.c
+ * Tickless QF clock.
+ *
+ * Replaces the port's fixed-rate ticker thread. Between ticks the thread
+ * sleeps until the nearest armed time event expires or input arrives,
+ * then fast-forwards the timer counters so every time event still expires
+ * on the same tick it would have with a free-running clock.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+#if BSP_TICKLESS
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qf_pkg.h"
+
+/**Nanoseconds per second.*/
+#define NSEC_PER_SEC 1000000000L
+/**Length of one QF tick in nanoseconds.*/
+#define TICK_NSEC (NSEC_PER_SEC / BSP_TICKS_PER_SEC)
+
+static pthread_t l_thread;					///< Ticker thread
+static volatile int l_running;				///< Cleared to stop the thread
+static int l_wakePipe[2] = { -1, -1 };		///< Self-pipe used by Ticker_wake()
+static int l_inputs[TICKER_MAX_INPUTS];		///< Watched input descriptors
+static int l_numInputs;						///< Number of watched inputs
+static QTimeEvt const *l_gated[TICKER_MAX_GATED]; ///< Input-gated time events
+static int l_numGated;						///< Number of gated time events
+static int l_grace;							///< Remaining input grace ticks
+
+/**
+ * Checks whether a time event only needs to run while input is pending.
+ *
+ * @param[in] t Time event
+ *
+ * @returns 1 if gated, 0 otherwise
+ */
+static int is_gated(QTimeEvt const * t) {
+	if (l_grace > 0) { return 0; }
+	for (int i = 0; i < l_numGated; i++) {
+		if (l_gated[i] == t) { return 1; }
+	}
+	return 0;
+}
+
+/**
+ * Visits every armed time event at tick rate 0, including those armed
+ * since the last tick. Must be called inside a critical section.
+ *
+ * @param[in] visit Visitor, called with each armed time event
+ * @param[in] arg	Visitor argument
+ */
+static void for_each_armed(void (*visit)(QTimeEvt* t, void* arg), void* arg) {
+	for (QTimeEvt* t = QF_timeEvtHead_[0].next; t != (QTimeEvt *)0; t = t->next) {
+		if (t->ctr != 0U) { visit(t, arg); }
+	}
+	for (QTimeEvt* t = (QTimeEvt *)QF_timeEvtHead_[0].act; t != (QTimeEvt *)0; t = t->next) {
+		if (t->ctr != 0U) { visit(t, arg); }
+	}
+}
+
+/**
+ * Tracks the smallest counter of a non-gated time event.
+ */
+static void visit_deadline(QTimeEvt* t, void* arg) {
+	QTimeEvtCtr* min = (QTimeEvtCtr *)arg;
+	if (!is_gated(t) && (*min == 0U || t->ctr < *min)) {
+		*min = t->ctr;
+	}
+}
+
+/**
+ * Skips a time event ahead by all but the final elapsed tick.
+ */
+static void visit_advance(QTimeEvt* t, void* arg) {
+	QTimeEvtCtr skip = *(QTimeEvtCtr *)arg;
+	if (t->ctr > skip) {
+		t->ctr -= skip;
+	} else {
+		t->ctr = 1U; // expired while asleep, fire once on the real tick
+	}
+}
+
+/**
+ * Finds the nearest deadline.
+ *
+ * @returns Ticks until the next non-gated time event expires, 0 if none armed
+ */
+static QTimeEvtCtr next_deadline(void) {
+	QTimeEvtCtr min = 0U;
+	QF_CRIT_STAT_
+	QF_CRIT_ENTRY_();
+	for_each_armed(&visit_deadline, &min);
+	QF_CRIT_EXIT_();
+	return min;
+}
+
+/**
+ * Processes several elapsed ticks with a single QF tick.
+ *
+ * @param[in] ticks Number of elapsed ticks (at least 1)
+ */
+static void advance(QTimeEvtCtr ticks) {
+	QTimeEvtCtr skip = ticks - 1U;
+	if (skip != 0U) {
+		QF_CRIT_STAT_
+		QF_CRIT_ENTRY_();
+		for_each_armed(&visit_advance, &skip);
+		QF_CRIT_EXIT_();
+	}
+	QF_onClockTick();
+	if (l_grace > 0) {
+		l_grace = (l_grace > (int)ticks) ? l_grace - (int)ticks : 0;
+	}
+}
+
+/**
+ * Nanoseconds from @p from to @p to.
+ */
+static long long elapsed_ns(struct timespec const * from, struct timespec const * to) {
+	return (long long)(to->tv_sec - from->tv_sec) * NSEC_PER_SEC + (to->tv_nsec - from->tv_nsec);
+}
+
+/**
+ * Moves a tick boundary forward.
+ */
+static void add_ticks(struct timespec* ts, QTimeEvtCtr ticks) {
+	long long ns = ts->tv_nsec + (long long)ticks * TICK_NSEC;
+	ts->tv_sec += ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+/**
+ * Ticker thread: sleeps until the next deadline or input, then ticks.
+ */
+static void* ticker_thread(void* arg) {
+	struct pollfd fds[TICKER_MAX_INPUTS + 1];
+	struct timespec last;
+	(void)arg; /* unused parameter */
+
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	fds[0].fd = l_wakePipe[0];
+	fds[0].events = POLLIN;
+	for (int i = 0; i < l_numInputs; i++) {
+		fds[i + 1].fd = l_inputs[i];
+		fds[i + 1].events = POLLIN;
+	}
+
+	while (l_running) {
+		struct timespec now;
+		QTimeEvtCtr deadline = next_deadline();
+		int timeout = -1;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (deadline != 0U) {
+			long long ns = (long long)deadline * TICK_NSEC - elapsed_ns(&last, &now);
+			timeout = (ns > 0) ? (int)((ns + 999999) / 1000000) : 0;
+		}
+		// input during the grace period is picked up by the regular ticks
+		int numFds = (l_grace > 0) ? 1 : l_numInputs + 1;
+		if (poll(fds, numFds, timeout) < 0 && errno != EINTR) {
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			char drain[16];
+			while (read(l_wakePipe[0], drain, sizeof(drain)) > 0) {}
+		}
+		for (int i = 1; i < numFds; i++) {
+			if (fds[i].revents & POLLIN) {
+				// let gated scanners run; they are serviced on the next tick boundary
+				l_grace = TICKER_INPUT_GRACE;
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long long ns = elapsed_ns(&last, &now);
+		if (ns < TICK_NSEC) {
+			if (l_grace == 0) { continue; } // woken early to re-evaluate the deadline
+			struct timespec rest = { 0, TICK_NSEC - ns };
+			nanosleep(&rest, (struct timespec *)0);
+			ns = TICK_NSEC;
+		}
+
+		QTimeEvtCtr ticks = (QTimeEvtCtr)(ns / TICK_NSEC);
+		add_ticks(&last, ticks);
+		advance(ticks);
+	}
+	return (void *)0;
+}
+
+/**
+ * Starts the ticker thread.
+ * Called from QF_onStartup() once the port's own ticker has been disabled.
+ */
+void Ticker_start(void) {
+	if (pipe(l_wakePipe) != 0) {
+		return;
+	}
+	fcntl(l_wakePipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(l_wakePipe[1], F_SETFL, O_NONBLOCK);
+
+	l_running = 1;
+	if (pthread_create(&l_thread, (pthread_attr_t *)0, &ticker_thread, (void *)0) != 0) {
+		l_running = 0;
+	}
+}
+
+/**
+ * Stops the ticker thread.
+ */
+void Ticker_stop(void) {
+	if (l_running) {
+		l_running = 0;
+		Ticker_wake();
+		pthread_join(l_thread, (void **)0);
+	}
+	if (l_wakePipe[0] >= 0) {
+		close(l_wakePipe[0]);
+		close(l_wakePipe[1]);
+		l_wakePipe[0] = l_wakePipe[1] = -1;
+	}
+}
+
+/**
+ * Interrupts the ticker's sleep so it picks up a newly armed deadline.
+ * Safe to call before the ticker is started.
+ */
+void Ticker_wake(void) {
+	if (l_wakePipe[1] >= 0) {
+		char c = 0;
+		if (write(l_wakePipe[1], &c, 1) < 0) {
+			// pipe full, a wakeup is already pending
+		}
+	}
+}
+
+/**
+ * Adds an input descriptor that ends the ticker's sleep when readable.
+ * Must be called before Ticker_start().
+ *
+ * @param[in] fd Descriptor to watch
+ */
+void Ticker_watchInput(int fd) {
+	if (l_numInputs < TICKER_MAX_INPUTS) {
+		l_inputs[l_numInputs++] = fd;
+	}
+}
+
+/**
+ * Marks a time event as only relevant while input is pending.
+ * Its expirations do not bound the ticker's sleep; while idle they are
+ * folded into a single expiration on the next tick that is processed.
+ *
+ * @param[in] te Time event, typically an input scanner
+ */
+void Ticker_gateOnInput(QTimeEvt const * te) {
+	if (l_numGated < TICKER_MAX_GATED) {
+		l_gated[l_numGated++] = te;
+	}
+}
+
+#endif // BSP_TICKLESS
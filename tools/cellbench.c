@@ -0,0 +1,146 @@
+/**
+ * @file cellbench.c
+ * Cell kernel microbenchmark.
+ *
+ * Checks every kernel set this CPU supports against the scalar one, then
+ * times fill, border, blit, find and the chart range fold over rows of
+ * typical widths.
+ *
+ * Usage: cellbench [iterations]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cell_kernels.h"
+
+/**Longest row benchmarked.*/
+#define MAX_ROW 4096
+
+static char l_src[MAX_ROW];		///< Sparse source row for blits
+static char l_row[MAX_ROW];		///< Row under test
+static char l_ref[MAX_ROW];		///< Scalar result for comparison
+static char l_text[MAX_ROW];	///< Text with many near matches, for finds
+static float l_values[MAX_ROW];	///< Chart samples, for range folds
+static volatile char l_sink;	///< Keeps results alive
+
+/**
+ * @returns Monotonic time in nanoseconds
+ */
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Resets the row under test to a pattern with some '+' joins.
+ */
+static void reset_row(char* row, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		row[i] = (i % 7 == 0) ? '+' : 'a' + i % 26;
+	}
+}
+
+/**
+ * Runs every kernel of a set once on a row and records the result.
+ */
+static void run_once(CellKernels const* k, char* row, size_t n) {
+	reset_row(row, n);
+	k->fill(row, ' ', n / 3);
+	k->border(row, '-', n);
+	k->blit(row, l_src, n);
+}
+
+/**
+ * Compares a kernel set with the scalar one across awkward lengths and offsets.
+ *
+ * @returns 0 if every result matches
+ */
+static int verify(CellKernels const* k, CellKernels const* scalar) {
+	for (size_t n = 0; n < 200; n++) {
+		for (size_t off = 0; off < 4; off++) {
+			run_once(scalar, l_ref + off, n);
+			run_once(k, l_row + off, n);
+			if (memcmp(l_ref + off, l_row + off, n) != 0) {
+				fprintf(stderr, "%s differs from scalar at length %zu offset %zu\n", k->name, n, off);
+				return -1;
+			}
+			for (size_t m = 0; m < 10; m++) {
+				char const* needle = &l_text[(n * 7 + m) % (MAX_ROW - 16)];
+				if (k->find(l_text + off, n, needle, m) != scalar->find(l_text + off, n, needle, m)) {
+					fprintf(stderr, "%s find differs from scalar at length %zu offset %zu needle %zu\n", k->name, n, off, m);
+					return -1;
+				}
+			}
+			float lo = 50.0f, hi = 50.0f, refLo = 50.0f, refHi = 50.0f;
+			k->range(l_values + off, n, &lo, &hi);
+			scalar->range(l_values + off, n, &refLo, &refHi);
+			if (lo != refLo || hi != refHi) {
+				fprintf(stderr, "%s range differs from scalar at length %zu offset %zu\n", k->name, n, off);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Times one kernel set at one row width and prints nanoseconds per call.
+ */
+static void bench(CellKernels const* k, size_t n, long iters) {
+	double t0 = now_ns();
+	for (long i = 0; i < iters; i++) { k->fill(l_row, (char)('a' + (i & 7)), n); }
+	double t1 = now_ns();
+	for (long i = 0; i < iters; i++) { k->border(l_row, (i & 1) ? '-' : '=', n); }
+	double t2 = now_ns();
+	for (long i = 0; i < iters; i++) { k->blit(l_row, l_src, n); }
+	double t3 = now_ns();
+	size_t found = 0;
+	for (long i = 0; i < iters; i++) { found += k->find(l_text, n, "abcz", 4); }
+	double t4 = now_ns();
+	float lo = 0.0f, hi = 0.0f;
+	for (long i = 0; i < iters; i++) { k->range(l_values, n, &lo, &hi); }
+	double t5 = now_ns();
+	l_sink = l_row[n / 2] + (char)found + (char)(hi - lo);
+
+	printf("%-8s %6zu %10.1f %10.1f %10.1f %10.1f %10.1f\n", k->name, n, (t1 - t0) / iters,
+			(t2 - t1) / iters, (t3 - t2) / iters, (t4 - t3) / iters, (t5 - t4) / iters);
+}
+
+int main(int argc, char* argv[]) {
+	static const size_t widths[] = { 16, 80, 200, 1024, MAX_ROW };
+	long iters = (argc > 1) ? strtol(argv[1], NULL, 10) : 200000;
+	if (iters <= 0) {
+		fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < MAX_ROW; i++) {
+		l_src[i] = (i % 5 < 2) ? '\0' : 'A' + i % 26;
+		l_text[i] = 'a' + (i * i) % 3;
+		l_values[i] = (float)((i * 37) % 101) - 50.0f;
+	}
+
+	CellKernels const* scalar = Cells_variant(0);
+	for (int v = 1; Cells_variant(v) != NULL; v++) {
+		if (verify(Cells_variant(v), scalar) < 0) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	Cells_init();
+	printf("selected: %s\n", Cells_active()->name);
+	printf("%-8s %6s %10s %10s %10s %10s %10s\n", "kernels", "cells", "fill ns", "border ns", "blit ns",
+			"find ns", "range ns");
+	for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+		for (int v = 0; Cells_variant(v) != NULL; v++) {
+			bench(Cells_variant(v), widths[w], iters);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+/**
+ * @file glyphcheck.c
+ * Glyph reclaim self-check.
+ *
+ * Writes lines drawn from many more characters than the glyph table
+ * holds into a section, taking and restoring snapshots on the way, the
+ * way RenderArtist does for undo. Glyphs no cell holds are reclaimed
+ * when the table fills, and every cell is checked against the character
+ * written there. Then fills a section with more distinct characters than
+ * the table holds, and checks the exhaustion is reported and that the
+ * table recovers once the section is cleared, and that a second table,
+ * as another session has, is not affected. Last checks that a DEL byte
+ * in the text is not taken for the right half of a wide glyph.
+ *
+ * Usage: glyphcheck [seed]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glyph.h"
+#include "layer.h"
+
+/**Writes made.*/
+#define NUM_WRITES 20000
+/**Longest line written.*/
+#define LINE_LEN 12
+/**Writes between snapshots.*/
+#define SNAPSHOT_EVERY 50
+/**Writes between restores.*/
+#define RESTORE_EVERY 170
+
+static GlyphTable l_glyphs;						///< Table the layer's glyphs are in
+static RenderLayer l_layer;						///< Layer written to
+static LayerSnapshot l_snap;					///< Latest snapshot
+static int l_haveSnap;							///< Set while @ref l_snap holds tiles
+static uint32_t l_model[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];	///< Character written to each cell
+static uint32_t l_saved[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];	///< @ref l_model when snapshot
+static int l_reclaimed;							///< Glyphs freed by sweeps
+static int l_exhausted;							///< Sweeps that freed nothing
+static int l_failures;							///< Checks failed
+
+/**
+ * Marks the glyphs of a block of cells.
+ */
+static void mark(void* arg, char const* cells, size_t n) {
+	Glyph_mark(arg, cells, n);
+}
+
+/**
+ * Marks the glyphs of the layer and the snapshot, then sweeps.
+ */
+static void reclaim(void* arg) {
+	Layer_visitCells(&l_layer, &mark, arg);
+	if (l_haveSnap) {
+		Layer_visitSnapshot(&l_snap, &mark, arg);
+	}
+	int freed = Glyph_sweep(arg);
+	l_reclaimed += freed;
+	l_exhausted += (freed == 0);
+}
+
+/**
+ * @returns Character of a pool of narrow ones outside ASCII
+ */
+static uint32_t pool_char(int i) {
+	static const uint32_t firsts[] = { 0x00C0, 0x0100, 0x0410 };
+	static const int sizes[] = { 64, 128, 64 };
+	for (int r = 0; r < 3; r++) {
+		if (i < sizes[r]) { return firsts[r] + i; }
+		i -= sizes[r];
+	}
+	return 'a' + i % 26;
+}
+
+/**
+ * Encodes a character as UTF-8.
+ *
+ * @returns Bytes written
+ */
+static int put_utf8(char* out, uint32_t cp) {
+	if (cp < 0x80) {
+		out[0] = (char)cp;
+		return 1;
+	}
+	out[0] = (char)(0xC0 | cp >> 6);
+	out[1] = (char)(0x80 | (cp & 0x3F));
+	return 2;
+}
+
+/**
+ * @returns Character shown by a cell, 0 for a glyph the table lost
+ */
+static uint32_t cell_char(char cell) {
+	if (!Glyph_isGlyph(cell)) {
+		return (cell == '\0') ? ' ' : (unsigned char)cell;
+	}
+	int len, width;
+	uint32_t cp;
+	char const* bytes = Glyph_bytes(&l_glyphs, cell, &len, &width);
+	if (bytes == NULL) { return 0; }
+	Glyph_decode(bytes, len, &cp);
+	return cp;
+}
+
+/**
+ * Lays out and writes a line of characters.
+ *
+ * @returns Cells shown as @ref GLYPH_REPLACEMENT
+ */
+static int write_line(RenderSection const* section, int x, int y, uint32_t const* chars, int n) {
+	char text[LINE_LEN * 4 * 2];
+	char cells[MAX_SCREEN_WIDTH];
+	int len = 0;
+	for (int i = 0; i < n; i++) {
+		len += put_utf8(&text[len], chars[i]);
+	}
+	int size = Glyph_layout(&l_glyphs, text, len, cells, n);
+	Layer_write(&l_layer, section, x, y, cells, size);
+	Layer_touch(&l_layer, y, y);
+
+	int missed = 0;
+	for (int i = 0; i < size; i++) {
+		missed += (cells[i] == GLYPH_REPLACEMENT);
+		l_model[y][x + i] = (cells[i] == GLYPH_REPLACEMENT) ? GLYPH_REPLACEMENT : chars[i];
+	}
+	return missed;
+}
+
+/**
+ * Checks every cell of a section against the character written there.
+ */
+static void check_section(RenderSection const* section, int write) {
+	for (int y = section->yAnchor; y < section->yAnchor + section->yDim; y++) {
+		for (int x = section->xAnchor; x < section->xAnchor + section->xDim; x++) {
+			if (cell_char(Layer_cell(&l_layer, x, y)) != l_model[y][x]) {
+				if (l_failures++ < 10) {
+					printf("FAIL cell %d,%d after write %d\n", x, y, write);
+				}
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * Reads what a section shows into the model.
+ */
+static void read_section(RenderSection const* section) {
+	for (int y = section->yAnchor; y < section->yAnchor + section->yDim; y++) {
+		for (int x = section->xAnchor; x < section->xAnchor + section->xDim; x++) {
+			l_model[y][x] = cell_char(Layer_cell(&l_layer, x, y));
+		}
+	}
+}
+
+/**
+ * Writes random lines through snapshots and restores; the layer and the
+ * snapshot together never hold more glyphs than the table.
+ */
+static void check_churn(void) {
+	static const RenderSection section = { "churn", 2, 2, 20, 3 };
+	uint32_t chars[LINE_LEN];
+
+	Layer_addSection(&l_layer, &section);
+	read_section(&section);
+	for (int write = 1; write <= NUM_WRITES; write++) {
+		int n = 1 + rand() % LINE_LEN;
+		int x = section.xAnchor + rand() % (section.xDim - n + 1);
+		int y = section.yAnchor + rand() % section.yDim;
+		for (int i = 0; i < n; i++) {
+			chars[i] = (rand() % 4 == 0) ? (uint32_t)('a' + rand() % 26) : pool_char(rand() % 256);
+		}
+		if (write_line(&section, x, y, chars, n) != 0 && l_failures++ < 10) {
+			printf("FAIL replacement after write %d\n", write);
+		}
+		check_section(&section, write);
+
+		if (write % SNAPSHOT_EVERY == 0) {
+			if (l_haveSnap) {
+				Layer_dropSnapshot(&l_snap);
+			}
+			l_haveSnap = (Layer_snapshot(&l_layer, &l_snap) == 0);
+			memcpy(l_saved, l_model, sizeof(l_model));
+		}
+		if (write % RESTORE_EVERY == 0 && l_haveSnap) {
+			int topEdge, botEdge;
+			Layer_restore(&l_layer, &l_snap, &topEdge, &botEdge);
+			l_haveSnap = 0;
+			memcpy(l_model, l_saved, sizeof(l_model));
+			check_section(&section, write);
+		}
+	}
+	if (l_haveSnap) {
+		Layer_dropSnapshot(&l_snap);
+		l_haveSnap = 0;
+	}
+	if (l_reclaimed == 0 || l_exhausted != 0) {
+		printf("FAIL churn: %d reclaimed, %d exhausted\n", l_reclaimed, l_exhausted);
+		l_failures++;
+	}
+}
+
+/**
+ * Fills a section with more distinct characters than the table holds,
+ * then clears it and fills it again.
+ */
+static void check_exhaustion(void) {
+	static const RenderSection section = { "full", 2, 8, 76, 4 };
+	uint32_t chars[LINE_LEN];
+	int missed = 0;
+
+	Layer_addSection(&l_layer, &section);
+	read_section(&section);
+	for (int i = 0; i < 256; i += LINE_LEN) {
+		for (int c = 0; c < LINE_LEN; c++) {
+			chars[c] = pool_char((i + c) % 256);
+		}
+		int cell = i % (section.xDim * section.yDim);
+		int x = section.xAnchor + cell % section.xDim;
+		int y = section.yAnchor + cell / section.xDim;
+		int n = (section.xAnchor + section.xDim - x < LINE_LEN) ? section.xAnchor + section.xDim - x : LINE_LEN;
+		missed += write_line(&section, x, y, chars, n);
+	}
+	check_section(&section, 0);
+	if (missed == 0 || l_exhausted == 0 || Glyph_count(&l_glyphs) != GLYPH_MAX) {
+		printf("FAIL exhaustion: %d missed, %d exhausted, %d glyphs\n", missed, l_exhausted, Glyph_count(&l_glyphs));
+		l_failures++;
+	}
+
+	GlyphTable other;
+	Glyph_initTable(&other);
+	for (int i = 0; i < GLYPH_MAX; i += LINE_LEN) {
+		char text[LINE_LEN * 2];
+		char cells[LINE_LEN];
+		int n = (GLYPH_MAX - i < LINE_LEN) ? GLYPH_MAX - i : LINE_LEN;
+		int len = 0;
+		for (int c = 0; c < n; c++) {
+			len += put_utf8(&text[len], pool_char(255 - i - c));
+		}
+		int size = Glyph_layout(&other, text, len, cells, n);
+		if (memchr(cells, GLYPH_REPLACEMENT, size) != NULL) {
+			printf("FAIL second table shares the full one\n");
+			l_failures++;
+			break;
+		}
+	}
+
+	char blank[MAX_SCREEN_WIDTH];
+	memset(blank, ' ', sizeof(blank));
+	Layer_init(&l_layer);
+	Layer_addSection(&l_layer, &section);
+	for (int y = section.yAnchor; y < section.yAnchor + section.yDim; y++) {
+		Layer_write(&l_layer, &section, section.xAnchor, y, blank, section.xDim);
+	}
+	read_section(&section);
+	for (int i = 0; i < 120; i += LINE_LEN) {
+		for (int c = 0; c < LINE_LEN; c++) {
+			chars[c] = pool_char(255 - (i + c) % 120);
+		}
+		if (write_line(&section, section.xAnchor + i % 60, section.yAnchor + i / 60, chars, LINE_LEN) != 0) {
+			printf("FAIL replacement after the section was cleared\n");
+			l_failures++;
+			break;
+		}
+	}
+	check_section(&section, 0);
+}
+
+/**
+ * Lays out text with DEL bytes around a wide glyph, and checks the DEL
+ * cells are not read back as the glyph's right half.
+ */
+static void check_delete(void) {
+	static const char text[] = "a\x7F\xE4\xB8\xAD\x7F";
+	GlyphTable table;
+	char cells[8];
+	Glyph_initTable(&table);
+	int size = Glyph_layout(&table, text, sizeof(text) - 1, cells, sizeof(cells));
+	int tails = 0;
+	for (int i = 0; i < size; i++) {
+		tails += (cells[i] == (char)GLYPH_TAIL);
+	}
+	if (size != 5 || cells[1] != GLYPH_REPLACEMENT || cells[4] != GLYPH_REPLACEMENT || tails != 1) {
+		printf("FAIL DEL laid out as %d cells, %d halves\n", size, tails);
+		l_failures++;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	srand((argc > 1) ? atoi(argv[1]) : 1);
+	Glyph_init();
+	Glyph_initTable(&l_glyphs);
+	Glyph_setReclaim(&l_glyphs, &reclaim, &l_glyphs);
+	Layer_init(&l_layer);
+
+	check_churn();
+	check_exhaustion();
+	check_delete();
+	if (l_failures > 0) {
+		printf("%d checks failed\n", l_failures);
+		return 1;
+	}
+	printf("ok: %d writes, %d glyphs reclaimed\n", NUM_WRITES, l_reclaimed);
+	return 0;
+}
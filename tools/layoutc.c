@@ -0,0 +1,222 @@
+/**
+ * @file layoutc.c
+ * Layout compiler.
+ *
+ * Reads layout files and writes a C source and header defining one
+ * `const RenderLayout LAYOUT_<name>` per layout, with every section's
+ * outline already drawn into the layer. Only tiles with something drawn
+ * in them are emitted.
+ *
+ * Usage: layoutc <out.c> <out.h> <file.layout>...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "layer.h"
+
+/**Maximum number of layouts per invocation.*/
+#define MAX_LAYOUTS 32
+/**Maximum length of a layout name.*/
+#define MAX_NAME_LEN 32
+
+/**
+ * @struct Layout
+ * Layout being compiled.
+ */
+typedef struct {
+	char		name[MAX_NAME_LEN];	///< Layout name
+	int			numSections;		///< Sections added so far
+	RenderLayer	layer;				///< Rendered layer
+} Layout;
+
+static Layout l_layouts[MAX_LAYOUTS];	///< Compiled layouts
+static int l_numLayouts;				///< Number of compiled layouts
+
+/**
+ * Reports a syntax error and exits.
+ */
+static void fail(char const* file, int line, char const* msg) {
+	fprintf(stderr, "%s:%d: %s\n", file, line, msg);
+	exit(1);
+}
+
+/**
+ * Parses a layout file.
+ *
+ * @param[in] file Path of the layout file
+ */
+static void parse(char const* file) {
+	char buf[256];
+	int line = 0;
+	Layout* layout = NULL;
+
+	FILE* f = fopen(file, "r");
+	if (f == NULL) {
+		fail(file, 0, "cannot open");
+	}
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		char word[32];
+		char key[32];
+		int x, y, w, h;
+		line++;
+
+		char* hash = strchr(buf, '#');
+		if (hash != NULL) { *hash = '\0'; }
+		if (sscanf(buf, "%31s", word) != 1) { continue; }
+
+		if (!strcmp(word, "layout")) {
+			if (l_numLayouts == MAX_LAYOUTS) { fail(file, line, "too many layouts"); }
+			layout = &l_layouts[l_numLayouts++];
+			if (sscanf(buf, "%*s %31s", layout->name) != 1) { fail(file, line, "expected: layout <name>"); }
+			Layer_init(&layout->layer);
+			strncpy(layout->layer.key, layout->name, PAINTER_KEY_LEN - 1);
+		} else if (!strcmp(word, "section")) {
+			RenderSection section;
+			if (layout == NULL) { fail(file, line, "section before layout"); }
+			if (sscanf(buf, "%*s %31s %d %d %d %d", key, &x, &y, &w, &h) != 5) {
+				fail(file, line, "expected: section <key> <x> <y> <width> <height>");
+			}
+			if (strlen(key) >= PAINTER_KEY_LEN) { fail(file, line, "section key too long"); }
+			if (w <= 0 || h <= 0) { fail(file, line, "empty section"); }
+
+			memset(&section, 0, sizeof(section));
+			strcpy(section.key, key);
+			section.xAnchor = x;
+			section.yAnchor = y;
+			section.xDim = w;
+			section.yDim = h;
+			if (Layer_getSection(&layout->layer, key) != NULL) { fail(file, line, "duplicate section key"); }
+			if (Layer_addSection(&layout->layer, &section) == NULL) {
+				fail(file, line, "section does not fit on the screen or layer is full");
+			}
+			layout->numSections++;
+		} else {
+			fail(file, line, "unknown directive");
+		}
+	}
+	fclose(f);
+}
+
+/**
+ * Writes a row of cells as a string literal.
+ */
+static void emit_row(FILE* f, char const* row, int len) {
+	fputc('"', f);
+	for (int col = 0; col < len; col++) {
+		char c = row[col];
+		if (c >= ' ' && c <= '~' && c != '"' && c != '\\') {
+			fputc(c, f);
+		} else {
+			fprintf(f, "\\%03o", (unsigned char)c);
+		}
+	}
+	fputc('"', f);
+}
+
+/**
+ * Writes the generated source file.
+ */
+static void emit_source(FILE* f, char const* header) {
+	char const* base = strrchr(header, '/');
+	fprintf(f, "/* Generated by layoutc, do not edit. */\n\n");
+	fprintf(f, "#include <stddef.h>\n\n");
+	fprintf(f, "#include \"%s\"\n", base ? base + 1 : header);
+
+	for (int i = 0; i < l_numLayouts; i++) {
+		Layout* layout = &l_layouts[i];
+		RenderLayer* layer = &layout->layer;
+
+		int numTiles = 0;
+		fprintf(f, "\nstatic LayerTile LAYOUT_%s_tiles[] = {\n", layout->name);
+		for (int ty = 0; ty < LAYER_TILES_Y; ty++) {
+			for (int tx = 0; tx < LAYER_TILES_X; tx++) {
+				LayerTile* tile = layer->tiles[ty][tx];
+				if (tile == NULL) { continue; }
+				fprintf(f, "\t{ .cells = {\n");
+				for (int row = 0; row < LAYER_TILE_HEIGHT; row++) {
+					fprintf(f, "\t\t");
+					emit_row(f, tile->cells[row], LAYER_TILE_WIDTH);
+					fprintf(f, ",\n");
+				}
+				fprintf(f, "\t} },\n");
+			}
+		}
+		fprintf(f, "};\n");
+
+		fprintf(f, "\nconst RenderLayout LAYOUT_%s = {\n", layout->name);
+		fprintf(f, "\t.name = \"%s\",\n", layout->name);
+		fprintf(f, "\t.numSections = %d,\n", layout->numSections);
+		fprintf(f, "\t.layer = {\n");
+		fprintf(f, "\t\t.key = \"%s\",\n", layer->key);
+
+		fprintf(f, "\t\t.leftEdge = {");
+		for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+			fprintf(f, "%s%d", row ? ", " : " ", layer->leftEdge[row]);
+		}
+		fprintf(f, " },\n");
+
+		fprintf(f, "\t\t.tiles = {\n");
+		for (int ty = 0; ty < LAYER_TILES_Y; ty++) {
+			fprintf(f, "\t\t\t{");
+			for (int tx = 0; tx < LAYER_TILES_X; tx++) {
+				if (layer->tiles[ty][tx] == NULL) {
+					fprintf(f, "%sNULL", tx ? ", " : " ");
+				} else {
+					fprintf(f, "%s&LAYOUT_%s_tiles[%d]", tx ? ", " : " ", layout->name, numTiles++);
+				}
+			}
+			fprintf(f, " },\n");
+		}
+		fprintf(f, "\t\t},\n");
+
+		fprintf(f, "\t\t.sections = {\n");
+		for (int s = 0; s < layout->numSections; s++) {
+			RenderSection* section = &layer->sections[s];
+			fprintf(f, "\t\t\t{ .key = \"%s\", .xAnchor = %u, .yAnchor = %u, .xDim = %u, .yDim = %u },\n",
+					section->key, section->xAnchor, section->yAnchor, section->xDim, section->yDim);
+		}
+		fprintf(f, "\t\t},\n");
+		fprintf(f, "\t},\n};\n");
+	}
+}
+
+/**
+ * Writes the generated header file.
+ */
+static void emit_header(FILE* f) {
+	fprintf(f, "/* Generated by layoutc, do not edit. */\n\n");
+	fprintf(f, "#ifndef __LAYOUTS_H\n#define __LAYOUTS_H\n\n");
+	fprintf(f, "#include \"layer.h\"\n\n");
+	for (int i = 0; i < l_numLayouts; i++) {
+		fprintf(f, "extern const RenderLayout LAYOUT_%s;\n", l_layouts[i].name);
+	}
+	fprintf(f, "\n#endif // __LAYOUTS_H\n");
+}
+
+/**
+ * Compiles the layout files named on the command line.
+ */
+int main(int argc, char* argv[]) {
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <out.c> <out.h> <file.layout>...\n", argv[0]);
+		return 1;
+	}
+	for (int i = 3; i < argc; i++) {
+		parse(argv[i]);
+	}
+
+	FILE* src = fopen(argv[1], "w");
+	FILE* hdr = fopen(argv[2], "w");
+	if (src == NULL || hdr == NULL) {
+		fprintf(stderr, "cannot write output\n");
+		return 1;
+	}
+	emit_source(src, argv[2]);
+	emit_header(hdr);
+	fclose(src);
+	fclose(hdr);
+	return 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file searchcheck.c
+ * Search highlight self-check.
+ *
+ * Keeps the video attributes of an emulated screen the way the
+ * ScreenPainter does: a painted block is written in normal video, then
+ * its rows are highlighted. Blocks of a row are edited under an active
+ * search, making and breaking matches that reach past the block, and
+ * the screen is checked against the matches of the row's text. Then
+ * searches a wrapped text whose only match is far outside its viewport,
+ * and checks the viewport is scrolled to the match and highlights it.
+ *
+ * Usage: searchcheck [seed]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "section_view.h"
+#include "text_search.h"
+
+/**Query searched for; it cannot overlap itself.*/
+#define QUERY "needle"
+/**Edits made.*/
+#define NUM_EDITS 20000
+/**Paragraphs of the wrapped text searched.*/
+#define DOC_PARAS 2000
+/**Paragraph of the wrapped text holding the only match.*/
+#define DOC_MATCH 700
+
+static char l_reverse[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];	///< Emulated screen attributes
+static int l_failures;										///< Checks failed
+
+/**
+ * Sets the attribute of a run of emulated cells.
+ */
+static void set_attr(int y, int col, int len, int reverse, void* arg) {
+	(void)arg;
+	for (int x = col; x < col + len && x < MAX_SCREEN_WIDTH; x++) {
+		l_reverse[y][x] = (char)reverse;
+	}
+}
+
+/**
+ * Paints part of a row: the cells written lose their attribute, and the
+ * row is highlighted again.
+ */
+static void paint(TextSearch* search, RenderLayer const* layer, int y, int left, int right) {
+	set_attr(y, left, right - left + 1, 0, NULL);
+	TextSearch_highlight(search, layer, y, &set_attr, NULL);
+}
+
+/**
+ * Checks a row's attributes against the matches in its text.
+ */
+static void check_row(RenderLayer const* layer, int y, int edit) {
+	char row[MAX_SCREEN_WIDTH];
+	char expect[MAX_SCREEN_WIDTH];
+	int len = (int)strlen(QUERY);
+	for (int x = 0; x < MAX_SCREEN_WIDTH; x++) {
+		row[x] = Layer_cell(layer, x, y);
+	}
+	memset(expect, 0, sizeof(expect));
+	for (int x = 0; x + len <= MAX_SCREEN_WIDTH; x++) {
+		if (!memcmp(&row[x], QUERY, len)) {
+			memset(&expect[x], 1, len);
+		}
+	}
+	if (memcmp(expect, l_reverse[y], MAX_SCREEN_WIDTH) && l_failures++ < 10) {
+		printf("FAIL highlight of row %d after edit %d: %.*s\n", y, edit, MAX_SCREEN_WIDTH, row);
+	}
+}
+
+/**
+ * Makes up text made mostly of pieces of the query.
+ */
+static int make_text(char* text, int max) {
+	static char const* const pieces[] = { QUERY, "nee", "dle", "ne", "edle", " ", "x" };
+	int len = 0;
+	int target = 1 + rand() % max;
+	while (len < target) {
+		char const* piece = pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+		int n = (int)strlen(piece);
+		if (len + n > target) { n = target - len; }
+		memcpy(&text[len], piece, n);
+		len += n;
+	}
+	return len;
+}
+
+/**
+ * Searches a wrapped text that shows its last lines for a match that is
+ * far above them.
+ */
+static void check_document(void) {
+	static RenderLayer layer;
+	static SectionView views[VIEWS_PER_SESSION];
+	static TextSearch search;
+	static const RenderSection section = { "log", 1, 8, 40, 5 };
+	char text[64];
+	int len = (int)strlen(QUERY);
+	int topEdge, botEdge;
+
+	Layer_init(&layer);
+	Layer_addSection(&layer, &section);
+	SectionView_init(views);
+	TextSearch_init(&search);
+	SectionView* view = SectionView_bindWrap(views, &section);
+	for (uint32_t para = 0; para < DOC_PARAS; para++) {
+		int n = snprintf(text, sizeof(text), (para == DOC_MATCH) ? "line %u holds the " QUERY : "line %u of hay",
+				(unsigned)para);
+		SectionView_text(view, para, text, n);
+	}
+	SectionView_draw(view, &layer, &topEdge, &botEdge);
+	int before = TextSearch_setQuery(&search, &layer, QUERY, len, &topEdge, &botEdge);
+
+	int scrolled = SectionView_search(views, QUERY, len);
+	SectionView_draw(view, &layer, &topEdge, &botEdge);
+	int after = TextSearch_setQuery(&search, &layer, QUERY, len, &topEdge, &botEdge);
+	uint32_t line = WrapText_lineOf(&view->w.wrap, DOC_MATCH, 0);
+	if (before != 0 || scrolled != 1 || after != 1 || view->w.wrap.top != line) {
+		printf("FAIL document search: %d before, %d scrolled, %d after, top %u\n", before, scrolled, after,
+				(unsigned)view->w.wrap.top);
+		l_failures++;
+	}
+	if (SectionView_search(views, QUERY, len) != 0) {
+		printf("FAIL document search scrolled away from a match in view\n");
+		l_failures++;
+	}
+	SectionView_freeAll(views);
+}
+
+int main(int argc, char* argv[]) {
+	static RenderLayer layer;
+	static TextSearch search;
+	static const RenderSection section = { "text", 1, 1, 70, 4 };
+	char text[MAX_SCREEN_WIDTH];
+	int topEdge, botEdge;
+
+	srand((argc > 1) ? atoi(argv[1]) : 1);
+	Layer_init(&layer);
+	Layer_addSection(&layer, &section);
+	TextSearch_init(&search);
+
+	for (int y = section.yAnchor; y < section.yAnchor + section.yDim; y++) {
+		int len = make_text(text, section.xDim);
+		Layer_write(&layer, &section, section.xAnchor, y, text, len);
+		Layer_touch(&layer, y, y);
+	}
+	TextSearch_setQuery(&search, &layer, QUERY, (int)strlen(QUERY), &topEdge, &botEdge);
+	for (int y = 0; y < MAX_SCREEN_HEIGHT; y++) {
+		paint(&search, &layer, y, 0, MAX_SCREEN_WIDTH - 1);
+		check_row(&layer, y, 0);
+	}
+
+	for (int edit = 1; edit <= NUM_EDITS; edit++) {
+		int y = section.yAnchor + rand() % section.yDim;
+		int x = section.xAnchor + rand() % section.xDim;
+		int room = section.xAnchor + section.xDim - x;
+		int len = make_text(text, (room < 12) ? room : 12);
+		Layer_write(&layer, &section, x, y, text, len);
+		Layer_touch(&layer, y, y);
+		paint(&search, &layer, y, x, x + len - 1);
+		check_row(&layer, y, edit);
+	}
+	check_document();
+
+	if (l_failures > 0) {
+		printf("%d checks failed\n", l_failures);
+		return 1;
+	}
+	printf("ok: %d edits\n", NUM_EDITS);
+	return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file shmcat.c
+ * Prints a session's latest frame from shared memory.
+ *
+ * Needs a build with SHM_EXPORT=1. With -f, keeps printing every row
+ * that changes, prefixed with the frame and row, until interrupted.
+ *
+ * Usage: shmcat [-f] pid [session]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "frame_shm.h"
+
+/**Poll interval with -f, in milliseconds.*/
+#define POLL_MS 50
+
+static char l_cells[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH];	///< Frame as last read
+
+/**
+ * Prints a row without its trailing blanks.
+ */
+static void print_row(char const* row) {
+	int len = MAX_SCREEN_WIDTH;
+	while (len > 0 && row[len - 1] == ' ') { len--; }
+	printf("%.*s\n", len, row);
+}
+
+int main(int argc, char* argv[]) {
+	int follow = 0;
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "-f") == 0) {
+		follow = 1;
+		arg++;
+	}
+	if (arg >= argc) {
+		fprintf(stderr, "usage: %s [-f] pid [session]\n", argv[0]);
+		return 2;
+	}
+	pid_t pid = (pid_t)atoi(argv[arg]);
+	uint16_t session = (arg + 1 < argc) ? (uint16_t)atoi(argv[arg + 1]) : 0;
+
+	FrameShm const* shm = FrameShm_attach(pid, session);
+	if (shm == NULL) {
+		fprintf(stderr, "no frame for session %u of process %d\n", session, (int)pid);
+		return 1;
+	}
+
+	uint32_t frame = FrameShm_read(shm, l_cells, 0);
+	for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+		print_row(l_cells[row]);
+	}
+
+	uint32_t rowFrame[MAX_SCREEN_HEIGHT];
+	memcpy(rowFrame, shm->rowFrame, sizeof(rowFrame));
+	while (follow) {
+		struct timespec pause = { 0, POLL_MS * 1000000L };
+		nanosleep(&pause, NULL);
+
+		uint32_t latest = FrameShm_read(shm, l_cells, frame);
+		if (latest == 0 || latest == frame) { continue; }
+		for (int row = 0; row < MAX_SCREEN_HEIGHT; row++) {
+			uint32_t changed = __atomic_load_n(&shm->rowFrame[row], __ATOMIC_RELAXED);
+			if (changed != rowFrame[row]) {
+				rowFrame[row] = changed;
+				printf("%u %2d ", latest, row);
+				print_row(l_cells[row]);
+			}
+		}
+		fflush(stdout);
+		frame = latest;
+	}
+
+	FrameShm_detach(shm);
+	return 0;
+}
@@ -0,0 +1,496 @@
+/**
+ * @file viewcheck.c
+ * Section widget self-check.
+ *
+ * Binds a table to a section of a layer, feeds it appends of every size
+ * while sorted, and checks the shown order against a plain sort and the
+ * drawn section against the rows it should show. Single appends must be
+ * inserted in place, without merging the index again. Then filters the
+ * table by each value class in turn, appending on the way, and last
+ * clears the filter.
+ *
+ * Then binds a wrapped text, sets and rewrites its paragraphs, resizes
+ * its section and checks what is drawn against a text wrapped from
+ * scratch at the new width: at once for the lines in view, and for the
+ * whole document once the deferred reflow is done.
+ *
+ * Last binds a chart with fewer samples than are pushed to it, and
+ * checks its buckets against the samples still kept and the drawn
+ * section against a chart rebuilt from its ring.
+ *
+ * Usage: viewcheck [seed]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "section_view.h"
+
+/**Most rows appended over a run.*/
+#define MAX_ROWS 40000
+/**Index work done per step, small so that steps interleave with appends.*/
+#define STEP_BUDGET 500
+/**Value classes the table is filtered by, see @ref src_filter.*/
+#define NUM_CLASSES 4
+/**Paragraphs in the wrapped text.*/
+#define NUM_PARAS 3000
+/**Longest paragraph.*/
+#define PARA_LEN 400
+/**Samples kept by the chart; not a multiple of its width.*/
+#define CHART_CAPACITY 97
+/**Samples pushed to the chart.*/
+#define NUM_SAMPLES 5000
+
+static uint32_t l_values[MAX_ROWS];	///< Sort key of each source row
+static uint32_t l_numRows;			///< Rows in the source
+static uint32_t l_expect[MAX_ROWS];	///< Rows in the expected order
+static uint32_t l_numExpect;		///< Rows in @ref l_expect
+static int l_failures;				///< Checks failed
+static char l_paras[NUM_PARAS][PARA_LEN];	///< Text of each paragraph
+static uint32_t l_paraLen[NUM_PARAS];		///< Bytes of each paragraph
+static char l_ref[MAX_SCREEN_HEIGHT][MAX_SCREEN_WIDTH + 1];	///< Lines of the reference text
+static float l_samples[NUM_SAMPLES];	///< Every sample pushed to the chart
+
+/**
+ * @returns Number of source rows
+ */
+static uint32_t src_rows(void* ctx) {
+	(void)ctx;
+	return l_numRows;
+}
+
+/**
+ * Formats a cell: the row number, then its value.
+ */
+static int src_format(void* ctx, uint32_t row, int column, char* buf, int width) {
+	char cell[16];
+	int len = snprintf(cell, sizeof(cell), "%u", (unsigned)((column == 0) ? row : l_values[row]));
+	(void)ctx;
+	if (len > width) { len = width; }
+	memcpy(buf, cell, len);
+	return len;
+}
+
+/**
+ * Orders two rows by a column.
+ */
+static int src_compare(void* ctx, int column, uint32_t a, uint32_t b) {
+	uint32_t va = (column == 0) ? a : l_values[a];
+	uint32_t vb = (column == 0) ? b : l_values[b];
+	(void)ctx;
+	return (va > vb) - (va < vb);
+}
+
+/**
+ * Orders rows by value, ties by position, like a table sorted by column 1.
+ */
+static int by_value(void const* pa, void const* pb) {
+	uint32_t a = *(uint32_t const*)pa, b = *(uint32_t const*)pb;
+	if (l_values[a] != l_values[b]) {
+		return (l_values[a] > l_values[b]) - (l_values[a] < l_values[b]);
+	}
+	return (a > b) - (a < b);
+}
+
+/**
+ * Keeps the rows whose value is of a class.
+ */
+static int src_filter(void* ctx, uint32_t row, void* arg) {
+	(void)ctx;
+	return l_values[row] % NUM_CLASSES == (uint32_t)(intptr_t)arg;
+}
+
+static const TableSpec l_spec = {
+	{ &src_rows, &src_format, &src_compare, NULL },
+	{ { "row", 6 }, { "value", 6 } },
+	2, &src_filter
+};
+
+/**
+ * Reports a failed check.
+ */
+static void fail(char const* what, uint32_t at) {
+	if (l_failures++ < 10) {
+		printf("FAIL %s at %u (%u rows)\n", what, (unsigned)at, (unsigned)l_numRows);
+	}
+}
+
+/**
+ * Steps a view until its index is up to date.
+ */
+static void settle(SectionView* view) {
+	while (SectionView_step(view, STEP_BUDGET)) {
+	}
+}
+
+/**
+ * Checks every shown position against the expected order.
+ *
+ * @param[in] keep Value class the table is filtered by, -1 for none
+ */
+static void check_order(SectionView* view, int32_t keep) {
+	TableView* table = &view->w.table;
+	l_numExpect = 0;
+	for (uint32_t row = 0; row < l_numRows; row++) {
+		if (keep < 0 || src_filter(NULL, row, (void *)(intptr_t)keep)) {
+			l_expect[l_numExpect++] = row;
+		}
+	}
+	qsort(l_expect, l_numExpect, sizeof(uint32_t), &by_value);
+
+	if (TableView_numShown(table) != l_numExpect) {
+		fail("shown rows", TableView_numShown(table));
+		return;
+	}
+	uint32_t cursor = table->cursor;
+	for (uint32_t pos = 0; pos < l_numExpect; pos++) {
+		table->cursor = pos;
+		if (TableView_selected(table) != l_expect[pos]) {
+			fail("order", pos);
+			break;
+		}
+	}
+	table->cursor = cursor;
+}
+
+/**
+ * Draws a view and checks its section holds the rows it should show.
+ */
+static void check_drawn(SectionView* view, RenderLayer* layer) {
+	TableView* table = &view->w.table;
+	RenderSection const* section = Layer_getSection(layer, view->key);
+	int topEdge, botEdge;
+	table->dirty = 1;
+	SectionView_draw(view, layer, &topEdge, &botEdge);
+
+	for (int y = 1; y < section->yDim; y++) {
+		uint32_t pos = table->top + y - 1;
+		char line[MAX_SCREEN_WIDTH + 1];
+		memset(line, ' ', section->xDim);
+		line[section->xDim] = '\0';
+		if (pos < l_numExpect) {
+			char text[MAX_SCREEN_WIDTH + 1];
+			int len = snprintf(text, sizeof(text), "%c%-6u %-6u ", (pos == table->cursor) ? '>' : ' ',
+					(unsigned)l_expect[pos], (unsigned)l_values[l_expect[pos]]);
+			memcpy(line, text, len);
+		}
+		for (int x = 0; x < section->xDim; x++) {
+			if (Layer_cell(layer, section->xAnchor + x, section->yAnchor + y) != line[x]) {
+				fail("drawn", pos);
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * Appends rows to the source.
+ */
+static void append_rows(uint32_t count) {
+	for (uint32_t i = 0; i < count && l_numRows < MAX_ROWS; i++) {
+		l_values[l_numRows++] = rand() % 1000;
+	}
+}
+
+/**
+ * Keeps a rendered line of the reference text.
+ */
+static void keep_line(int y, char const* text, void* arg) {
+	(void)arg;
+	snprintf(l_ref[y], sizeof(l_ref[y]), "%s", text);
+}
+
+/**
+ * Makes up a paragraph of words, now and then one wider than any section.
+ */
+static void make_paragraph(uint32_t para) {
+	uint32_t len = 0;
+	int words = rand() % 40;
+	for (int w = 0; w < words; w++) {
+		int wordLen = (rand() % 16 == 0) ? 30 + rand() % 40 : 1 + rand() % 10;
+		if (len + wordLen + 1 > PARA_LEN) { break; }
+		if (len > 0) {
+			l_paras[para][len++] = ' ';
+		}
+		for (int i = 0; i < wordLen; i++) {
+			l_paras[para][len++] = 'a' + rand() % 26;
+		}
+	}
+	l_paraLen[para] = len;
+}
+
+/**
+ * Wraps every paragraph from scratch and renders the lines from a top line.
+ *
+ * @param[in] width Wrap width
+ * @param[in] height Viewport height
+ * @param[in] para	 Paragraph to show at the top, or NUM_PARAS to follow the end
+ * @param[in] offset Offset within @p para
+ *
+ * @returns Lines in the document
+ */
+static uint32_t render_reference(uint16_t width, uint16_t height, uint32_t para, uint32_t offset) {
+	WrapText ref;
+	WrapText_init(&ref, width, height);
+	for (uint32_t i = 0; i < NUM_PARAS; i++) {
+		WrapText_append(&ref, l_paras[i], l_paraLen[i]);
+		if (i + 1 < NUM_PARAS) {
+			WrapText_append(&ref, "\n", 1);
+		}
+	}
+	if (para < NUM_PARAS) {
+		ref.follow = 0;
+		ref.top = WrapText_lineOf(&ref, para, offset);
+	}
+	ref.dirty = 1;
+	WrapText_render(&ref, &keep_line, NULL);
+	uint32_t lines = ref.numLines;
+	WrapText_free(&ref);
+	return lines;
+}
+
+/**
+ * Draws a wrapped text and checks its section against the reference lines.
+ */
+static void check_wrapped(SectionView* view, RenderLayer* layer, char const* what) {
+	RenderSection const* section = Layer_getSection(layer, view->key);
+	int topEdge, botEdge;
+	view->w.wrap.dirty = 1;
+	SectionView_draw(view, layer, &topEdge, &botEdge);
+
+	for (int y = 0; y < section->yDim; y++) {
+		for (int x = 0; x < section->xDim; x++) {
+			if (Layer_cell(layer, section->xAnchor + x, section->yAnchor + y) != l_ref[y][x]) {
+				fail(what, y);
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * Checks a wrapped section through edits, a resize while following the
+ * end and a resize while scrolled up.
+ */
+static void check_wrap(void) {
+	static RenderLayer layer;
+	static SectionView views[VIEWS_PER_SESSION];
+	RenderSection section = { "log", 2, 2, 40, 8 };
+	RenderSection previous;
+
+	Layer_init(&layer);
+	Layer_addSection(&layer, &section);
+	SectionView_init(views);
+	SectionView* view = SectionView_bindWrap(views, &section);
+
+	for (uint32_t i = 0; i < NUM_PARAS; i++) {
+		make_paragraph(i);
+		SectionView_text(view, i, l_paras[i], l_paraLen[i]);
+	}
+	for (int n = 0; n < 200; n++) {
+		uint32_t i = rand() % NUM_PARAS;
+		make_paragraph(i);
+		SectionView_text(view, i, l_paras[i], l_paraLen[i]);
+	}
+	render_reference(section.xDim, section.yDim, NUM_PARAS, 0);
+	check_wrapped(view, &layer, "wrapped");
+
+	static const uint16_t widths[] = { 25, 33, 12, 40 };
+	for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+		uint32_t para = NUM_PARAS, offset = 0;
+		if (w % 2 == 1) {
+			SectionView_input(view, VIEW_MOVE, -(rand() % 5000));
+			para = WrapText_locate(&view->w.wrap, view->w.wrap.top, &offset);
+		} else {
+			SectionView_input(view, VIEW_MOVE, NUM_PARAS * PARA_LEN);
+		}
+		section.xDim = widths[w];
+		section.yDim = 6 + w;
+		Layer_configSection(&layer, &section, &previous);
+		SectionView_resize(view, Layer_getSection(&layer, "log"));
+		if (view->w.wrap.reflow >= NUM_PARAS) {
+			fail("reflow not deferred", w);
+		}
+
+		uint32_t lines = render_reference(section.xDim, section.yDim, para, offset);
+		check_wrapped(view, &layer, "in view after resize");
+		while (SectionView_step(view, STEP_BUDGET)) {
+		}
+		if (view->w.wrap.numLines != lines) {
+			fail("lines after reflow", w);
+		}
+		check_wrapped(view, &layer, "after reflow");
+	}
+	SectionView_freeAll(views);
+}
+
+/**
+ * Keeps a run of cells of the reference chart.
+ */
+static void keep_span(int y, int x, char const* text, int len, void* arg) {
+	(void)arg;
+	memcpy(&l_ref[y][x], text, len);
+}
+
+/**
+ * Checks the buckets of a chart against the samples it still keeps.
+ */
+static void check_buckets(ChartView const* chart) {
+	uint64_t count = chart->count;
+	uint64_t oldest = (count > chart->capacity) ? count - chart->capacity : 0;
+	uint64_t first = (oldest + chart->perColumn - 1) / chart->perColumn;
+	if (chart->firstBucket != first) {
+		fail("first bucket", (uint32_t)count);
+		return;
+	}
+	uint64_t last = (count - 1) / chart->perColumn;
+	uint64_t b = (last + 1 > chart->width) ? last + 1 - chart->width : 0;
+	for (b = (b < first) ? first : b; b <= last; b++) {
+		float lo = l_samples[b * chart->perColumn];
+		float hi = lo;
+		for (uint64_t i = b * chart->perColumn; i < count && i < (b + 1) * chart->perColumn; i++) {
+			if (l_samples[i] < lo) { lo = l_samples[i]; }
+			if (l_samples[i] > hi) { hi = l_samples[i]; }
+		}
+		int slot = (int)(b % chart->width);
+		if (chart->lo[slot] != lo || chart->hi[slot] != hi) {
+			fail("bucket", (uint32_t)b);
+			return;
+		}
+	}
+}
+
+/**
+ * Draws a chart and checks its section against a chart holding the same
+ * samples, its buckets rebuilt from the ring.
+ */
+static void check_chart_drawn(SectionView* view, RenderLayer* layer) {
+	RenderSection const* section = Layer_getSection(layer, view->key);
+	ChartView* chart = &view->w.chart;
+	ChartView ref;
+	int topEdge, botEdge;
+	SectionView_draw(view, layer, &topEdge, &botEdge);
+
+	ChartView_init(&ref, chart->capacity, chart->width, chart->height);
+	ChartView_push(&ref, l_samples, (uint32_t)chart->count);
+	ChartView_resize(&ref, chart->width + 1, chart->height);
+	ChartView_resize(&ref, chart->width, chart->height);
+	ChartView_render(&ref, &keep_span, NULL);
+	ChartView_free(&ref);
+
+	for (int y = 0; y < section->yDim; y++) {
+		for (int x = 0; x < section->xDim; x++) {
+			if (Layer_cell(layer, section->xAnchor + x, section->yAnchor + y) != l_ref[y][x]) {
+				fail("chart drawn", (uint32_t)chart->count);
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * Pushes samples to a chart a few at a time, past its capacity, checking
+ * it after every push; then does the same as a sparkline.
+ */
+static void check_chart(void) {
+	static RenderLayer layer;
+	static SectionView views[VIEWS_PER_SESSION];
+	static const ChartSpec spec = { CHART_CAPACITY, 0.0f, 0.0f };
+	RenderSection section = { "chart", 3, 3, 20, 6 };
+	RenderSection previous;
+
+	Layer_init(&layer);
+	Layer_addSection(&layer, &section);
+	SectionView_init(views);
+	SectionView* view = SectionView_bindChart(views, &section, &spec);
+	if (view == NULL || SectionView_find(views, "chart") != view) {
+		fail("chart bind", 0);
+		return;
+	}
+
+	uint32_t count = 0;
+	while (count < NUM_SAMPLES) {
+		if (count == NUM_SAMPLES / 2) {
+			section.yDim = 1;
+			Layer_configSection(&layer, &section, &previous);
+			SectionView_resize(view, Layer_getSection(&layer, "chart"));
+		}
+		if (rand() % 2) {
+			int32_t sample = rand() % 100;
+			l_samples[count++] = (float)sample;
+			SectionView_input(view, VIEW_SAMPLE, sample);
+		} else {
+			uint32_t n = 1 + rand() % (CHART_CAPACITY + 20);
+			if (n > NUM_SAMPLES - count) { n = NUM_SAMPLES - count; }
+			for (uint32_t i = 0; i < n; i++) {
+				l_samples[count + i] = (float)(rand() % 1000) / 10.0f;
+			}
+			ChartView_push(&view->w.chart, &l_samples[count], n);
+			count += n;
+		}
+		check_buckets(&view->w.chart);
+		check_chart_drawn(view, &layer);
+	}
+	SectionView_freeAll(views);
+}
+
+int main(int argc, char* argv[]) {
+	static RenderLayer layer;
+	static SectionView views[VIEWS_PER_SESSION];
+	static const RenderSection section = { "table", 2, 2, 30, 12 };
+	static const uint32_t batches[] = { 1, 1, 3, 1, 200, 1, 900, 50, 1, 1500, 2, 7000, 1, 1023, 1, 20000 };
+
+	srand((argc > 1) ? atoi(argv[1]) : 1);
+	Layer_init(&layer);
+	Layer_addSection(&layer, &section);
+	SectionView_init(views);
+
+	append_rows(5000);
+	SectionView* view = SectionView_bindTable(views, &section, &l_spec, NULL);
+	if (view == NULL || SectionView_find(views, "table") != view) {
+		printf("FAIL bind\n");
+		return 1;
+	}
+	settle(view);
+	SectionView_input(view, VIEW_SORT, 1);
+	settle(view);
+	check_order(view, -1);
+	check_drawn(view, &layer);
+
+	for (unsigned b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+		uint32_t indexed = view->w.table.numIndexed;
+		append_rows(batches[b]);
+		SectionView_input(view, VIEW_MOVE, rand() % 64 - 16);
+		if (batches[b] == 1) {
+			SectionView_step(view, 1);
+			if (view->w.table.numIndexed != indexed || view->w.table.numLive == 0) {
+				fail("single append merged", b);
+			}
+		}
+		settle(view);
+		check_order(view, -1);
+		check_drawn(view, &layer);
+	}
+
+	for (int32_t keep = NUM_CLASSES - 1; keep >= -1; keep--) {
+		SectionView_input(view, VIEW_FILTER, keep);
+		append_rows(100);
+		settle(view);
+		check_order(view, keep);
+		check_drawn(view, &layer);
+	}
+
+	SectionView_freeAll(views);
+	check_wrap();
+	check_chart();
+	if (l_failures > 0) {
+		printf("%d checks failed\n", l_failures);
+		return 1;
+	}
+	printf("ok: %u rows, %u paragraphs, %u samples\n", (unsigned)l_numRows, (unsigned)NUM_PARAS,
+			(unsigned)NUM_SAMPLES);
+	return 0;
+}